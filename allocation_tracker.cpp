@@ -0,0 +1,369 @@
+#include "allocation_tracker.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+
+#if defined(ALLOCATION_TRACKING)
+#include <cerrno>
+#include <new>
+#endif
+
+// The pools fill and the metrics history grows to a second of frames.
+static const uint64_t warmupFrameCount = 30;
+static const auto warmupTime = std::chrono::seconds(2);
+
+#if defined(ALLOCATION_TRACKING)
+
+namespace {
+
+// Zero initialized, so the allocation functions can use it on any thread
+// before anything else runs.
+struct ThreadAllocations
+{
+	uint64_t count;
+	uint64_t bytes;
+	uint64_t externalCount;
+	uint64_t externalBytes;
+	int externalDepth;
+};
+
+thread_local ThreadAllocations threadCounts;
+
+inline void countAllocation(size_t size)
+{
+	ThreadAllocations& counts = threadCounts;
+	++counts.count;
+	counts.bytes += size;
+	if (counts.externalDepth > 0) {
+		++counts.externalCount;
+		counts.externalBytes += size;
+	}
+}
+
+}
+
+#if defined(__GLIBC__)
+
+// Forwarded to the glibc allocator, free() is left as is.
+extern "C" {
+
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* pointer, size_t size);
+void* __libc_memalign(size_t alignment, size_t size);
+
+void* malloc(size_t size)
+{
+	countAllocation(size);
+	return __libc_malloc(size);
+}
+
+void* calloc(size_t count, size_t size)
+{
+	countAllocation(count * size);
+	return __libc_calloc(count, size);
+}
+
+void* realloc(void* pointer, size_t size)
+{
+	// Zero frees the block.
+	if ((nullptr == pointer) || (size > 0)) {
+		countAllocation(size);
+	}
+	return __libc_realloc(pointer, size);
+}
+
+void* memalign(size_t alignment, size_t size)
+{
+	countAllocation(size);
+	return __libc_memalign(alignment, size);
+}
+
+void* aligned_alloc(size_t alignment, size_t size)
+{
+	countAllocation(size);
+	return __libc_memalign(alignment, size);
+}
+
+int posix_memalign(void** pointer, size_t alignment, size_t size)
+{
+	if ((0 == alignment) || (0 != (alignment & (alignment - 1))) || (0 != (alignment % sizeof(void*)))) {
+		return EINVAL;
+	}
+	countAllocation(size);
+	void* memory = __libc_memalign(alignment, size);
+	if (nullptr == memory) {
+		return ENOMEM;
+	}
+	*pointer = memory;
+	return 0;
+}
+
+}
+
+#else
+
+// Only the code linked into the executable uses these.
+static void* allocate(std::size_t size)
+{
+	countAllocation(size);
+	if (void* memory = std::malloc((size > 0) ? size : 1)) {
+		return memory;
+	}
+	throw std::bad_alloc();
+}
+
+void* operator new(std::size_t size)
+{
+	return allocate(size);
+}
+
+void* operator new[](std::size_t size)
+{
+	return allocate(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+	countAllocation(size);
+	return std::malloc((size > 0) ? size : 1);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept
+{
+	countAllocation(size);
+	return std::malloc((size > 0) ? size : 1);
+}
+
+void operator delete(void* pointer) noexcept
+{
+	std::free(pointer);
+}
+
+void operator delete[](void* pointer) noexcept
+{
+	std::free(pointer);
+}
+
+void operator delete(void* pointer, std::size_t) noexcept
+{
+	std::free(pointer);
+}
+
+void operator delete[](void* pointer, std::size_t) noexcept
+{
+	std::free(pointer);
+}
+
+void operator delete(void* pointer, const std::nothrow_t&) noexcept
+{
+	std::free(pointer);
+}
+
+void operator delete[](void* pointer, const std::nothrow_t&) noexcept
+{
+	std::free(pointer);
+}
+
+#endif
+
+bool isAllocationTrackingEnabled()
+{
+	return true;
+}
+
+AllocationCounts threadAllocations()
+{
+	AllocationCounts counts;
+	counts.count = threadCounts.count;
+	counts.bytes = threadCounts.bytes;
+	return counts;
+}
+
+AllocationCounts threadExternalAllocations()
+{
+	AllocationCounts counts;
+	counts.count = threadCounts.externalCount;
+	counts.bytes = threadCounts.externalBytes;
+	return counts;
+}
+
+ExternalAllocationScope::ExternalAllocationScope()
+{
+	++threadCounts.externalDepth;
+}
+
+ExternalAllocationScope::~ExternalAllocationScope()
+{
+	--threadCounts.externalDepth;
+}
+
+#else
+
+bool isAllocationTrackingEnabled()
+{
+	return false;
+}
+
+AllocationCounts threadAllocations()
+{
+	return AllocationCounts();
+}
+
+AllocationCounts threadExternalAllocations()
+{
+	return AllocationCounts();
+}
+
+#endif
+
+static AllocationCounts operator-(const AllocationCounts& left, const AllocationCounts& right)
+{
+	AllocationCounts result;
+	result.count = left.count - right.count;
+	result.bytes = left.bytes - right.bytes;
+	return result;
+}
+
+static AllocationCounts& operator+=(AllocationCounts& left, const AllocationCounts& right)
+{
+	left.count += right.count;
+	left.bytes += right.bytes;
+	return left;
+}
+
+const char* frameStageName(FrameStage stage)
+{
+	switch (stage) {
+	case FrameStage::read:
+		return "read";
+	case FrameStage::prepare:
+		return "prepare";
+	case FrameStage::staticScene:
+		return "static_scene";
+	case FrameStage::filter:
+		return "filter";
+	case FrameStage::deliver:
+		return "deliver";
+	}
+	return "";
+}
+
+FrameAllocationTracker::FrameAllocationTracker()
+	: _lastTotal(threadAllocations())
+	, _lastExternal(threadExternalAllocations())
+{ }
+
+void FrameAllocationTracker::endStage(FrameStage stage)
+{
+	AllocationCounts total = threadAllocations();
+	AllocationCounts external = threadExternalAllocations();
+	StageAllocations& stageAllocations = _stages[static_cast<int>(stage)];
+	// The external ones are a part of the total.
+	stageAllocations.own += (total - _lastTotal) - (external - _lastExternal);
+	stageAllocations.external += external - _lastExternal;
+	_lastTotal = total;
+	_lastExternal = external;
+}
+
+const StageAllocations& FrameAllocationTracker::stage(FrameStage stage) const
+{
+	return _stages[static_cast<int>(stage)];
+}
+
+void FrameAllocationTracker::reset()
+{
+	for (auto& stage : _stages) {
+		stage = StageAllocations();
+	}
+}
+
+void AllocationReport::addFrame(const FrameAllocationTracker& frame, MetricsClock::time_point timestamp)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	if (0 == _frameCount) {
+		_firstFrameTime = timestamp;
+	}
+	++_frameCount;
+	if ((_frameCount <= warmupFrameCount) || ((timestamp - _firstFrameTime) < warmupTime)) {
+		return;
+	}
+
+	++_steadyStateFrameCount;
+	bool allocated = false;
+	for (int i = 0; i < frameStageCount; ++i) {
+		const StageAllocations& stage = frame.stage(static_cast<FrameStage>(i));
+		_totals[i].own += stage.own;
+		_totals[i].external += stage.external;
+		allocated = allocated || (stage.own.count > 0);
+	}
+	if (allocated) {
+		++_allocatingFrameCount;
+	}
+}
+
+void AllocationReport::reset()
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	_frameCount = 0;
+	_steadyStateFrameCount = 0;
+	_allocatingFrameCount = 0;
+	for (auto& total : _totals) {
+		total = StageAllocations();
+	}
+}
+
+uint64_t AllocationReport::frameCount() const
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	return _frameCount;
+}
+
+uint64_t AllocationReport::steadyStateAllocatingFrameCount() const
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	return _allocatingFrameCount;
+}
+
+std::string AllocationReport::summary() const
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	const double frames = static_cast<double>(std::max<uint64_t>(_steadyStateFrameCount, 1));
+	char line[160];
+	std::snprintf(
+		line,
+		sizeof(line),
+		"%llu frames, %llu after the warm-up, %llu of them allocated\n",
+		static_cast<unsigned long long>(_frameCount),
+		static_cast<unsigned long long>(_steadyStateFrameCount),
+		static_cast<unsigned long long>(_allocatingFrameCount)
+	);
+	std::string result = line;
+	std::snprintf(
+		line,
+		sizeof(line),
+		"%-14s %14s %14s %14s %14s\n",
+		"stage",
+		"allocs/frame",
+		"bytes/frame",
+		"external",
+		"external bytes"
+	);
+	result += line;
+	for (int i = 0; i < frameStageCount; ++i) {
+		const StageAllocations& total = _totals[i];
+		std::snprintf(
+			line,
+			sizeof(line),
+			"%-14s %14.2f %14.0f %14.2f %14.0f\n",
+			frameStageName(static_cast<FrameStage>(i)),
+			total.own.count / frames,
+			total.own.bytes / frames,
+			total.external.count / frames,
+			total.external.bytes / frames
+		);
+		result += line;
+	}
+	return result;
+}
@@ -0,0 +1,106 @@
+#ifndef ALLOCATION_TRACKER_H
+#define ALLOCATION_TRACKER_H
+
+#include "metrics.h"
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+// Allocation accounting of the frame path, built in with the
+// ENABLE_ALLOCATION_TRACKING CMake option which defines ALLOCATION_TRACKING.
+// The allocation functions are replaced and every thread counts its own
+// allocations, without locks. On Linux with glibc malloc and its relatives are
+// interposed, which also catches the buffers of Qt and OpenCV; elsewhere only
+// operator new of the sample's code is counted.
+struct AllocationCounts
+{
+	uint64_t count = 0;
+	uint64_t bytes = 0;
+};
+
+bool isAllocationTrackingEnabled();
+// Allocations of the calling thread since it started, all zero when the
+// tracking is not built in.
+AllocationCounts threadAllocations();
+// The part of them made within an ExternalAllocationScope.
+AllocationCounts threadExternalAllocations();
+
+// Counts the allocations of the calling thread as external while it exists:
+// the ones the SDK, OpenCV or Qt make internally, which the sample cannot
+// pool. Scopes nest.
+class ExternalAllocationScope
+{
+public:
+#if defined(ALLOCATION_TRACKING)
+	ExternalAllocationScope();
+	~ExternalAllocationScope();
+#else
+	ExternalAllocationScope() {}
+#endif
+	ExternalAllocationScope(const ExternalAllocationScope&) = delete;
+	ExternalAllocationScope& operator=(const ExternalAllocationScope&) = delete;
+};
+
+enum class FrameStage
+{
+	read,
+	prepare,
+	staticScene,
+	filter,
+	deliver
+};
+static const int frameStageCount = 5;
+
+const char* frameStageName(FrameStage stage);
+
+struct StageAllocations
+{
+	AllocationCounts own;
+	AllocationCounts external;
+};
+
+// Attributes the allocations of the pipeline thread to the stages of a frame.
+// Iterations which drop a frame add to the stages of the next one.
+class FrameAllocationTracker
+{
+public:
+	FrameAllocationTracker();
+
+	// The allocations since the previous stage ended belong to the stage.
+	void endStage(FrameStage stage);
+	const StageAllocations& stage(FrameStage stage) const;
+	// Starts counting the next frame.
+	void reset();
+
+private:
+	AllocationCounts _lastTotal;
+	AllocationCounts _lastExternal;
+	StageAllocations _stages[frameStageCount];
+};
+
+// Allocations per frame of each stage, collected on the pipeline thread and
+// read from any thread. The frames of the warm-up fill the pools, the
+// caches and the one second metrics history, and are left out.
+class AllocationReport
+{
+public:
+	void addFrame(const FrameAllocationTracker& frame, MetricsClock::time_point timestamp);
+	void reset();
+
+	uint64_t frameCount() const;
+	// Frames after the warm-up in which the sample's own code allocated.
+	uint64_t steadyStateAllocatingFrameCount() const;
+	// A table of the average allocations and bytes per frame of each stage.
+	std::string summary() const;
+
+private:
+	mutable std::mutex _mutex;
+	uint64_t _frameCount = 0;
+	MetricsClock::time_point _firstFrameTime;
+	uint64_t _steadyStateFrameCount = 0;
+	uint64_t _allocatingFrameCount = 0;
+	StageAllocations _totals[frameStageCount];
+};
+
+#endif
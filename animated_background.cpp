@@ -0,0 +1,242 @@
+#include "animated_background.h"
+
+#include <QFileInfo>
+
+#include <cstring>
+
+static const size_t ringSize = 4;
+static const auto defaultImageDelay = std::chrono::milliseconds(100);
+
+static QStringList videoSuffixes()
+{
+	return { "mp4", "m4v", "mov", "avi", "mkv", "webm" };
+}
+
+static bool isVideoFile(const QString& filePath)
+{
+	return videoSuffixes().contains(QFileInfo(filePath).suffix().toLower());
+}
+
+// Centered part of the source with the aspect ratio of the target.
+static cv::Rect centeredCrop(const cv::Size& source, const QSize& target)
+{
+	QSize cropSize = target.scaled(QSize(source.width, source.height), Qt::KeepAspectRatio);
+	return cv::Rect(
+		(source.width - cropSize.width()) / 2,
+		(source.height - cropSize.height()) / 2,
+		cropSize.width(),
+		cropSize.height()
+	);
+}
+
+bool AnimatedBackground::isAnimatedFile(const QString& filePath)
+{
+	if (isVideoFile(filePath)) {
+		return true;
+	}
+
+	QImageReader reader(filePath);
+	return reader.supportsAnimation() && (1 != reader.imageCount());
+}
+
+AnimatedBackground::AnimatedBackground(
+	const QString& filePath,
+	const QSize& size,
+	tsvb::IFrameFactory* frameFactory,
+	Metrics* metrics
+)
+	: _filePath(filePath)
+	, _size(size)
+	, _metrics(metrics)
+	, _writeCount(0)
+	, _readCount(0)
+	, _stopRequested(false)
+	, _videoFrameDuration(std::chrono::milliseconds(33))
+{
+	if (!_size.isValid() || (nullptr == frameFactory) || !openDecoder()) {
+		return;
+	}
+
+	const int bytesPerLine = _size.width() * 4;
+	_slots.resize(ringSize);
+	for (auto& slot : _slots) {
+		slot.pixels.resize(size_t(bytesPerLine) * size_t(_size.height()));
+		slot.frame.reset(frameFactory->createBGRA(
+			slot.pixels.data(),
+			bytesPerLine,
+			_size.width(),
+			_size.height(),
+			false
+		));
+		if (nullptr == slot.frame) {
+			return;
+		}
+	}
+
+	_valid = true;
+	_decodeThread = std::thread([this] { decodeLoop(); });
+}
+
+AnimatedBackground::~AnimatedBackground()
+{
+	_stopRequested = true;
+	_condition.notify_all();
+	if (_decodeThread.joinable()) {
+		_decodeThread.join();
+	}
+}
+
+bool AnimatedBackground::isValid() const
+{
+	return _valid;
+}
+
+tsvb::IFrame* AnimatedBackground::currentFrame(MetricsClock::time_point now)
+{
+	uint64_t readCount = _readCount.load(std::memory_order_relaxed);
+	bool available = _writeCount.load(std::memory_order_acquire) > readCount;
+	if (available && ((nullptr == _current) || (now >= _nextSwitchTime))) {
+		Slot& slot = _slots[readCount % _slots.size()];
+		_current = slot.frame.get();
+		_nextSwitchTime = now + slot.duration;
+		_readCount.store(readCount + 1, std::memory_order_release);
+		_condition.notify_one();
+	}
+
+	return _current;
+}
+
+bool AnimatedBackground::openDecoder()
+{
+	if (isVideoFile(_filePath)) {
+		_videoCapture.release();
+		if (!_videoCapture.open(_filePath.toStdString())) {
+			return false;
+		}
+		double fps = _videoCapture.get(cv::CAP_PROP_FPS);
+		if (fps > 0) {
+			_videoFrameDuration = std::chrono::duration_cast<MetricsClock::duration>(
+				std::chrono::duration<double>(1.0 / fps)
+			);
+		}
+		return true;
+	}
+
+	_imageReader.reset(new QImageReader(_filePath));
+	QSize sourceSize = _imageReader->size();
+	if (sourceSize.isValid()) {
+		QSize scaledSize = sourceSize.scaled(_size, Qt::KeepAspectRatioByExpanding);
+		_imageReader->setScaledSize(scaledSize);
+		_imageReader->setScaledClipRect(QRect(
+			(scaledSize.width() - _size.width()) / 2,
+			(scaledSize.height() - _size.height()) / 2,
+			_size.width(),
+			_size.height()
+		));
+	}
+	return _imageReader->canRead();
+}
+
+bool AnimatedBackground::decodeNext(Slot& slot)
+{
+	if (nullptr != _imageReader) {
+		return decodeImage(slot);
+	}
+	return decodeVideo(slot);
+}
+
+bool AnimatedBackground::decodeImage(Slot& slot)
+{
+	QImage image = _imageReader->read();
+	if (image.isNull()) {
+		// The animation is over, start it again.
+		if (!openDecoder()) {
+			return false;
+		}
+		image = _imageReader->read();
+		if (image.isNull()) {
+			return false;
+		}
+	}
+
+	int delay = _imageReader->nextImageDelay();
+	slot.duration = (delay > 0) ? std::chrono::milliseconds(delay) : defaultImageDelay;
+
+	if (image.size() != _size) {
+		image = image.scaled(_size, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+	}
+	image = image.convertToFormat(QImage::Format_ARGB32);
+
+	const int bytesPerLine = _size.width() * 4;
+	for (int y = 0; y < _size.height(); ++y) {
+		std::memcpy(
+			slot.pixels.data() + y * bytesPerLine,
+			image.constScanLine(y),
+			bytesPerLine
+		);
+	}
+	return true;
+}
+
+bool AnimatedBackground::decodeVideo(Slot& slot)
+{
+	if (!_videoCapture.read(_decodedMat)) {
+		// Loop the video, reopen it if the backend can not seek.
+		_videoCapture.set(cv::CAP_PROP_POS_FRAMES, 0);
+		if (!_videoCapture.read(_decodedMat)) {
+			if (!openDecoder() || !_videoCapture.read(_decodedMat)) {
+				return false;
+			}
+		}
+	}
+
+	cv::Rect crop = centeredCrop(_decodedMat.size(), _size);
+	cv::resize(
+		_decodedMat(crop),
+		_scaledMat,
+		cv::Size(_size.width(), _size.height()),
+		0,
+		0,
+		cv::INTER_AREA
+	);
+	cv::Mat slotMat(_size.height(), _size.width(), CV_8UC4, slot.pixels.data());
+	cv::cvtColor(_scaledMat, slotMat, cv::COLOR_BGR2BGRA);
+
+	slot.duration = _videoFrameDuration;
+	return true;
+}
+
+void AnimatedBackground::decodeLoop()
+{
+	// One slot is kept for the frame which is shown now.
+	const uint64_t capacity = _slots.size() - 1;
+	while (!_stopRequested) {
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+			_condition.wait_for(lock, std::chrono::milliseconds(10), [this, capacity] {
+				return _stopRequested || (_writeCount - _readCount < capacity);
+			});
+		}
+		uint64_t writeCount = _writeCount.load(std::memory_order_relaxed);
+		if (_stopRequested || (writeCount - _readCount.load(std::memory_order_acquire) >= capacity)) {
+			continue;
+		}
+
+		Slot& slot = _slots[writeCount % _slots.size()];
+		auto decodeBeginTime = MetricsClock::now();
+		if (!decodeNext(slot)) {
+			// Keep showing the last decoded frame.
+			return;
+		}
+		auto decodeEndTime = MetricsClock::now();
+
+		if (nullptr != _metrics) {
+			FrameTimeInfo frameTimeInfo;
+			frameTimeInfo.duration = decodeEndTime - decodeBeginTime;
+			frameTimeInfo.timestamp = decodeEndTime;
+			frameTimeInfo.size = _size;
+			_metrics->onBackgroundFrameDecoded(frameTimeInfo);
+		}
+		_writeCount.store(writeCount + 1, std::memory_order_release);
+	}
+}
@@ -0,0 +1,83 @@
+#ifndef ANIMATED_BACKGROUND_H
+#define ANIMATED_BACKGROUND_H
+
+#include "metrics.h"
+#include "sdk_releaser.h"
+
+#include <QImageReader>
+#include <QSize>
+#include <QString>
+
+#include <opencv2/opencv.hpp>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Looping GIF or video background. A decode thread keeps a small ring of
+// frames prescaled to the processed frame size filled ahead, so the
+// processing thread only picks the frame which is due, without decoding
+// or allocating.
+class AnimatedBackground
+{
+public:
+	static bool isAnimatedFile(const QString& filePath);
+
+	AnimatedBackground(
+		const QString& filePath,
+		const QSize& size,
+		tsvb::IFrameFactory* frameFactory,
+		Metrics* metrics
+	);
+	~AnimatedBackground();
+
+	bool isValid() const;
+
+	// Returns the frame to show at the time point or nullptr until the first
+	// frame is decoded. The frame stays valid until the next call.
+	tsvb::IFrame* currentFrame(MetricsClock::time_point now);
+
+private:
+	struct Slot
+	{
+		std::vector<uint8_t> pixels;
+		std::unique_ptr<tsvb::IFrame, Releaser> frame;
+		MetricsClock::duration duration;
+	};
+
+	bool openDecoder();
+	bool decodeNext(Slot& slot);
+	bool decodeImage(Slot& slot);
+	bool decodeVideo(Slot& slot);
+	void decodeLoop();
+
+private:
+	const QString _filePath;
+	const QSize _size;
+	Metrics* const _metrics;
+	bool _valid = false;
+
+	std::vector<Slot> _slots;
+	std::atomic<uint64_t> _writeCount;
+	std::atomic<uint64_t> _readCount;
+	tsvb::IFrame* _current = nullptr;
+	MetricsClock::time_point _nextSwitchTime;
+
+	std::mutex _mutex;
+	std::condition_variable _condition;
+	std::atomic<bool> _stopRequested;
+	std::thread _decodeThread;
+
+	// Used by the decode thread only.
+	std::unique_ptr<QImageReader> _imageReader;
+	cv::VideoCapture _videoCapture;
+	cv::Mat _decodedMat;
+	cv::Mat _scaledMat;
+	MetricsClock::duration _videoFrameDuration;
+};
+
+#endif
@@ -0,0 +1,191 @@
+#include "background_cache.h"
+
+#include <QDateTime>
+#include <QDir>
+#include <QFileInfo>
+
+static QString cacheKey(const QFileInfo& fileInfo, const QSize& size)
+{
+	qint64 modified = fileInfo.lastModified().toMSecsSinceEpoch();
+	return QString("%1|%2|%3x%4")
+		.arg(fileInfo.absoluteFilePath())
+		.arg(modified)
+		.arg(size.width())
+		.arg(size.height());
+}
+
+static size_t frameBytes(tsvb::IFrame* frame)
+{
+	// Images are decoded into BGRA.
+	return size_t(frame->width()) * size_t(frame->height()) * 4;
+}
+
+static QStringList imageNameFilters()
+{
+	return { "*.png", "*.jpg", "*.jpeg", "*.jpe", "*.tiff", "*.tif" };
+}
+
+BackgroundCache::BackgroundCache(Loader loader, size_t budgetBytes)
+	: _loader(std::move(loader))
+{
+	_stats.budgetBytes = budgetBytes;
+}
+
+BackgroundCache::~BackgroundCache()
+{
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_stopRequested = true;
+		_prefetchQueue.clear();
+	}
+	_prefetchCondition.notify_all();
+	if (_prefetchThread.joinable()) {
+		_prefetchThread.join();
+	}
+}
+
+BackgroundCache::FramePtr BackgroundCache::get(const QString& filePath, const QSize& size)
+{
+	QString key = cacheKey(QFileInfo(filePath), size);
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		FramePtr frame = find(key);
+		if (nullptr != frame) {
+			++_stats.hits;
+			return frame;
+		}
+		++_stats.misses;
+	}
+
+	FramePtr frame = load(filePath, size);
+	if (nullptr != frame) {
+		insert(key, frame, false);
+	}
+	return frame;
+}
+
+void BackgroundCache::prefetchDirectoryOf(const QString& filePath, const QSize& size)
+{
+	QFileInfo fileInfo(filePath);
+	QDir dir = fileInfo.absoluteDir();
+	QStringList fileNames =
+		dir.entryList(imageNameFilters(), QDir::Files | QDir::Readable, QDir::Name);
+
+	std::lock_guard<std::mutex> lock(_mutex);
+	_prefetchQueue.clear();
+	_prefetchSize = size;
+	for (const auto& fileName : fileNames) {
+		QString path = dir.absoluteFilePath(fileName);
+		if (path != fileInfo.absoluteFilePath()) {
+			_prefetchQueue.push_back(path);
+		}
+	}
+	if (!_prefetchThread.joinable()) {
+		_prefetchThread = std::thread([this] { prefetchLoop(); });
+	}
+	_prefetchCondition.notify_one();
+}
+
+void BackgroundCache::setBudget(size_t budgetBytes)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	_stats.budgetBytes = budgetBytes;
+	evict(0);
+}
+
+BackgroundCacheStats BackgroundCache::stats() const
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	return _stats;
+}
+
+BackgroundCache::FramePtr BackgroundCache::find(const QString& key)
+{
+	auto indexIt = _index.find(key);
+	if (_index.end() == indexIt) {
+		return nullptr;
+	}
+
+	_entries.splice(_entries.begin(), _entries, indexIt.value());
+	return _entries.front().frame;
+}
+
+BackgroundCache::FramePtr BackgroundCache::load(const QString& filePath, const QSize& size)
+{
+	return _loader(filePath, size);
+}
+
+void BackgroundCache::insert(const QString& key, const FramePtr& frame, bool prefetched)
+{
+	size_t bytes = frameBytes(frame.get());
+
+	std::lock_guard<std::mutex> lock(_mutex);
+	if (_index.contains(key)) {
+		return;
+	}
+
+	if (prefetched) {
+		// Prefetching never pushes out images which were actually used.
+		if (_stats.bytes + bytes > _stats.budgetBytes) {
+			return;
+		}
+		_entries.push_back({ key, frame, bytes });
+		_index.insert(key, std::prev(_entries.end()));
+		++_stats.prefetched;
+	}
+	else {
+		evict(bytes);
+		_entries.push_front({ key, frame, bytes });
+		_index.insert(key, _entries.begin());
+	}
+	_stats.bytes += bytes;
+	_stats.entries = _entries.size();
+}
+
+void BackgroundCache::evict(size_t requiredBytes)
+{
+	while (!_entries.empty() && (_stats.bytes + requiredBytes > _stats.budgetBytes)) {
+		_stats.bytes -= _entries.back().bytes;
+		_index.remove(_entries.back().key);
+		_entries.pop_back();
+	}
+	_stats.entries = _entries.size();
+}
+
+void BackgroundCache::prefetchLoop()
+{
+	while (true) {
+		QString filePath;
+		QSize size;
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+			_prefetchCondition.wait(lock, [this] {
+				return _stopRequested || !_prefetchQueue.empty();
+			});
+			if (_stopRequested) {
+				return;
+			}
+			filePath = _prefetchQueue.front();
+			size = _prefetchSize;
+			_prefetchQueue.pop_front();
+
+			if (_stats.bytes >= _stats.budgetBytes) {
+				_prefetchQueue.clear();
+				continue;
+			}
+		}
+
+		QString key = cacheKey(QFileInfo(filePath), size);
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			if (_index.contains(key)) {
+				continue;
+			}
+		}
+
+		FramePtr frame = load(filePath, size);
+		if (nullptr != frame) {
+			insert(key, frame, true);
+		}
+	}
+}
@@ -0,0 +1,81 @@
+#ifndef BACKGROUND_CACHE_H
+#define BACKGROUND_CACHE_H
+
+#include <vb_sdk/sdk_factory.h>
+
+#include <QHash>
+#include <QSize>
+#include <QString>
+#include <QStringList>
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+struct BackgroundCacheStats
+{
+	uint64_t hits = 0;
+	uint64_t misses = 0;
+	uint64_t prefetched = 0;
+	size_t entries = 0;
+	size_t bytes = 0;
+	size_t budgetBytes = 0;
+};
+
+// LRU cache of decoded background frames keyed by file path, modification
+// time and the size the image was decoded at. Other images of the directory
+// of a requested file are decoded ahead on a background thread while they fit
+// into the memory budget.
+class BackgroundCache
+{
+public:
+	using FramePtr = std::shared_ptr<tsvb::IFrame>;
+	// Runs on the threads calling get() and on the prefetch thread, possibly
+	// at once.
+	using Loader = std::function<FramePtr(const QString& filePath, const QSize& size)>;
+
+	BackgroundCache(Loader loader, size_t budgetBytes);
+	~BackgroundCache();
+
+	// Returns the cached frame or decodes it on the calling thread.
+	FramePtr get(const QString& filePath, const QSize& size);
+	void prefetchDirectoryOf(const QString& filePath, const QSize& size);
+
+	void setBudget(size_t budgetBytes);
+	BackgroundCacheStats stats() const;
+
+private:
+	struct Entry
+	{
+		QString key;
+		FramePtr frame;
+		size_t bytes;
+	};
+
+	FramePtr find(const QString& key);
+	FramePtr load(const QString& filePath, const QSize& size);
+	void insert(const QString& key, const FramePtr& frame, bool prefetched);
+	void evict(size_t requiredBytes);
+	void prefetchLoop();
+
+private:
+	Loader _loader;
+
+	mutable std::mutex _mutex;
+	std::list<Entry> _entries;
+	QHash<QString, std::list<Entry>::iterator> _index;
+	BackgroundCacheStats _stats;
+
+	std::condition_variable _prefetchCondition;
+	std::deque<QString> _prefetchQueue;
+	QSize _prefetchSize;
+	bool _stopRequested = false;
+	std::thread _prefetchThread;
+};
+
+#endif
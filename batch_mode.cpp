@@ -0,0 +1,791 @@
+#include "batch_mode.h"
+
+#include "effect_options.h"
+#include "encoder_sink.h"
+#include "pixel_convert.h"
+#include "system_usage.h"
+#include "video_chunks.h"
+#include "video_filter.h"
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QSet>
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+static const char* batchModeArgument = "--batch";
+static const char* journalFileName = "batch_journal.tsv";
+static const double defaultFps = 30.0;
+static const int encoderQueueSize = 4;
+// A single video is split into a few chunks per worker for balance, but
+// not into chunks so short that the overlap dominates.
+static const int chunksPerWorker = 3;
+static const double minChunkSeconds = 10;
+static const int defaultOverlapFrames = 15;
+// Rough peak memory of one worker: the SDK pipeline with its models, the
+// decoder and the frames of a 1080p video in flight.
+static const uint64_t estimatedWorkerMemory = 768ull * 1024 * 1024;
+
+static QStringList videoNameFilters()
+{
+	return { "*.mp4", "*.m4v", "*.mov", "*.avi", "*.mkv", "*.webm" };
+}
+
+static bool isVideoFile(const QString& filePath)
+{
+	return QDir::match(videoNameFilters(), QFileInfo(filePath).fileName());
+}
+
+static void printError(const QString& message)
+{
+	std::fprintf(stderr, "%s\n", qPrintable(message));
+}
+
+struct BatchJob
+{
+	// Relative to the input, names the file in the journal and the output.
+	QString name;
+	QString inputPath;
+	QString outputPath;
+};
+
+struct BatchResult
+{
+	bool ok = false;
+	QString reason;
+	uint64_t frameCount = 0;
+	double seconds = 0;
+	// Processing time of every frame in milliseconds.
+	std::vector<double> latencies;
+};
+
+// Keeps the extension of the input, a.mov and a.mp4 become a.mov.mp4 and a.mp4.mp4.
+static QString outputPathFor(const QDir& outputDir, const QString& name)
+{
+	return QDir::cleanPath(outputDir.filePath(name + ".mp4"));
+}
+
+static bool collectJobs(const QString& input, const QDir& outputDir, std::vector<BatchJob>& jobs)
+{
+	QFileInfo inputInfo(input);
+	if (inputInfo.isFile() && isVideoFile(input)) {
+		BatchJob job;
+		job.inputPath = inputInfo.absoluteFilePath();
+		job.name = inputInfo.fileName();
+		job.outputPath = outputPathFor(outputDir, job.name);
+		jobs.push_back(job);
+	}
+	else if (inputInfo.isDir()) {
+		QDir inputDir(inputInfo.absoluteFilePath());
+		// Outputs of earlier runs are not inputs when the output directory
+		// is inside the input one.
+		QString outputPrefix = outputDir.absolutePath() + "/";
+		bool skipOutputs = outputPrefix.startsWith(inputDir.path() + "/");
+		QDirIterator iterator(
+			inputDir.path(),
+			videoNameFilters(),
+			QDir::Files,
+			QDirIterator::Subdirectories
+		);
+		while (iterator.hasNext()) {
+			BatchJob job;
+			job.inputPath = iterator.next();
+			if (skipOutputs && job.inputPath.startsWith(outputPrefix)) {
+				continue;
+			}
+			job.name = inputDir.relativeFilePath(job.inputPath);
+			job.outputPath = outputPathFor(outputDir, job.name);
+			jobs.push_back(job);
+		}
+	}
+	else {
+		// A manifest, relative paths are relative to its directory.
+		QFile manifest(input);
+		if (!manifest.open(QIODevice::ReadOnly | QIODevice::Text)) {
+			return false;
+		}
+		QDir manifestDir = inputInfo.absoluteDir();
+		while (!manifest.atEnd()) {
+			QString line = QString::fromUtf8(manifest.readLine()).trimmed();
+			if (line.isEmpty() || line.startsWith('#')) {
+				continue;
+			}
+			BatchJob job;
+			job.inputPath = QDir::cleanPath(manifestDir.absoluteFilePath(line));
+			job.name = manifestDir.relativeFilePath(job.inputPath);
+			if (job.name.startsWith("..")) {
+				job.name = QFileInfo(job.inputPath).fileName();
+			}
+			job.outputPath = outputPathFor(outputDir, job.name);
+			jobs.push_back(job);
+		}
+	}
+
+	std::sort(jobs.begin(), jobs.end(), [](const BatchJob& left, const BatchJob& right) {
+		return left.name < right.name;
+	});
+	return true;
+}
+
+// The names of the files done by earlier runs.
+static QSet<QString> readJournal(const QString& path)
+{
+	QSet<QString> doneNames;
+	QFile journal(path);
+	if (!journal.open(QIODevice::ReadOnly | QIODevice::Text)) {
+		return doneNames;
+	}
+	while (!journal.atEnd()) {
+		QStringList fields = QString::fromUtf8(journal.readLine()).trimmed().split('\t');
+		if ((fields.size() >= 2) && ("done" == fields[0])) {
+			doneNames.insert(fields[1]);
+		}
+	}
+	return doneNames;
+}
+
+static double percentile(const std::vector<double>& sortedValues, double fraction)
+{
+	if (sortedValues.empty()) {
+		return 0;
+	}
+	size_t index = size_t(fraction * double(sortedValues.size() - 1) + 0.5);
+	return sortedValues[std::min(index, sortedValues.size() - 1)];
+}
+
+// Appends to the journal and the statistics from the workers, every line is
+// flushed at once so an interrupted run keeps what was finished.
+class BatchReport
+{
+public:
+	BatchReport(const QString& journalPath, const QString& statsPath, int jobCount)
+		: _journal(journalPath)
+		, _stats(statsPath)
+		, _jobCount(jobCount)
+	{ }
+
+	bool open()
+	{
+		if (!_journal.open(QIODevice::Append | QIODevice::Text)) {
+			return false;
+		}
+		if (_stats.fileName().isEmpty()) {
+			return true;
+		}
+		bool exists = _stats.exists() && (_stats.size() > 0);
+		if (!_stats.open(QIODevice::Append | QIODevice::Text)) {
+			return false;
+		}
+		if (!exists) {
+			_stats.write("file,status,frames,seconds,fps,"
+				"latency_avg_ms,latency_p50_ms,latency_p95_ms,latency_max_ms\n");
+			_stats.flush();
+		}
+		return true;
+	}
+
+	void record(const BatchJob& job, BatchResult& result)
+	{
+		std::sort(result.latencies.begin(), result.latencies.end());
+		double latencySum = 0;
+		for (double latency : result.latencies) {
+			latencySum += latency;
+		}
+		double fps = (result.seconds > 0) ? double(result.frameCount) / result.seconds : 0;
+		double averageLatency = result.latencies.empty() ? 0 : latencySum / double(result.latencies.size());
+
+		std::lock_guard<std::mutex> lock(_mutex);
+		++_finishedCount;
+		if (result.ok) {
+			++_doneCount;
+			_frameCount += result.frameCount;
+			_journal.write(QString("done\t%1\t%2\t%3\n").arg(
+				job.name,
+				QString::number(result.frameCount),
+				QString::number(result.seconds, 'f', 3)
+			).toUtf8());
+			std::fprintf(stderr, "[%d/%d] %s: %llu frames, %.1f fps, p95 %.1f ms\n",
+				_finishedCount, _jobCount, qPrintable(job.name),
+				static_cast<unsigned long long>(result.frameCount), fps,
+				percentile(result.latencies, 0.95));
+		}
+		else {
+			++_failedCount;
+			_journal.write(QString("failed\t%1\t%2\n").arg(job.name, result.reason).toUtf8());
+			std::fprintf(stderr, "[%d/%d] %s: failed, %s\n",
+				_finishedCount, _jobCount, qPrintable(job.name), qPrintable(result.reason));
+		}
+		_journal.flush();
+
+		if (_stats.isOpen()) {
+			QStringList fields = {
+				"\"" + QString(job.name).replace('"', "\"\"") + "\"",
+				result.ok ? "done" : "failed",
+				QString::number(result.frameCount),
+				QString::number(result.seconds, 'f', 3),
+				QString::number(fps, 'f', 2),
+				QString::number(averageLatency, 'f', 2),
+				QString::number(percentile(result.latencies, 0.5), 'f', 2),
+				QString::number(percentile(result.latencies, 0.95), 'f', 2),
+				QString::number(result.latencies.empty() ? 0.0 : result.latencies.back(), 'f', 2)
+			};
+			_stats.write((fields.join(',') + "\n").toUtf8());
+			_stats.flush();
+		}
+	}
+
+	int doneCount() const { return _doneCount; }
+	int failedCount() const { return _failedCount; }
+	uint64_t frameCount() const { return _frameCount; }
+
+private:
+	std::mutex _mutex;
+	QFile _journal;
+	QFile _stats;
+	const int _jobCount;
+	int _finishedCount = 0;
+	int _doneCount = 0;
+	int _failedCount = 0;
+	uint64_t _frameCount = 0;
+};
+
+static QString partialPathFor(const QString& outputPath, const QString& suffix)
+{
+	QFileInfo outputInfo(outputPath);
+	return outputInfo.absolutePath() + "/" + outputInfo.completeBaseName() + suffix;
+}
+
+// Processes the frames from the current position of the capture and writes
+// them to the encoder. The first warmupFrames only go through the filter,
+// at most frameLimit frames are written unless it is negative. Sets the
+// reason of the result on a failure.
+static void processFrames(
+	cv::VideoCapture& capture,
+	VideoFilter* videoFilter,
+	EncoderSink& encoder,
+	int64_t warmupFrames,
+	int64_t frameLimit,
+	BatchResult& result
+)
+{
+	cv::Mat decodedFrame;
+	cv::Mat bgrFrame;
+	QImage frame;
+	int64_t frameNumber = 0;
+	while (((frameLimit < 0) || (frameNumber < warmupFrames + frameLimit)) && capture.read(decodedFrame)) {
+		const cv::Mat* source = &decodedFrame;
+		if (CV_8UC3 != decodedFrame.type()) {
+			cv::cvtColor(decodedFrame, bgrFrame, cv::COLOR_GRAY2BGR);
+			source = &bgrFrame;
+		}
+		QSize size(source->cols, source->rows);
+		if (frame.size() != size) {
+			frame = QImage(size, QImage::Format_ARGB32);
+			videoFilter->setFrameSize(size);
+		}
+		convertBGRToBGRA(
+			source->data,
+			int(source->step),
+			frame.bits(),
+			frame.bytesPerLine(),
+			size.width(),
+			size.height()
+		);
+
+		auto frameBeginTime = MetricsClock::now();
+		QImage output = videoFilter->replaceBG(frame);
+		auto frameEndTime = MetricsClock::now();
+		if (output.isNull()) {
+			result.reason = "processing failed";
+			return;
+		}
+		if (++frameNumber <= warmupFrames) {
+			continue;
+		}
+		result.latencies.push_back(
+			std::chrono::duration<double, std::milli>(frameEndTime - frameBeginTime).count()
+		);
+		++result.frameCount;
+
+		encoder.consume(output, frameEndTime);
+		if (!encoder.isValid()) {
+			result.reason = "cannot write the output";
+			return;
+		}
+	}
+}
+
+// Renames the complete output written under partialPath, removes it after a
+// failure.
+static void commitOutput(
+	const QString& partialPath,
+	const QString& outputPath,
+	MetricsClock::time_point beginTime,
+	BatchResult& result
+)
+{
+	if (result.reason.isEmpty() && (0 == result.frameCount)) {
+		result.reason = "no frames decoded";
+	}
+	if (result.reason.isEmpty()) {
+		QFile::remove(outputPath);
+		if (!QFile::rename(partialPath, outputPath)) {
+			result.reason = "cannot rename the output";
+		}
+	}
+	result.seconds = std::chrono::duration<double>(MetricsClock::now() - beginTime).count();
+	if (!result.reason.isEmpty()) {
+		QFile::remove(partialPath);
+		return;
+	}
+	result.ok = true;
+}
+
+static BatchResult processFile(const BatchJob& job, VideoFilter* videoFilter)
+{
+	BatchResult result;
+	auto beginTime = MetricsClock::now();
+
+	cv::VideoCapture capture(job.inputPath.toStdString());
+	if (!capture.isOpened()) {
+		result.reason = "cannot open the input";
+		return result;
+	}
+	double fps = capture.get(cv::CAP_PROP_FPS);
+	if (!(fps > 0)) {
+		fps = defaultFps;
+	}
+
+	if (!QDir().mkpath(QFileInfo(job.outputPath).absolutePath())) {
+		result.reason = "cannot create the output directory";
+		return result;
+	}
+	// Written under a temporary name, so an interrupted run never leaves a
+	// file that looks complete.
+	QString partialPath = partialPathFor(job.outputPath, ".part.mp4");
+	{
+		EncoderSink encoder(
+			partialPath.toStdString(),
+			fps,
+			encoderQueueSize,
+			EncoderDropPolicy::block,
+			EncoderTiming::everyFrame,
+			nullptr
+		);
+		processFrames(capture, videoFilter, encoder, 0, -1, result);
+		if (!encoder.finish() && result.reason.isEmpty()) {
+			result.reason = "cannot write the output";
+		}
+	}
+	commitOutput(partialPath, job.outputPath, beginTime, result);
+	return result;
+}
+
+static BatchResult processChunk(
+	const QString& inputPath,
+	const VideoChunk& chunk,
+	const QString& chunkPath,
+	double fps,
+	VideoFilter* videoFilter
+)
+{
+	BatchResult result;
+	cv::VideoCapture capture(inputPath.toStdString());
+	if (!capture.isOpened()) {
+		result.reason = "cannot open the input";
+		return result;
+	}
+	// OpenCV decodes from the keyframe before and stops at the frame.
+	if ((chunk.warmupFrame > 0) && !capture.set(cv::CAP_PROP_POS_FRAMES, double(chunk.warmupFrame))) {
+		result.reason = "cannot seek the input";
+		return result;
+	}
+	{
+		EncoderSink encoder(
+			chunkPath.toStdString(),
+			fps,
+			encoderQueueSize,
+			EncoderDropPolicy::block,
+			EncoderTiming::everyFrame,
+			nullptr
+		);
+		int64_t frameLimit = (chunk.endFrame < 0) ? -1 : (chunk.endFrame - chunk.beginFrame);
+		processFrames(capture, videoFilter, encoder, chunk.beginFrame - chunk.warmupFrame, frameLimit, result);
+		if (!encoder.finish() && result.reason.isEmpty()) {
+			result.reason = "cannot write the output";
+		}
+	}
+	result.ok = result.reason.isEmpty();
+	return result;
+}
+
+// Reencodes the frames of a chunk to the output, opened with the first frame.
+static bool appendChunk(const QString& chunkPath, const QString& outputPath, double fps, cv::VideoWriter& writer)
+{
+	cv::VideoCapture capture(chunkPath.toStdString());
+	if (!capture.isOpened()) {
+		return false;
+	}
+	cv::Mat frame;
+	while (capture.read(frame)) {
+		if (!writer.isOpened() && !writer.open(
+			outputPath.toStdString(),
+			videoFourccForFile(outputPath.toStdString()),
+			fps,
+			frame.size(),
+			true
+		)) {
+			return false;
+		}
+		writer.write(frame);
+	}
+	return true;
+}
+
+// Splits one video into chunks processed on every worker. The chunks are
+// written losslessly and stitched in order on this thread while the later
+// ones are still processed, so the output is compressed once.
+static BatchResult processChunked(
+	const BatchJob& job,
+	const std::vector<std::unique_ptr<VideoFilter>>& videoFilters,
+	int64_t overlapFrames
+)
+{
+	BatchResult result;
+	auto beginTime = MetricsClock::now();
+
+	VideoIndex index;
+	if (!indexVideo(job.inputPath.toStdString(), index)) {
+		result.reason = "cannot open the input";
+		return result;
+	}
+	const double fps = (index.fps > 0) ? index.fps : defaultFps;
+	const std::vector<VideoChunk> chunks = planVideoChunks(
+		index,
+		int(videoFilters.size()) * chunksPerWorker,
+		int64_t(fps * minChunkSeconds),
+		overlapFrames
+	);
+	std::fprintf(stderr, "%s: %lld frames, %d keyframes, %d chunks\n",
+		qPrintable(job.name), static_cast<long long>(index.frameCount),
+		int(index.keyframes.size()), int(chunks.size()));
+
+	if (!QDir().mkpath(QFileInfo(job.outputPath).absolutePath())) {
+		result.reason = "cannot create the output directory";
+		return result;
+	}
+
+	struct ChunkState
+	{
+		QString path;
+		BatchResult result;
+		bool finished = false;
+	};
+	std::vector<ChunkState> states(chunks.size());
+	for (size_t i = 0; i < chunks.size(); ++i) {
+		states[i].path = partialPathFor(job.outputPath, QString(".chunk%1.mkv").arg(int(i), 4, 10, QChar('0')));
+	}
+	std::mutex mutex;
+	std::condition_variable condition;
+	size_t nextChunk = 0;
+	bool cancelled = false;
+
+	std::vector<std::thread> workers;
+	for (const auto& videoFilter : videoFilters) {
+		VideoFilter* filter = videoFilter.get();
+		workers.emplace_back([&, filter] {
+			while (true) {
+				size_t chunkIndex = 0;
+				{
+					std::lock_guard<std::mutex> lock(mutex);
+					if (cancelled || (nextChunk >= chunks.size())) {
+						break;
+					}
+					chunkIndex = nextChunk++;
+				}
+				BatchResult chunkResult = processChunk(
+					job.inputPath,
+					chunks[chunkIndex],
+					states[chunkIndex].path,
+					fps,
+					filter
+				);
+				{
+					std::lock_guard<std::mutex> lock(mutex);
+					states[chunkIndex].result = std::move(chunkResult);
+					states[chunkIndex].finished = true;
+				}
+				condition.notify_all();
+			}
+		});
+	}
+
+	QString partialPath = partialPathFor(job.outputPath, ".part.mp4");
+	cv::VideoWriter writer;
+	for (size_t i = 0; i < states.size(); ++i) {
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			condition.wait(lock, [&states, i] { return states[i].finished; });
+		}
+		BatchResult& chunkResult = states[i].result;
+		if (!chunkResult.ok) {
+			result.reason = QString("chunk %1, %2").arg(int(i)).arg(chunkResult.reason);
+			break;
+		}
+		if ((chunkResult.frameCount > 0) && !appendChunk(states[i].path, partialPath, fps, writer)) {
+			result.reason = "cannot stitch the chunks";
+			break;
+		}
+		QFile::remove(states[i].path);
+		result.frameCount += chunkResult.frameCount;
+		result.latencies.insert(
+			result.latencies.end(),
+			chunkResult.latencies.begin(),
+			chunkResult.latencies.end()
+		);
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		cancelled = true;
+	}
+	for (auto& worker : workers) {
+		worker.join();
+	}
+	writer.release();
+	for (const ChunkState& state : states) {
+		QFile::remove(state.path);
+	}
+
+	commitOutput(partialPath, job.outputPath, beginTime, result);
+	return result;
+}
+
+// Half of the logical cores, since the SDK runs several threads per frame,
+// and no more workers than the available memory holds.
+static int defaultWorkerCount()
+{
+	int workerCount = std::max(1, logicalCoreCount() / 2);
+	uint64_t memory = availableMemoryBytes();
+	if (0 != memory) {
+		workerCount = std::min(workerCount, int(std::max<uint64_t>(1, memory / estimatedWorkerMemory)));
+	}
+	return workerCount;
+}
+
+bool isBatchModeRequested(int argc, char* argv[])
+{
+	for (int i = 1; i < argc; ++i) {
+		if (0 == std::strcmp(argv[i], batchModeArgument)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+int runBatchMode(int argc, char* argv[])
+{
+	QCoreApplication app(argc, argv);
+	app.setOrganizationName(TSVB_COMPANY);
+	app.setApplicationName(TSVB_APP_BIN_NAME);
+	app.setApplicationVersion(TSVB_VERSION_STRING);
+
+	QCommandLineParser parser;
+	parser.setApplicationDescription("Applies the effects to directories of recordings.");
+	parser.addHelpOption();
+	parser.addOptions({
+		{ "batch", "Runs without the window." },
+		{ "input", "Directory searched recursively for videos, a manifest file "
+			"with one path per line, or one video split into chunks for the workers.", "path" },
+		{ "output-dir", "Directory of the processed videos, mirrors the input layout.", "path" },
+		{ "workers", "Number of parallel pipelines, sized to the cores and memory by default.", "count" },
+		{ "journal", "Journal of the finished files, output-dir/batch_journal.tsv by default. "
+			"Files done in the journal are skipped.", "path" },
+		{ "restart", "Ignores the files done in the journal." },
+		{ "stats", "Appends per-file throughput and latency to the CSV file.", "path" },
+		{ "overlap", "Frames processed before each chunk of a single video, "
+			"for the temporal effects to settle.", "frames", QString::number(defaultOverlapFrames) },
+	});
+	addEffectOptions(parser);
+	parser.process(app);
+
+	if (!parser.isSet("input") || !parser.isSet("output-dir")) {
+		printError("--input and --output-dir are required");
+		return 1;
+	}
+	QDir outputDir(parser.value("output-dir"));
+	if (!QDir().mkpath(outputDir.absolutePath())) {
+		printError("Failed to create the output directory");
+		return 1;
+	}
+
+	if (QFileInfo(parser.value("input")).absoluteFilePath() == outputDir.absolutePath()) {
+		printError("The output directory must differ from the input directory");
+		return 1;
+	}
+
+	// A single video is split into chunks, other inputs are processed a file per worker.
+	const bool chunked = isVideoFile(parser.value("input")) && QFileInfo(parser.value("input")).isFile();
+	bool overlapOk = false;
+	const int64_t overlapFrames = parser.value("overlap").toLongLong(&overlapOk);
+	if (!overlapOk || (overlapFrames < 0)) {
+		printError(QString("Invalid overlap: %1").arg(parser.value("overlap")));
+		return 1;
+	}
+
+	std::vector<BatchJob> allJobs;
+	if (!collectJobs(parser.value("input"), outputDir, allJobs)) {
+		printError(QString("Failed to read the manifest: %1").arg(parser.value("input")));
+		return 1;
+	}
+
+	// Workers writing one output would overwrite each other, and the journal
+	// would take both inputs for done.
+	QSet<QString> outputPaths;
+	for (const BatchJob& job : allJobs) {
+		QString outputPath = QFileInfo(job.outputPath).absoluteFilePath();
+		if (QFileInfo(job.inputPath).absoluteFilePath() == outputPath) {
+			printError(QString("The output would overwrite the input: %1").arg(job.inputPath));
+			return 1;
+		}
+		if (outputPaths.contains(outputPath)) {
+			printError(QString("Two inputs have the same output, rename one of them: %1").arg(job.inputPath));
+			return 1;
+		}
+		outputPaths.insert(outputPath);
+	}
+
+	QString journalPath = parser.isSet("journal") ?
+		parser.value("journal") :
+		outputDir.filePath(journalFileName);
+	QSet<QString> doneNames;
+	if (!parser.isSet("restart")) {
+		doneNames = readJournal(journalPath);
+	}
+	std::deque<BatchJob> jobs;
+	for (const BatchJob& job : allJobs) {
+		if (!doneNames.contains(job.name)) {
+			jobs.push_back(job);
+		}
+	}
+	const int skippedCount = int(allJobs.size() - jobs.size());
+	if (jobs.empty()) {
+		std::fprintf(stderr, "Nothing to do, %d files already done\n", skippedCount);
+		return 0;
+	}
+
+	int workerCount = defaultWorkerCount();
+	if (parser.isSet("workers")) {
+		bool ok = false;
+		workerCount = parser.value("workers").toInt(&ok);
+		if (!ok || (workerCount < 1)) {
+			printError(QString("Invalid worker count: %1").arg(parser.value("workers")));
+			return 1;
+		}
+	}
+	if (!chunked) {
+		workerCount = std::min(workerCount, int(jobs.size()));
+	}
+
+	BatchReport report(journalPath, parser.value("stats"), int(jobs.size()));
+	if (!report.open()) {
+		printError("Failed to open the journal or the statistics file");
+		return 1;
+	}
+
+	// The filters are set up here so a bad option fails before any work,
+	// each one is then used by its worker only.
+	std::vector<std::unique_ptr<VideoFilter>> videoFilters;
+	for (int i = 0; i < workerCount; ++i) {
+		std::unique_ptr<VideoFilter> videoFilter(new VideoFilter());
+		if (!videoFilter->isValid()) {
+			printError("Failed to load the SDK");
+			return 1;
+		}
+		if (!applyEffectOptions(parser, videoFilter.get())) {
+			return 1;
+		}
+		if (!videoFilter->hasEnabledEffects()) {
+			printError("No effect is enabled");
+			return 1;
+		}
+		videoFilters.push_back(std::move(videoFilter));
+	}
+
+	if (chunked) {
+		std::fprintf(stderr, "Processing %s in chunks with %d workers\n",
+			qPrintable(jobs.front().name), workerCount);
+	}
+	else {
+		std::fprintf(stderr, "Processing %d files with %d workers, %d already done\n",
+			int(jobs.size()), workerCount, skippedCount);
+	}
+
+	auto beginTime = MetricsClock::now();
+	auto beginCpuTime = processCpuTime();
+	uint64_t beginSystemBusy = 0;
+	uint64_t beginSystemTotal = 0;
+	bool hasSystemTimes = systemCpuTimes(beginSystemBusy, beginSystemTotal);
+
+	if (chunked) {
+		BatchResult result = processChunked(jobs.front(), videoFilters, overlapFrames);
+		report.record(jobs.front(), result);
+	}
+	else {
+		std::mutex jobMutex;
+		std::vector<std::thread> workers;
+		for (int i = 0; i < workerCount; ++i) {
+			VideoFilter* videoFilter = videoFilters[i].get();
+			workers.emplace_back([&jobs, &jobMutex, &report, videoFilter] {
+				while (true) {
+					BatchJob job;
+					{
+						std::lock_guard<std::mutex> lock(jobMutex);
+						if (jobs.empty()) {
+							break;
+						}
+						job = jobs.front();
+						jobs.pop_front();
+					}
+					BatchResult result = processFile(job, videoFilter);
+					report.record(job, result);
+				}
+			});
+		}
+		for (auto& worker : workers) {
+			worker.join();
+		}
+	}
+
+	double seconds = std::chrono::duration<double>(MetricsClock::now() - beginTime).count();
+	double cpuSeconds = std::chrono::duration<double>(processCpuTime() - beginCpuTime).count();
+	std::fprintf(stderr, "Done %d, failed %d, skipped %d files\n",
+		report.doneCount(), report.failedCount(), skippedCount);
+	std::fprintf(stderr, "%llu frames in %.1f s, %.1f fps\n",
+		static_cast<unsigned long long>(report.frameCount()), seconds,
+		(seconds > 0) ? double(report.frameCount()) / seconds : 0.0);
+	std::fprintf(stderr, "Process CPU %.1f s, %.0f%% of %d cores\n",
+		cpuSeconds, (seconds > 0) ? 100 * cpuSeconds / (seconds * logicalCoreCount()) : 0.0,
+		logicalCoreCount());
+	uint64_t endSystemBusy = 0;
+	uint64_t endSystemTotal = 0;
+	if (hasSystemTimes && systemCpuTimes(endSystemBusy, endSystemTotal) &&
+		(endSystemTotal > beginSystemTotal)) {
+		std::fprintf(stderr, "Machine CPU utilization %.0f%%\n",
+			100.0 * double(endSystemBusy - beginSystemBusy) / double(endSystemTotal - beginSystemTotal));
+	}
+
+	return (0 == report.failedCount()) ? 0 : 1;
+}
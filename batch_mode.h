@@ -0,0 +1,14 @@
+#ifndef BATCH_MODE_H
+#define BATCH_MODE_H
+
+// Headless processing of many recordings on a pool of workers:
+//   Sample --batch --input recordings/ --output-dir processed/ --blur
+// The input is a directory searched recursively for videos, or a manifest
+// file with one path per line. Every worker owns its own pipeline. Finished
+// files are recorded in a journal, so a rerun resumes after the last done
+// file. See --batch --help for the options.
+bool isBatchModeRequested(int argc, char* argv[]);
+// Runs before any QApplication exists, returns the exit code.
+int runBatchMode(int argc, char* argv[]);
+
+#endif
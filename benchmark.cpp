@@ -0,0 +1,209 @@
+#include "benchmark.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <numeric>
+#include <sstream>
+
+using BenchmarkClock = std::chrono::steady_clock;
+
+static const auto minBatchTime = std::chrono::microseconds(200);
+static const int64_t maxBatchSize = int64_t(1) << 24;
+static const size_t minSampleCount = 10;
+static const size_t maxSampleCount = 10000;
+
+static const void* volatile keptValue = nullptr;
+
+void benchmarkKeep(const void* value)
+{
+	keptValue = value;
+}
+
+static double runBatch(const std::function<void()>& body, int64_t batchSize)
+{
+	auto beginTime = BenchmarkClock::now();
+	for (int64_t i = 0; i < batchSize; ++i) {
+		body();
+	}
+	return std::chrono::duration<double, std::nano>(BenchmarkClock::now() - beginTime).count();
+}
+
+static std::string baselineKey(const std::string& name, const std::string& argument)
+{
+	return name + ',' + argument;
+}
+
+static std::string jsonString(const std::string& value)
+{
+	std::string result = "\"";
+	for (char c : value) {
+		if (('"' == c) || ('\\' == c)) {
+			result += '\\';
+		}
+		result += c;
+	}
+	return result + '"';
+}
+
+void BenchmarkRunner::setFilter(const std::string& filter)
+{
+	_filter = filter;
+}
+
+void BenchmarkRunner::setMinTime(double seconds)
+{
+	_minTime = seconds;
+}
+
+bool BenchmarkRunner::loadBaseline(const std::string& path)
+{
+	std::ifstream file(path);
+	if (!file) {
+		return false;
+	}
+
+	// name,argument,iterations,min_ns,median_ns,...
+	std::string line;
+	std::getline(file, line);
+	while (std::getline(file, line)) {
+		std::vector<std::string> fields;
+		std::stringstream lineStream(line);
+		std::string field;
+		while (std::getline(lineStream, field, ',')) {
+			fields.push_back(field);
+		}
+		if (fields.size() >= 5) {
+			_baseline[baselineKey(fields[0], fields[1])] = std::atof(fields[4].c_str());
+		}
+	}
+	return true;
+}
+
+bool BenchmarkRunner::isEnabled(const std::string& name) const
+{
+	return _filter.empty() || (std::string::npos != name.find(_filter));
+}
+
+void BenchmarkRunner::run(
+	const std::string& name,
+	const std::string& argument,
+	int64_t bytesPerIteration,
+	const std::function<void()>& body
+)
+{
+	if (!isEnabled(name)) {
+		return;
+	}
+
+	// The first call warms up the caches and lazy initialization.
+	body();
+	int64_t batchSize = 1;
+	while ((runBatch(body, batchSize) < std::chrono::duration<double, std::nano>(minBatchTime).count()) &&
+		(batchSize < maxBatchSize)) {
+		batchSize *= 2;
+	}
+
+	std::vector<double> samples;
+	auto beginTime = BenchmarkClock::now();
+	auto minTime = std::chrono::duration<double>(_minTime);
+	while ((samples.size() < minSampleCount) ||
+		((BenchmarkClock::now() - beginTime < minTime) && (samples.size() < maxSampleCount))) {
+		samples.push_back(runBatch(body, batchSize) / double(batchSize));
+	}
+	std::sort(samples.begin(), samples.end());
+
+	BenchmarkResult result;
+	result.name = name;
+	result.argument = argument;
+	result.iterations = int64_t(samples.size()) * batchSize;
+	result.minNs = samples.front();
+	result.medianNs = samples[samples.size() / 2];
+	result.meanNs = std::accumulate(samples.begin(), samples.end(), 0.0) / double(samples.size());
+	result.p95Ns = samples[std::min(samples.size() - 1, samples.size() * 95 / 100)];
+	if ((bytesPerIteration > 0) && (result.medianNs > 0)) {
+		result.bytesPerSecond = double(bytesPerIteration) * 1e9 / result.medianNs;
+	}
+	auto baselineIter = _baseline.find(baselineKey(name, argument));
+	if (baselineIter != _baseline.end()) {
+		result.baselineMedianNs = baselineIter->second;
+	}
+	_results.push_back(result);
+
+	std::fprintf(
+		stderr,
+		"%-44s %-10s %12.0f ns median %12.0f ns p95",
+		name.c_str(),
+		argument.c_str(),
+		result.medianNs,
+		result.p95Ns
+	);
+	if (result.bytesPerSecond > 0) {
+		std::fprintf(stderr, " %9.1f MB/s", result.bytesPerSecond / 1e6);
+	}
+	if (result.baselineMedianNs > 0) {
+		std::fprintf(stderr, " %+7.1f%%", (result.medianNs / result.baselineMedianNs - 1) * 100);
+	}
+	std::fprintf(stderr, "\n");
+}
+
+void BenchmarkRunner::skip(const std::string& name, const std::string& reason)
+{
+	if (isEnabled(name)) {
+		std::fprintf(stderr, "%-44s skipped: %s\n", name.c_str(), reason.c_str());
+	}
+}
+
+const std::vector<BenchmarkResult>& BenchmarkRunner::results() const
+{
+	return _results;
+}
+
+void BenchmarkRunner::writeJson(std::ostream& stream, const std::map<std::string, std::string>& context) const
+{
+	stream.precision(12);
+	stream << "{\n  \"context\": {";
+	const char* separator = "\n";
+	for (auto& entry : context) {
+		stream << separator << "    " << jsonString(entry.first) << ": " << jsonString(entry.second);
+		separator = ",\n";
+	}
+	stream << "\n  },\n  \"benchmarks\": [";
+	separator = "\n";
+	for (auto& result : _results) {
+		stream << separator
+			<< "    {\"name\": " << jsonString(result.name)
+			<< ", \"argument\": " << jsonString(result.argument)
+			<< ", \"iterations\": " << result.iterations
+			<< ", \"min_ns\": " << result.minNs
+			<< ", \"median_ns\": " << result.medianNs
+			<< ", \"mean_ns\": " << result.meanNs
+			<< ", \"p95_ns\": " << result.p95Ns
+			<< ", \"bytes_per_second\": " << result.bytesPerSecond;
+		if (result.baselineMedianNs > 0) {
+			stream << ", \"baseline_median_ns\": " << result.baselineMedianNs;
+		}
+		stream << "}";
+		separator = ",\n";
+	}
+	stream << "\n  ]\n}\n";
+}
+
+void BenchmarkRunner::writeCsv(std::ostream& stream) const
+{
+	stream.precision(12);
+	stream << "name,argument,iterations,min_ns,median_ns,mean_ns,p95_ns,bytes_per_second,baseline_median_ns\n";
+	for (auto& result : _results) {
+		stream << result.name << ','
+			<< result.argument << ','
+			<< result.iterations << ','
+			<< result.minNs << ','
+			<< result.medianNs << ','
+			<< result.meanNs << ','
+			<< result.p95Ns << ','
+			<< result.bytesPerSecond << ','
+			<< result.baselineMedianNs << '\n';
+	}
+}
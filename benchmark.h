@@ -0,0 +1,67 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// A minimal harness for the microbenchmarks in benchmarks.cpp. A case runs in
+// batches sized to take at least a fraction of a millisecond, so the clock
+// resolution does not matter, until the minimum time and sample count are
+// reached. The statistics are per iteration over the batches.
+struct BenchmarkResult
+{
+	std::string name;
+	// The frame size or another parameter of the case, e.g. "1280x720".
+	std::string argument;
+	int64_t iterations = 0;
+	double minNs = 0;
+	double medianNs = 0;
+	double meanNs = 0;
+	double p95Ns = 0;
+	// Zero when the case does not process bytes.
+	double bytesPerSecond = 0;
+	// The median of the same case in the baseline, zero if it has none.
+	double baselineMedianNs = 0;
+};
+
+class BenchmarkRunner
+{
+public:
+	// Cases whose name does not contain the filter are not run.
+	void setFilter(const std::string& filter);
+	void setMinTime(double seconds);
+	// Reads the medians of a CSV written by writeCsv(), the results are
+	// compared with them. Returns false if the file cannot be read.
+	bool loadBaseline(const std::string& path);
+
+	bool isEnabled(const std::string& name) const;
+	// bytesPerIteration gives the throughput, zero for none.
+	void run(
+		const std::string& name,
+		const std::string& argument,
+		int64_t bytesPerIteration,
+		const std::function<void()>& body
+	);
+	// Reported for cases that cannot run here, e.g. without the SDK.
+	void skip(const std::string& name, const std::string& reason);
+
+	const std::vector<BenchmarkResult>& results() const;
+	// context goes to the JSON output as is, e.g. the instruction set.
+	void writeJson(std::ostream& stream, const std::map<std::string, std::string>& context) const;
+	void writeCsv(std::ostream& stream) const;
+
+private:
+	std::string _filter;
+	double _minTime = 0.5;
+	std::map<std::string, double> _baseline;
+	std::vector<BenchmarkResult> _results;
+};
+
+// Keeps the compiler from dropping a computation whose result is unused.
+void benchmarkKeep(const void* value);
+
+#endif
@@ -0,0 +1,554 @@
+#include "benchmark.h"
+#include "frame_view.h"
+#include "image_blur.h"
+#include "metrics.h"
+#include "pixel_convert.h"
+#include "sdk_context.h"
+#include "sdk_releaser.h"
+#include "video_filter.h"
+
+#include "vb_sdk/sdk_factory.h"
+
+#include <QApplication>
+#include <QCommandLineParser>
+#include <QDateTime>
+#include <QTemporaryDir>
+#include <QThread>
+
+#include <opencv2/opencv.hpp>
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <thread>
+
+static const cv::Size frameSizes[] = {
+	cv::Size(640, 360),
+	cv::Size(1280, 720),
+	cv::Size(1920, 1080),
+	cv::Size(3840, 2160)
+};
+
+static const PixelConvertIsa convertIsas[] = {
+	PixelConvertIsa::scalar,
+	PixelConvertIsa::sse41,
+	PixelConvertIsa::avx2,
+	PixelConvertIsa::avx512,
+	PixelConvertIsa::neon
+};
+
+// Frames arriving at 30, 60 and 240 fps, and a backlog.
+static const int metricsHistorySizes[] = { 30, 60, 240, 1000 };
+
+// The default blur power of VideoFilter, 0.5, at the radius it maps to.
+static int defaultBlurRadius(const cv::Size& size)
+{
+	return std::max(1, int(0.5f * 0.03f * float(std::max(size.width, size.height)) + 0.5f));
+}
+
+static std::string sizeName(const cv::Size& size)
+{
+	return std::to_string(size.width) + "x" + std::to_string(size.height);
+}
+
+static void printError(const QString& message)
+{
+	std::fprintf(stderr, "%s\n", qPrintable(message));
+}
+
+static bool parseSize(const QString& value, QSize& size)
+{
+	QStringList parts = value.split('x');
+	if (2 != parts.size()) {
+		return false;
+	}
+	bool widthOk = false;
+	bool heightOk = false;
+	size = QSize(parts[0].toInt(&widthOk), parts[1].toInt(&heightOk));
+	return widthOk && heightOk && !size.isEmpty();
+}
+
+static cv::Mat randomMat(int rows, int cols, int type)
+{
+	cv::Mat mat(rows, cols, type);
+	cv::randu(mat, cv::Scalar::all(0), cv::Scalar::all(256));
+	return mat;
+}
+
+static QImage wrapMat(const cv::Mat& mat)
+{
+	return QImage(mat.data, mat.cols, mat.rows, int(mat.step), QImage::Format_ARGB32);
+}
+
+// The converters run once per instruction set the CPU has, the detected one is restored.
+static void runForEachIsa(
+	BenchmarkRunner& runner,
+	const std::string& name,
+	const std::string& argument,
+	int64_t bytesPerIteration,
+	const std::function<void()>& body
+)
+{
+	PixelConvertIsa detectedIsa = pixelConvertIsa();
+	for (PixelConvertIsa isa : convertIsas) {
+		if (setPixelConvertIsa(isa)) {
+			runner.run(name + "/" + pixelConvertIsaName(isa), argument, bytesPerIteration, body);
+		}
+	}
+	setPixelConvertIsa(detectedIsa);
+}
+
+// The throughput counts the bytes of the converted frame.
+static void runConvertBenchmarks(BenchmarkRunner& runner)
+{
+	for (const cv::Size& size : frameSizes) {
+		const int width = size.width;
+		const int height = size.height;
+		const std::string argument = sizeName(size);
+		const int64_t bgraBytes = int64_t(width) * height * 4;
+		const int64_t yuv420Bytes = int64_t(width) * height * 3 / 2;
+
+		cv::Mat bgr = randomMat(height, width, CV_8UC3);
+		cv::Mat yuyv = randomMat(height, width, CV_8UC2);
+		cv::Mat nv12 = randomMat(height * 3 / 2, width, CV_8UC1);
+		cv::Mat bgra = randomMat(height, width, CV_8UC4);
+		cv::Mat dstBgra(height, width, CV_8UC4);
+		cv::Mat dstYuv420(height * 3 / 2, width, CV_8UC1);
+		uint8_t* dstY = dstYuv420.data;
+		uint8_t* dstU = dstY + width * height;
+		uint8_t* dstV = dstU + (width / 2) * (height / 2);
+
+		runner.run("convert/bgr_to_bgra/opencv", argument, bgraBytes, [&]() {
+			cv::cvtColor(bgr, dstBgra, cv::COLOR_BGR2BGRA);
+		});
+		runForEachIsa(runner, "convert/bgr_to_bgra", argument, bgraBytes, [&]() {
+			convertBGRToBGRA(bgr.data, int(bgr.step), dstBgra.data, int(dstBgra.step), width, height);
+		});
+
+		runner.run("convert/yuyv_to_bgra/opencv", argument, bgraBytes, [&]() {
+			cv::cvtColor(yuyv, dstBgra, cv::COLOR_YUV2BGRA_YUYV);
+		});
+		runForEachIsa(runner, "convert/yuyv_to_bgra", argument, bgraBytes, [&]() {
+			convertYUYVToBGRA(yuyv.data, int(yuyv.step), dstBgra.data, int(dstBgra.step), width, height);
+		});
+
+		runner.run("convert/nv12_to_bgra/opencv", argument, bgraBytes, [&]() {
+			cv::cvtColor(nv12, dstBgra, cv::COLOR_YUV2BGRA_NV12);
+		});
+		runForEachIsa(runner, "convert/nv12_to_bgra", argument, bgraBytes, [&]() {
+			convertNV12ToBGRA(
+				nv12.data, int(nv12.step),
+				nv12.data + height * nv12.step, int(nv12.step),
+				dstBgra.data, int(dstBgra.step),
+				width, height
+			);
+		});
+
+		runner.run("convert/bgra_to_i420/opencv", argument, yuv420Bytes, [&]() {
+			cv::cvtColor(bgra, dstYuv420, cv::COLOR_BGRA2YUV_I420);
+		});
+		runForEachIsa(runner, "convert/bgra_to_i420", argument, yuv420Bytes, [&]() {
+			convertBGRAToI420(
+				bgra.data, int(bgra.step),
+				dstY, width,
+				dstU, width / 2,
+				dstV, width / 2,
+				width, height
+			);
+		});
+
+		// OpenCV has no BGRA to NV12 or YUYV to NV12 conversion.
+		runForEachIsa(runner, "convert/bgra_to_nv12", argument, yuv420Bytes, [&]() {
+			convertBGRAToNV12(
+				bgra.data, int(bgra.step),
+				dstY, width,
+				dstY + width * height, width,
+				width, height
+			);
+		});
+		runForEachIsa(runner, "convert/yuyv_to_nv12", argument, yuv420Bytes, [&]() {
+			convertYUYVToNV12(
+				yuyv.data, int(yuyv.step),
+				dstY, width,
+				dstY + width * height, width,
+				width, height
+			);
+		});
+
+		runner.run("convert/rgbx_to_bgra/opencv", argument, bgraBytes, [&]() {
+			cv::cvtColor(bgra, dstBgra, cv::COLOR_RGBA2BGRA);
+		});
+		runForEachIsa(runner, "convert/rgbx_to_bgra", argument, bgraBytes, [&]() {
+			convertRGBXToBGRA(bgra.data, int(bgra.step), dstBgra.data, int(dstBgra.step), width, height);
+		});
+		runForEachIsa(runner, "convert/bgrx_to_bgra", argument, bgraBytes, [&]() {
+			convertBGRXToBGRA(bgra.data, int(bgra.step), dstBgra.data, int(dstBgra.step), width, height);
+		});
+	}
+}
+
+// What the static blurred background saves per frame is the blur of the
+// background, measured here with our blur, and in the SDK cases end to end.
+static void runBlurBenchmarks(BenchmarkRunner& runner)
+{
+	for (const cv::Size& size : frameSizes) {
+		cv::Mat background = randomMat(size.height, size.width, CV_8UC4);
+		int radius = defaultBlurRadius(size);
+		runner.run("blur/background", sizeName(size), int64_t(background.total()) * 4, [&]() {
+			blurBGRA(background.data, size.width, size.height, int(background.step), radius);
+		});
+	}
+}
+
+static void runImageCopyBenchmarks(BenchmarkRunner& runner)
+{
+	for (const cv::Size& size : frameSizes) {
+		cv::Mat frame = randomMat(size.height, size.width, CV_8UC4);
+		QImage image = wrapMat(frame);
+		runner.run("qimage/copy", sizeName(size), int64_t(frame.total()) * 4, [&]() {
+			QImage copy = image.copy();
+			benchmarkKeep(copy.constBits());
+		});
+	}
+}
+
+// The history is the frames of the last second, kept at the size by
+// advancing the timestamps by a second over the history size.
+static void runMetricsBenchmarks(BenchmarkRunner& runner)
+{
+	for (int historySize : metricsHistorySizes) {
+		Metrics metrics;
+		const auto step = std::chrono::duration_cast<MetricsClock::duration>(std::chrono::seconds(1)) / historySize;
+		FrameTimeInfo info;
+		info.duration = std::chrono::milliseconds(10);
+		info.timestamp = MetricsClock::now();
+		info.size = QSize(1280, 720);
+		for (int i = 0; i < historySize; ++i) {
+			info.timestamp += step;
+			metrics.onFrameProcessed(info);
+		}
+
+		const std::string argument = std::to_string(historySize);
+		runner.run("metrics/on_frame_processed", argument, 0, [&]() {
+			info.timestamp += step;
+			metrics.onFrameProcessed(info);
+		});
+		runner.run("metrics/avg_time_per_frame", argument, 0, [&]() {
+			auto duration = metrics.avgTimePerFrame();
+			benchmarkKeep(&duration);
+		});
+	}
+}
+
+// The pipeline scales frames to the view before frameAvailable, FrameView
+// paints them unscaled. Frames of another size are scaled while painting.
+static void runFrameViewBenchmarks(BenchmarkRunner& runner, const QSize& displaySize)
+{
+	FrameView view;
+	view.resize(displaySize);
+	QImage target(displaySize, QImage::Format_ARGB32_Premultiplied);
+
+	for (const cv::Size& size : frameSizes) {
+		cv::Mat frameMat = randomMat(size.height, size.width, CV_8UC4);
+		QImage frame = wrapMat(frameMat);
+		QSize scaledSize = frame.size().scaled(displaySize, Qt::KeepAspectRatio);
+		const std::string argument = sizeName(size);
+
+		QImage scaled;
+		runner.run("frame_view/scale_for_display", argument, int64_t(scaledSize.width()) * scaledSize.height() * 4, [&]() {
+			scaled = scaleImageForDisplay(frame, scaledSize);
+		});
+		runner.run("frame_view/paint_prescaled", argument, 0, [&]() {
+			view.present(scaled);
+			view.render(&target);
+		});
+		runner.run("frame_view/paint_scaled", argument, 0, [&]() {
+			view.present(frame);
+			view.render(&target);
+		});
+	}
+}
+
+// The pipeline thread waits on condition variables for the GUI thread, e.g.
+// for a consumer, and hands frames to it with queued signals. Both are
+// measured as a round trip to another thread and back.
+static void runHandoffBenchmarks(BenchmarkRunner& runner)
+{
+	std::mutex mutex;
+	std::condition_variable condition;
+
+	runner.run("handoff/mutex_lock_unlock", "", 0, [&]() {
+		std::lock_guard<std::mutex> lock(mutex);
+	});
+
+	if (runner.isEnabled("handoff/condition_variable_round_trip")) {
+		int64_t sentCount = 0;
+		int64_t echoedCount = 0;
+		bool stopRequested = false;
+		std::thread echoThread([&]() {
+			std::unique_lock<std::mutex> lock(mutex);
+			while (true) {
+				condition.wait(lock, [&]() {
+					return stopRequested || (sentCount != echoedCount);
+				});
+				if (stopRequested) {
+					return;
+				}
+				echoedCount = sentCount;
+				condition.notify_all();
+			}
+		});
+		runner.run("handoff/condition_variable_round_trip", "", 0, [&]() {
+			std::unique_lock<std::mutex> lock(mutex);
+			++sentCount;
+			condition.notify_all();
+			condition.wait(lock, [&]() {
+				return sentCount == echoedCount;
+			});
+		});
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopRequested = true;
+		}
+		condition.notify_all();
+		echoThread.join();
+	}
+
+	if (runner.isEnabled("handoff/queued_signal_round_trip")) {
+		QThread receiverThread;
+		QObject receiver;
+		receiver.moveToThread(&receiverThread);
+		receiverThread.start();
+		bool received = false;
+		runner.run("handoff/queued_signal_round_trip", "", 0, [&]() {
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				received = false;
+			}
+			QMetaObject::invokeMethod(&receiver, [&]() {
+				{
+					std::lock_guard<std::mutex> lock(mutex);
+					received = true;
+				}
+				condition.notify_all();
+			}, Qt::QueuedConnection);
+			std::unique_lock<std::mutex> lock(mutex);
+			condition.wait(lock, [&]() {
+				return received;
+			});
+		});
+		receiverThread.quit();
+		receiverThread.wait();
+	}
+}
+
+static void skipSdkBenchmarks(BenchmarkRunner& runner, const std::string& reason)
+{
+	runner.skip("sdk/create_bgra", reason);
+	runner.skip("sdk/create_bgra_copy", reason);
+	runner.skip("sdk/output_copy", reason);
+	runner.skip("sdk/blur_replace/sdk_blur", reason);
+	runner.skip("sdk/blur_replace/static_blur", reason);
+}
+
+// Wrapping frames for the SDK, copying its output as replaceBG() does, and
+// blur with replacement with and without the static blurred background.
+static void runSdkBenchmarks(BenchmarkRunner& runner)
+{
+	std::shared_ptr<SdkContext> context = SdkContext::shared();
+	if (nullptr == context) {
+		skipSdkBenchmarks(runner, "the SDK failed to load or to authorize");
+		return;
+	}
+	std::unique_ptr<tsvb::IFrameFactory, Releaser> frameFactory(context->createFrameFactory());
+	if (nullptr == frameFactory) {
+		skipSdkBenchmarks(runner, "no frame factory");
+		return;
+	}
+
+	QTemporaryDir tempDir;
+	QString backgroundPath = tempDir.filePath("background.png");
+	QImage background(QSize(1920, 1080), QImage::Format_RGB32);
+	for (int y = 0; y < background.height(); ++y) {
+		auto line = reinterpret_cast<QRgb*>(background.scanLine(y));
+		for (int x = 0; x < background.width(); ++x) {
+			line[x] = qRgb(x * 255 / background.width(), y * 255 / background.height(), 128);
+		}
+	}
+	background.save(backgroundPath);
+
+	for (const cv::Size& size : frameSizes) {
+		const std::string argument = sizeName(size);
+		cv::Mat frameMat = randomMat(size.height, size.width, CV_8UC4);
+		const int64_t frameBytes = int64_t(frameMat.total()) * 4;
+
+		runner.run("sdk/create_bgra", argument, 0, [&]() {
+			tsvb::IFrame* frame = frameFactory->createBGRA(
+				frameMat.data, int(frameMat.step), size.width, size.height, false
+			);
+			if (nullptr != frame) {
+				frame->release();
+			}
+		});
+		runner.run("sdk/create_bgra_copy", argument, frameBytes, [&]() {
+			tsvb::IFrame* frame = frameFactory->createBGRA(
+				frameMat.data, int(frameMat.step), size.width, size.height, true
+			);
+			if (nullptr != frame) {
+				frame->release();
+			}
+		});
+
+		std::unique_ptr<tsvb::IFrame, Releaser> output(frameFactory->createBGRA(
+			frameMat.data, int(frameMat.step), size.width, size.height, true
+		));
+		if (nullptr == output) {
+			runner.skip("sdk/output_copy", "no frame");
+			continue;
+		}
+		runner.run("sdk/output_copy", argument, frameBytes, [&]() {
+			std::unique_ptr<tsvb::ILockedFrameData, Releaser> lockedData(
+				output->lock(tsvb::FrameLock::read)
+			);
+			QImage copy = QImage(
+				reinterpret_cast<const uchar*>(lockedData->dataPointer(0)),
+				output->width(),
+				output->height(),
+				lockedData->bytesPerLine(0),
+				QImage::Format_ARGB32
+			).copy();
+			benchmarkKeep(copy.constBits());
+		});
+
+		if (!runner.isEnabled("sdk/blur_replace")) {
+			continue;
+		}
+		VideoFilter filter;
+		if (!filter.isValid()) {
+			skipSdkBenchmarks(runner, "the video filter failed to initialize");
+			return;
+		}
+		QImage frame = wrapMat(frameMat);
+		filter.setFrameSize(frame.size());
+		filter.setBackground(backgroundPath);
+		if (!filter.enableBlur() || !filter.enableReplacement()) {
+			runner.skip("sdk/blur_replace", "blur or replacement failed to enable");
+			continue;
+		}
+		filter.setStaticBlurBackgroundEnabled(false);
+		runner.run("sdk/blur_replace/sdk_blur", argument, 0, [&]() {
+			QImage result = filter.replaceBG(frame);
+			benchmarkKeep(result.constBits());
+		});
+		filter.setStaticBlurBackgroundEnabled(true);
+		runner.run("sdk/blur_replace/static_blur", argument, 0, [&]() {
+			QImage result = filter.replaceBG(frame);
+			benchmarkKeep(result.constBits());
+		});
+	}
+}
+
+static bool writeOutput(const QString& path, const std::function<void(std::ostream&)>& write)
+{
+	if ("-" == path) {
+		write(std::cout);
+		return bool(std::cout);
+	}
+	std::ofstream file(path.toStdString());
+	write(file);
+	return bool(file);
+}
+
+int main(int argc, char* argv[])
+{
+	// FrameView paints into images, no display is needed.
+	if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM")) {
+		qputenv("QT_QPA_PLATFORM", "offscreen");
+	}
+	QApplication app(argc, argv);
+	app.setApplicationVersion(TSVB_VERSION_STRING);
+
+	QCommandLineParser parser;
+	parser.setApplicationDescription("Microbenchmarks of the frame path.");
+	parser.addHelpOption();
+	parser.addOptions({
+		{ "filter", "Runs the cases whose name contains the text.", "text" },
+		{ "min-time", "Minimum time of a case.", "seconds", "0.5" },
+		{ "json", "Writes the results as JSON, - for stdout.", "path" },
+		{ "csv", "Writes the results as CSV, - for stdout.", "path" },
+		{ "baseline", "Compares the medians with the CSV of an earlier run.", "path" },
+		{ "sdk", "Also runs the cases which load and authorize the SDK." },
+		{ "opencv-threads", "Threads of OpenCV, 1 compares it with the single threaded converters.", "count", "1" },
+		{ "display-size", "Size of the view in the FrameView cases.", "WxH", "1280x720" },
+	});
+	parser.process(app);
+
+	BenchmarkRunner runner;
+	runner.setFilter(parser.value("filter").toStdString());
+	bool minTimeOk = false;
+	double minTime = parser.value("min-time").toDouble(&minTimeOk);
+	if (!minTimeOk || (minTime < 0)) {
+		printError(QString("Invalid minimum time: %1").arg(parser.value("min-time")));
+		return 1;
+	}
+	runner.setMinTime(minTime);
+	if (parser.isSet("baseline") && !runner.loadBaseline(parser.value("baseline").toStdString())) {
+		printError(QString("Failed to read the baseline: %1").arg(parser.value("baseline")));
+		return 1;
+	}
+	bool threadsOk = false;
+	int opencvThreads = parser.value("opencv-threads").toInt(&threadsOk);
+	if (!threadsOk) {
+		printError(QString("Invalid thread count: %1").arg(parser.value("opencv-threads")));
+		return 1;
+	}
+	cv::setNumThreads(opencvThreads);
+	QSize displaySize;
+	if (!parseSize(parser.value("display-size"), displaySize)) {
+		printError(QString("Invalid display size: %1").arg(parser.value("display-size")));
+		return 1;
+	}
+
+	runConvertBenchmarks(runner);
+	runBlurBenchmarks(runner);
+	runImageCopyBenchmarks(runner);
+	runMetricsBenchmarks(runner);
+	runFrameViewBenchmarks(runner, displaySize);
+	runHandoffBenchmarks(runner);
+	if (parser.isSet("sdk")) {
+		runSdkBenchmarks(runner);
+	}
+	else {
+		skipSdkBenchmarks(runner, "run with --sdk");
+	}
+
+	const std::map<std::string, std::string> context = {
+		{ "date", QDateTime::currentDateTimeUtc().toString(Qt::ISODate).toStdString() },
+		{ "version", TSVB_VERSION_STRING },
+		{ "pixel_convert_isa", pixelConvertIsaName(pixelConvertIsa()) },
+		{ "hardware_threads", std::to_string(std::thread::hardware_concurrency()) },
+		{ "opencv_version", CV_VERSION },
+		{ "opencv_threads", std::to_string(opencvThreads) },
+		{ "qt_version", qVersion() },
+		{ "min_time", parser.value("min-time").toStdString() },
+	};
+	bool ok = true;
+	if (parser.isSet("json")) {
+		ok = writeOutput(parser.value("json"), [&](std::ostream& stream) {
+			runner.writeJson(stream, context);
+		}) && ok;
+	}
+	if (parser.isSet("csv")) {
+		ok = writeOutput(parser.value("csv"), [&](std::ostream& stream) {
+			runner.writeCsv(stream);
+		}) && ok;
+	}
+	if (!ok) {
+		printError("Failed to write the results");
+		return 1;
+	}
+	return 0;
+}
@@ -4,6 +4,8 @@
 static const char DEFAULT_CAMERA_SCALE[] = "720p";
 static const int DEFAULT_SCALE_WIDTH = 1280;
 static const int DEFAULT_SCALE_HEIGHT = 720;
+static const int DEFAULT_CAPTURE_WIDTH = 1920;
+static const int DEFAULT_CAPTURE_HEIGHT = 1080;
 
 enum class Backend
 {
@@ -19,4 +21,12 @@ enum class Preset : int
 	lightning = 4
 };
 
+enum class Effect
+{
+	beautification,
+	colorCorrection,
+	colorGrading,
+	replacement
+};
+
 #endif
\ No newline at end of file
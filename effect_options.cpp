@@ -0,0 +1,67 @@
+#include "effect_options.h"
+
+#include "video_filter.h"
+
+#include <cstdio>
+
+static void printError(const QString& message)
+{
+	std::fprintf(stderr, "%s\n", qPrintable(message));
+}
+
+void addEffectOptions(QCommandLineParser& parser)
+{
+	parser.addOptions({
+		{ "backend", "cpu or gpu.", "backend" },
+		{ "blur", "Blurs the background." },
+		{ "replace", "Replaces the background with the image or video.", "path" },
+		{ "denoise", "Removes the noise." },
+		{ "beautify", "Enables beautification." },
+		{ "sharpen", "Sharpens the frames." },
+		{ "low-light", "Brightens dark frames." },
+		{ "color-correction", "Enables color correction." },
+	});
+}
+
+bool applyEffectOptions(const QCommandLineParser& parser, VideoFilter* videoFilter)
+{
+	if (parser.isSet("backend")) {
+		QString backendName = parser.value("backend");
+		if (("cpu" != backendName) && ("gpu" != backendName)) {
+			printError(QString("Unknown backend: %1").arg(backendName));
+			return false;
+		}
+		if (!videoFilter->setBackend(("gpu" == backendName) ? Backend::gpu : Backend::cpu)) {
+			printError("Failed to set the backend");
+			return false;
+		}
+	}
+
+	bool ok = true;
+	if (parser.isSet("replace")) {
+		videoFilter->setBackground(parser.value("replace"));
+		ok = ok && videoFilter->enableReplacement();
+	}
+	if (parser.isSet("blur")) {
+		ok = ok && videoFilter->enableBlur();
+	}
+	if (parser.isSet("denoise")) {
+		ok = ok && videoFilter->enableDenoise();
+	}
+	if (parser.isSet("beautify")) {
+		ok = ok && videoFilter->enableBeautification();
+	}
+	if (parser.isSet("sharpen")) {
+		ok = ok && videoFilter->enableSharpening();
+	}
+	if (parser.isSet("low-light")) {
+		ok = ok && videoFilter->enableLowLightAdjustment();
+	}
+	if (parser.isSet("color-correction")) {
+		ok = ok && videoFilter->enableColorCorrection();
+	}
+	if (!ok) {
+		printError("Failed to enable the effects");
+	}
+	return ok;
+}
@@ -0,0 +1,15 @@
+#ifndef EFFECT_OPTIONS_H
+#define EFFECT_OPTIONS_H
+
+#include <QCommandLineParser>
+
+class VideoFilter;
+
+// Command line options of the effects, shared by the headless modes:
+// --backend, --blur, --replace, --denoise, --beautify, --sharpen,
+// --low-light and --color-correction.
+void addEffectOptions(QCommandLineParser& parser);
+// Enables the effects given on the command line, prints the failure to stderr.
+bool applyEffectOptions(const QCommandLineParser& parser, VideoFilter* videoFilter);
+
+#endif
@@ -0,0 +1,254 @@
+#include "encoder_sink.h"
+
+#include <QFileInfo>
+
+#include <algorithm>
+#include <cmath>
+
+int videoFourccForFile(const std::string& filePath)
+{
+	QString suffix = QFileInfo(QString::fromStdString(filePath)).suffix().toLower();
+	if ("avi" == suffix) {
+		return cv::VideoWriter::fourcc('M', 'J', 'P', 'G');
+	}
+	if ("mkv" == suffix) {
+		return cv::VideoWriter::fourcc('F', 'F', 'V', '1');
+	}
+	return cv::VideoWriter::fourcc('m', 'p', '4', 'v');
+}
+
+EncoderSink::EncoderSink(
+	const std::string& filePath,
+	double fps,
+	int queueSize,
+	EncoderDropPolicy dropPolicy,
+	EncoderTiming timing,
+	Metrics* metrics
+)
+	: _filePath(filePath)
+	, _fps(fps)
+	, _dropPolicy(dropPolicy)
+	, _timing(timing)
+	, _metrics(metrics)
+{
+	_pool.resize(std::max(queueSize, 1));
+	for (int i = 0; i < int(_pool.size()); ++i) {
+		_freeFrames.push_back(i);
+	}
+	_encodeThread = std::thread([this] { encodeLoop(); });
+}
+
+EncoderSink::~EncoderSink()
+{
+	finish();
+}
+
+bool EncoderSink::isValid() const
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	return !_failed;
+}
+
+bool EncoderSink::finish()
+{
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_stopRequested = true;
+	}
+	_condition.notify_all();
+	if (_encodeThread.joinable()) {
+		_encodeThread.join();
+	}
+	std::lock_guard<std::mutex> lock(_mutex);
+	return !_failed;
+}
+
+void EncoderSink::finish(std::function<void(bool)> finished)
+{
+	bool ok = false;
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		if (!_stopRequested) {
+			// The encode thread runs until it is stopped.
+			_stopRequested = true;
+			_finished = std::move(finished);
+			finished = nullptr;
+		}
+		ok = !_failed;
+	}
+	_condition.notify_all();
+	// Finished already.
+	if (nullptr != finished) {
+		finished(ok);
+	}
+}
+
+void EncoderSink::consume(const QImage& frame, MetricsClock::time_point timestamp)
+{
+	// Mattes are encoded as gray video.
+	const bool gray = (QImage::Format_Grayscale8 == frame.format());
+	if (!gray && (32 != frame.depth())) {
+		return;
+	}
+	const int frameType = gray ? CV_8UC1 : CV_8UC4;
+
+	int index = -1;
+	bool dropped = false;
+	{
+		std::unique_lock<std::mutex> lock(_mutex);
+		if (EncoderDropPolicy::block == _dropPolicy) {
+			_condition.wait(lock, [this] {
+				return _failed || _stopRequested || !_freeFrames.empty();
+			});
+		}
+		if (_failed || _stopRequested) {
+			return;
+		}
+		if (!_freeFrames.empty()) {
+			index = _freeFrames.back();
+			_freeFrames.pop_back();
+		}
+		else if ((EncoderDropPolicy::dropOldest == _dropPolicy) && !_queuedFrames.empty()) {
+			index = _queuedFrames.front();
+			_queuedFrames.pop_front();
+			dropped = true;
+		}
+		else {
+			dropped = true;
+		}
+	}
+	if (dropped && (nullptr != _metrics)) {
+		_metrics->onEncoderFrameDropped();
+	}
+	if (-1 == index) {
+		return;
+	}
+
+	// The pool frames keep their buffers while the size stays the same.
+	PooledFrame& pooledFrame = _pool[index];
+	pooledFrame.timestamp = timestamp;
+	pooledFrame.frame.create(frame.height(), frame.width(), frameType);
+	const cv::Mat source(
+		frame.height(),
+		frame.width(),
+		frameType,
+		const_cast<uchar*>(frame.constBits()),
+		frame.bytesPerLine()
+	);
+	source.copyTo(pooledFrame.frame);
+
+	size_t queueDepth = 0;
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_queuedFrames.push_back(index);
+		queueDepth = _queuedFrames.size();
+	}
+	_condition.notify_one();
+	if (nullptr != _metrics) {
+		_metrics->setEncoderQueueDepth(int(queueDepth), int(_pool.size()));
+	}
+}
+
+bool EncoderSink::openWriter(const cv::Size& size)
+{
+	_videoSize = size;
+	return _writer.open(_filePath, videoFourccForFile(_filePath), _fps, size, true);
+}
+
+bool EncoderSink::writeFrame(const PooledFrame& pooledFrame)
+{
+	const cv::Mat& frame = pooledFrame.frame;
+	if (!_writer.isOpened() && !openWriter(frame.size())) {
+		return false;
+	}
+
+	int64_t frameNumber = _writtenFrameCount;
+	if (EncoderTiming::timestamps == _timing) {
+		if (0 == _writtenFrameCount) {
+			_firstTimestamp = pooledFrame.timestamp;
+		}
+		std::chrono::duration<double> time = pooledFrame.timestamp - _firstTimestamp;
+		frameNumber = std::llround(time.count() * _fps);
+		if (frameNumber < _writtenFrameCount) {
+			// The video has a frame for this time already.
+			return true;
+		}
+		// The previous frame stays on screen until this one was captured.
+		for (; _writtenFrameCount < frameNumber; ++_writtenFrameCount) {
+			_writer.write(_bgrFrame);
+		}
+	}
+
+	const cv::Mat* videoFrame = &frame;
+	if (frame.size() != _videoSize) {
+		cv::resize(frame, _scaledFrame, _videoSize, 0, 0, cv::INTER_AREA);
+		videoFrame = &_scaledFrame;
+	}
+	cv::cvtColor(
+		*videoFrame,
+		_bgrFrame,
+		(1 == videoFrame->channels()) ? cv::COLOR_GRAY2BGR : cv::COLOR_BGRA2BGR
+	);
+	_writer.write(_bgrFrame);
+	++_writtenFrameCount;
+	return true;
+}
+
+void EncoderSink::encodeLoop()
+{
+	while (true) {
+		int index = -1;
+		size_t queueDepth = 0;
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+			_condition.wait(lock, [this] { return _stopRequested || !_queuedFrames.empty(); });
+			if (_queuedFrames.empty()) {
+				// Stopped with everything queued written.
+				break;
+			}
+			index = _queuedFrames.front();
+			_queuedFrames.pop_front();
+			queueDepth = _queuedFrames.size();
+		}
+
+		auto encodeBeginTime = MetricsClock::now();
+		bool ok = writeFrame(_pool[index]);
+		auto encodeEndTime = MetricsClock::now();
+
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_freeFrames.push_back(index);
+			if (!ok) {
+				_failed = true;
+			}
+		}
+		// Wakes a consume() waiting for a free frame.
+		_condition.notify_all();
+		if (nullptr != _metrics) {
+			FrameTimeInfo frameTimeInfo;
+			frameTimeInfo.duration = encodeEndTime - encodeBeginTime;
+			frameTimeInfo.timestamp = encodeEndTime;
+			frameTimeInfo.size = QSize(_videoSize.width, _videoSize.height);
+			_metrics->onFrameEncoded(frameTimeInfo);
+			_metrics->setEncoderQueueDepth(int(queueDepth), int(_pool.size()));
+		}
+		if (!ok) {
+			break;
+		}
+	}
+
+	_writer.release();
+
+	std::function<void(bool)> finished;
+	bool ok = false;
+	{
+		// A failed write stops the thread before it is asked to.
+		std::unique_lock<std::mutex> lock(_mutex);
+		_condition.wait(lock, [this] { return _stopRequested; });
+		finished = std::move(_finished);
+		ok = !_failed;
+	}
+	if (nullptr != finished) {
+		finished(ok);
+	}
+}
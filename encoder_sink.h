@@ -0,0 +1,108 @@
+#ifndef ENCODER_SINK_H
+#define ENCODER_SINK_H
+
+#include "frame_sink.h"
+
+#include <opencv2/opencv.hpp>
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// MJPEG for .avi, lossless FFV1 for .mkv, MPEG-4 otherwise.
+int videoFourccForFile(const std::string& filePath);
+
+enum class EncoderDropPolicy
+{
+	// A full queue rejects the new frame.
+	dropNewest,
+	// A full queue gives up its oldest frame for the new one, keeps the latency low.
+	dropOldest,
+	// A full queue waits for the encoder, for offline processing where every
+	// frame is kept.
+	block
+};
+
+enum class EncoderTiming
+{
+	// Every frame is written once, for offline processing.
+	everyFrame,
+	// The timestamps place the frames in the video, frames are repeated or
+	// skipped so that live capture at any rate plays at the right speed.
+	timestamps
+};
+
+// Records the processed frames to a video file with cv::VideoWriter on its
+// own thread. consume() only copies the frame into a free frame of a fixed
+// pool, frames are dropped or waited for by the policy when the encoder
+// falls behind.
+// The first frame sets the video size, later frames are scaled to it.
+// Grayscale8 frames, e.g. from a matte sink, are written as gray video.
+class EncoderSink : public FrameSink
+{
+public:
+	EncoderSink(
+		const std::string& filePath,
+		double fps,
+		int queueSize,
+		EncoderDropPolicy dropPolicy,
+		EncoderTiming timing,
+		Metrics* metrics
+	);
+	~EncoderSink() override;
+
+	// False once the file could not be opened or written.
+	bool isValid() const;
+	// Encodes the frames still queued and closes the file, returns false if
+	// writing failed. No frames are accepted afterwards.
+	bool finish();
+	// Like finish() without waiting, the encode thread calls finished with the
+	// result when the file is closed.
+	void finish(std::function<void(bool)> finished);
+
+	void consume(const QImage& frame, MetricsClock::time_point timestamp) override;
+
+private:
+	struct PooledFrame
+	{
+		cv::Mat frame;
+		MetricsClock::time_point timestamp;
+	};
+
+	bool openWriter(const cv::Size& size);
+	bool writeFrame(const PooledFrame& pooledFrame);
+	void encodeLoop();
+
+private:
+	const std::string _filePath;
+	const double _fps;
+	const EncoderDropPolicy _dropPolicy;
+	const EncoderTiming _timing;
+	Metrics* const _metrics;
+
+	std::vector<PooledFrame> _pool;
+	std::vector<int> _freeFrames;
+	std::deque<int> _queuedFrames;
+
+	mutable std::mutex _mutex;
+	std::condition_variable _condition;
+	bool _stopRequested = false;
+	bool _failed = false;
+	std::function<void(bool)> _finished;
+	std::thread _encodeThread;
+
+	// Used by the encode thread only.
+	cv::VideoWriter _writer;
+	cv::Size _videoSize;
+	cv::Mat _scaledFrame;
+	cv::Mat _bgrFrame;
+	MetricsClock::time_point _firstTimestamp;
+	int64_t _writtenFrameCount = 0;
+};
+
+#endif
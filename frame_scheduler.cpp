@@ -0,0 +1,98 @@
+#include "frame_scheduler.h"
+
+#include <algorithm>
+
+// Larger lags than this are a pause or a seek, the playback restarts from the frame.
+static const auto playbackResyncThreshold = std::chrono::seconds(1);
+
+void FrameScheduler::reset(bool paceToTimestamps, MetricsClock::duration sourceInterval)
+{
+	_paceToTimestamps = paceToTimestamps;
+	_sourceInterval = sourceInterval;
+	_playbackStarted = false;
+	_lastPosition = MetricsClock::duration::zero();
+	_hasAcceptedFrame = false;
+	_behind = false;
+}
+
+void FrameScheduler::setTargetFps(double fps)
+{
+	if (fps > 0) {
+		_targetInterval = std::chrono::duration_cast<MetricsClock::duration>(
+			std::chrono::duration<double>(1.0 / fps)
+		);
+	}
+	else {
+		_targetInterval = MetricsClock::duration::zero();
+	}
+}
+
+void FrameScheduler::setBenchmarkMode(bool benchmarkMode)
+{
+	_benchmarkMode = benchmarkMode;
+}
+
+MetricsClock::duration FrameScheduler::frameBudget() const
+{
+	return std::max(_targetInterval, _sourceInterval);
+}
+
+FrameScheduler::Decision FrameScheduler::schedule(
+	MetricsClock::time_point readEndTime,
+	MetricsClock::duration readDuration,
+	MetricsClock::duration position,
+	MetricsClock::time_point& dueTime
+)
+{
+	if (_benchmarkMode) {
+		dueTime = readEndTime;
+		return Decision::process;
+	}
+
+	MetricsClock::time_point frameTime = readEndTime;
+	if (_paceToTimestamps) {
+		bool discontinuity = !_playbackStarted || (position < _lastPosition) ||
+			((readEndTime - (_playbackOrigin + position)) > playbackResyncThreshold);
+		if (discontinuity) {
+			_playbackOrigin = readEndTime - position;
+			_playbackStarted = true;
+		}
+		_lastPosition = position;
+		frameTime = _playbackOrigin + position;
+	}
+	else if (_hasAcceptedFrame) {
+		// A read that did not block returned a frame the device buffered while
+		// the previous one was processed, it is stale once the budget is exceeded.
+		auto readBeginTime = readEndTime - readDuration;
+		bool buffered = (readDuration < frameBudget() / 4);
+		if (!buffered) {
+			_behind = false;
+		}
+		else if ((readBeginTime - _lastAcceptTime) > frameBudget()) {
+			_behind = true;
+		}
+		if (_behind) {
+			return Decision::dropLate;
+		}
+	}
+
+	if (_paceToTimestamps && ((readEndTime - frameTime) > frameBudget())) {
+		return Decision::dropLate;
+	}
+
+	if (_targetInterval > MetricsClock::duration::zero()) {
+		// The slack keeps a source running at the cap from losing frames to jitter.
+		auto slack = _targetInterval / 4;
+		if (_hasAcceptedFrame && ((frameTime + slack) < _nextFrameTime)) {
+			return Decision::dropOverCap;
+		}
+		_nextFrameTime = _hasAcceptedFrame
+			? std::max(_nextFrameTime + _targetInterval, frameTime + _targetInterval - slack)
+			: frameTime + _targetInterval;
+	}
+
+	_hasAcceptedFrame = true;
+	_lastAcceptTime = readEndTime;
+	dueTime = frameTime;
+	return (frameTime > readEndTime) ? Decision::wait : Decision::process;
+}
@@ -0,0 +1,57 @@
+#ifndef FRAME_SCHEDULER_H
+#define FRAME_SCHEDULER_H
+
+#include "metrics.h"
+
+// Decides which of the frames read from the source are processed.
+// Files are paced to their timestamps, frames over the frame rate cap are
+// dropped, and so are the frames a device buffered while the previous frame
+// took longer than its deadline. Not thread safe, used by the pipeline loop.
+class FrameScheduler
+{
+public:
+	enum class Decision
+	{
+		process,
+		// Process at dueTime, the frame is early.
+		wait,
+		dropOverCap,
+		dropLate
+	};
+
+	// Called when the source is opened, sourceInterval is its nominal frame interval.
+	void reset(bool paceToTimestamps, MetricsClock::duration sourceInterval);
+	// Zero disables the cap.
+	void setTargetFps(double fps);
+	// Processes every frame as soon as it is read.
+	void setBenchmarkMode(bool benchmarkMode);
+
+	// readEndTime is when the read returned, readDuration how long it blocked,
+	// position the timestamp of the frame in the source.
+	Decision schedule(
+		MetricsClock::time_point readEndTime,
+		MetricsClock::duration readDuration,
+		MetricsClock::duration position,
+		MetricsClock::time_point& dueTime
+	);
+
+private:
+	MetricsClock::duration frameBudget() const;
+
+private:
+	bool _paceToTimestamps = false;
+	bool _benchmarkMode = false;
+	MetricsClock::duration _sourceInterval = MetricsClock::duration::zero();
+	MetricsClock::duration _targetInterval = MetricsClock::duration::zero();
+
+	bool _playbackStarted = false;
+	MetricsClock::time_point _playbackOrigin;
+	MetricsClock::duration _lastPosition = MetricsClock::duration::zero();
+
+	bool _hasAcceptedFrame = false;
+	MetricsClock::time_point _nextFrameTime;
+	MetricsClock::time_point _lastAcceptTime;
+	bool _behind = false;
+};
+
+#endif
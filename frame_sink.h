@@ -0,0 +1,21 @@
+#ifndef FRAME_SINK_H
+#define FRAME_SINK_H
+
+#include "metrics.h"
+
+#include <QImage>
+
+// Receives every processed frame at the full processing size, before it is
+// scaled for the view. Called on the pipeline thread, implementations must
+// not block for long.
+class FrameSink
+{
+public:
+	virtual ~FrameSink() = default;
+
+	// The frame is ARGB32 or RGB32, Grayscale8 for matte sinks, and is reused
+	// after the call returns.
+	virtual void consume(const QImage& frame, MetricsClock::time_point timestamp) = 0;
+};
+
+#endif
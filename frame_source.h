@@ -0,0 +1,25 @@
+#ifndef FRAME_SOURCE_H
+#define FRAME_SOURCE_H
+
+#include "metrics.h"
+
+#include <opencv2/opencv.hpp>
+
+// A file the pipeline reads instead of a camera.
+class FrameSource
+{
+public:
+	virtual ~FrameSource() = default;
+
+	virtual bool isValid() const = 0;
+	// Frame rate of the source, zero if unknown.
+	virtual double frameRate() const = 0;
+	// True once a read failed because the source has no more frames.
+	virtual bool atEnd() const { return false; }
+
+	// Returns the next frame with its position in the source, false on failure.
+	// The frame stays valid until the next call and must not be modified.
+	virtual bool read(cv::Mat& frame, MetricsClock::duration& position) = 0;
+};
+
+#endif
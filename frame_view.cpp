@@ -1,22 +1,222 @@
 #include "frame_view.h"
 
+#include "allocation_tracker.h"
+#include "image_pool.h"
+
+#include <opencv2/opencv.hpp>
+
+QImage scaleImageForDisplay(const QImage& frame, const QSize& size, ImagePool* pool)
+{
+	QImage source = frame;
+	if ((QImage::Format_RGB32 != source.format()) && (QImage::Format_ARGB32 != source.format())) {
+		source = source.convertToFormat(QImage::Format_ARGB32);
+	}
+	const bool opaque = (QImage::Format_RGB32 == source.format());
+	if (opaque && (size == source.size())) {
+		return source;
+	}
+
+	// Premultiplied ARGB is the format the raster paint engine blits directly.
+	const QImage::Format format = opaque ? QImage::Format_RGB32 : QImage::Format_ARGB32_Premultiplied;
+	QImage scaled = (nullptr != pool) ? pool->acquire(size, format) : QImage(size, format);
+	const cv::Mat sourceMat(
+		source.height(),
+		source.width(),
+		CV_8UC4,
+		const_cast<uchar*>(source.constBits()),
+		source.bytesPerLine()
+	);
+	cv::Mat scaledMat(
+		scaled.height(),
+		scaled.width(),
+		CV_8UC4,
+		ImagePool::pixels(scaled),
+		scaled.bytesPerLine()
+	);
+
+	ExternalAllocationScope externalAllocations;
+	if (size != source.size()) {
+		const cv::Mat* resizedMat = &sourceMat;
+		if (!opaque) {
+			// Resizing straight alpha would bleed the color of transparent
+			// pixels into the edges. Keeps its buffer while the size stays.
+			thread_local cv::Mat premultipliedMat;
+			cv::cvtColor(sourceMat, premultipliedMat, cv::COLOR_RGBA2mRGBA);
+			resizedMat = &premultipliedMat;
+		}
+		bool downscale = (size.width() < source.width());
+		cv::resize(
+			*resizedMat,
+			scaledMat,
+			scaledMat.size(),
+			0,
+			0,
+			downscale ? cv::INTER_AREA : cv::INTER_LINEAR
+		);
+	}
+	else {
+		cv::cvtColor(sourceMat, scaledMat, cv::COLOR_RGBA2mRGBA);
+	}
+	return scaled;
+}
+
 FrameView::FrameView(QWidget* parent)
 	: QWidget(parent)
 { }
 
 void FrameView::present(const QImage& image)
 {
-	_image = image;
+	if (_hasPendingImage && (nullptr != _metrics)) {
+		_metrics->onFrameSkipped();
+	}
+	_pendingImage = image;
+	_pendingImageTime = MetricsClock::now();
+	_hasPendingImage = true;
+	requestFrameUpdate();
+}
+
+QSize FrameView::displaySize() const
+{
+	return contentsRect().size() * devicePixelRatioF();
+}
+
+void FrameView::setMetrics(Metrics* metrics)
+{
+	_metrics = metrics;
+}
+
+void FrameView::attachWindow()
+{
+	QWindow* window = this->window()->windowHandle();
+	if (window == _window) {
+		return;
+	}
+
+	if (!_window.isNull()) {
+		_window->removeEventFilter(this);
+	}
+	_window = window;
+	if (!_window.isNull()) {
+		_window->installEventFilter(this);
+	}
+	_updateRequested = false;
+}
+
+void FrameView::setVisibleOnScreen(bool visible)
+{
+	if (visible == _visibleOnScreen) {
+		return;
+	}
+
+	_visibleOnScreen = visible;
+	emit visibilityChanged(visible);
+}
+
+void FrameView::requestFrameUpdate()
+{
+	attachWindow();
+	if (_window.isNull()) {
+		onFrameUpdate();
+		return;
+	}
+
+	if (!_updateRequested) {
+		// The platform delivers the update request with the next frame callback.
+		_window->requestUpdate();
+		_updateRequested = true;
+	}
+}
+
+void FrameView::onFrameUpdate()
+{
+	if (!_hasPendingImage) {
+		return;
+	}
+
+	_image = std::move(_pendingImage);
+	_image.setDevicePixelRatio(devicePixelRatioF());
+	_imageTime = _pendingImageTime;
+	_imagePresented = false;
+	_hasPendingImage = false;
 	update();
 }
 
+bool FrameView::eventFilter(QObject* watched, QEvent* event)
+{
+	if ((watched == _window.data()) && (QEvent::UpdateRequest == event->type())) {
+		// Marks the view dirty before the window repaints for this update request.
+		_updateRequested = false;
+		onFrameUpdate();
+	}
+	else if ((watched == _window.data()) && (QEvent::Expose == event->type())) {
+		setVisibleOnScreen(isVisible() && _window->isExposed());
+	}
+	return QWidget::eventFilter(watched, event);
+}
+
 void FrameView::paintEvent(QPaintEvent* event)
 {
-	QSize dstSize = _image.size().scaled(contentsRect().size(), Qt::KeepAspectRatio);
+	auto paintBeginTime = MetricsClock::now();
+	if (!_imagePresented && (nullptr != _metrics)) {
+		MetricsClock::duration refreshPeriod = MetricsClock::duration::zero();
+		QScreen* screen = !_window.isNull() ? _window->screen() : nullptr;
+		if ((nullptr != screen) && (screen->refreshRate() > 0)) {
+			refreshPeriod = std::chrono::duration_cast<MetricsClock::duration>(
+				std::chrono::duration<double>(1.0 / screen->refreshRate())
+			);
+		}
+
+		FrameTimeInfo presentTimeInfo;
+		presentTimeInfo.duration = (paintBeginTime - _imageTime);
+		presentTimeInfo.timestamp = paintBeginTime;
+		presentTimeInfo.size = _image.size();
+		_metrics->onFramePresented(presentTimeInfo, refreshPeriod);
+	}
+	_imagePresented = true;
+
+	QSize dstSize = _image.size().scaled(displaySize(), Qt::KeepAspectRatio);
+	bool prescaled = (dstSize == _image.size());
+	dstSize /= devicePixelRatioF();
 	QRect dstRect(QPoint(0, 0), dstSize);
 	dstRect.moveCenter(contentsRect().center());
 
 	QPainter painter(this);
-	painter.setRenderHint(QPainter::SmoothPixmapTransform);
-	painter.drawImage(dstRect, _image);
-}
\ No newline at end of file
+	if (prescaled) {
+		painter.drawImage(dstRect.topLeft(), _image);
+	}
+	else {
+		// Until a frame of the new size arrives after a resize.
+		painter.setRenderHint(QPainter::SmoothPixmapTransform);
+		painter.drawImage(dstRect, _image);
+	}
+	painter.end();
+
+	if (nullptr != _metrics) {
+		auto paintEndTime = MetricsClock::now();
+		FrameTimeInfo paintTimeInfo;
+		paintTimeInfo.duration = (paintEndTime - paintBeginTime);
+		paintTimeInfo.timestamp = paintEndTime;
+		paintTimeInfo.size = _image.size();
+		_metrics->onFramePainted(paintTimeInfo);
+	}
+}
+
+void FrameView::resizeEvent(QResizeEvent* event)
+{
+	QWidget::resizeEvent(event);
+	emit displaySizeChanged(displaySize());
+}
+
+void FrameView::showEvent(QShowEvent* event)
+{
+	QWidget::showEvent(event);
+	attachWindow();
+	// Expose events of the window correct it once it is on the screen.
+	setVisibleOnScreen(true);
+}
+
+void FrameView::hideEvent(QHideEvent* event)
+{
+	QWidget::hideEvent(event);
+	setVisibleOnScreen(false);
+}
@@ -1,21 +1,60 @@
 #ifndef FRAME_VIEW_H
 #define FRAME_VIEW_H
 
+#include "metrics.h"
+
 #include <QtWidgets>
 
+class ImagePool;
+
+// Scales the frame to the size for present(), in the format the raster paint
+// engine blits without conversions: RGB32 or ARGB32_Premultiplied. With a
+// pool the result is one of its images.
+QImage scaleImageForDisplay(const QImage& frame, const QSize& size, ImagePool* pool = nullptr);
+
 class FrameView : public QWidget 
 {
 	Q_OBJECT
 public:
 	explicit FrameView(QWidget* parent = nullptr);
 
+	// Frames are expected prescaled to displaySize(), others are scaled while painting.
+	// The frame is shown at the next screen refresh, a newer frame replaces it until then.
 	void present(const QImage& image);
+	// Size of the frame area in device pixels.
+	QSize displaySize() const;
+
+	void setMetrics(Metrics* metrics);
+
+signals:
+	void displaySizeChanged(const QSize& size);
+	// False while the window is minimized, hidden or reported fully covered.
+	void visibilityChanged(bool visible);
 
 protected:
+	bool eventFilter(QObject* watched, QEvent* event) override;
 	void paintEvent(QPaintEvent* event) override;
+	void resizeEvent(QResizeEvent* event) override;
+	void showEvent(QShowEvent* event) override;
+	void hideEvent(QHideEvent* event) override;
+
+private:
+	void attachWindow();
+	void setVisibleOnScreen(bool visible);
+	void requestFrameUpdate();
+	void onFrameUpdate();
 
 private:
 	QImage _image;
+	QImage _pendingImage;
+	MetricsClock::time_point _pendingImageTime;
+	MetricsClock::time_point _imageTime;
+	bool _hasPendingImage = false;
+	bool _imagePresented = true;
+	QPointer<QWindow> _window;
+	bool _updateRequested = false;
+	bool _visibleOnScreen = false;
+	Metrics* _metrics = nullptr;
 };
 
 #endif 
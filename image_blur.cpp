@@ -0,0 +1,254 @@
+#include "image_blur.h"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#include <emmintrin.h>
+#define IMAGE_BLUR_SSE2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define IMAGE_BLUR_NEON
+#endif
+
+namespace {
+
+// The sums of the four channels of a pixel are kept in one vector register.
+#if defined(IMAGE_BLUR_SSE2)
+
+using PixelSum = __m128i;
+
+inline PixelSum zeroSum()
+{
+	return _mm_setzero_si128();
+}
+
+inline PixelSum loadPixel(const uint8_t* pixel)
+{
+	uint32_t value;
+	std::memcpy(&value, pixel, sizeof(value));
+	__m128i zero = _mm_setzero_si128();
+	__m128i bytes = _mm_cvtsi32_si128(static_cast<int>(value));
+	return _mm_unpacklo_epi16(_mm_unpacklo_epi8(bytes, zero), zero);
+}
+
+inline PixelSum add(PixelSum a, PixelSum b)
+{
+	return _mm_add_epi32(a, b);
+}
+
+inline PixelSum sub(PixelSum a, PixelSum b)
+{
+	return _mm_sub_epi32(a, b);
+}
+
+inline PixelSum loadSum(const int32_t* sum)
+{
+	return _mm_loadu_si128(reinterpret_cast<const __m128i*>(sum));
+}
+
+inline void storeSum(int32_t* sum, PixelSum value)
+{
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(sum), value);
+}
+
+inline void storeAverage(uint8_t* pixel, PixelSum sum, float scale)
+{
+	__m128 average = _mm_mul_ps(_mm_cvtepi32_ps(sum), _mm_set1_ps(scale));
+	__m128i words = _mm_packs_epi32(_mm_cvtps_epi32(average), _mm_setzero_si128());
+	uint32_t value = static_cast<uint32_t>(
+		_mm_cvtsi128_si32(_mm_packus_epi16(words, words))
+	);
+	std::memcpy(pixel, &value, sizeof(value));
+}
+
+#elif defined(IMAGE_BLUR_NEON)
+
+using PixelSum = int32x4_t;
+
+inline PixelSum zeroSum()
+{
+	return vdupq_n_s32(0);
+}
+
+inline PixelSum loadPixel(const uint8_t* pixel)
+{
+	uint32_t value;
+	std::memcpy(&value, pixel, sizeof(value));
+	uint8x8_t bytes = vreinterpret_u8_u32(vdup_n_u32(value));
+	uint16x4_t words = vget_low_u16(vmovl_u8(bytes));
+	return vreinterpretq_s32_u32(vmovl_u16(words));
+}
+
+inline PixelSum add(PixelSum a, PixelSum b)
+{
+	return vaddq_s32(a, b);
+}
+
+inline PixelSum sub(PixelSum a, PixelSum b)
+{
+	return vsubq_s32(a, b);
+}
+
+inline PixelSum loadSum(const int32_t* sum)
+{
+	return vld1q_s32(sum);
+}
+
+inline void storeSum(int32_t* sum, PixelSum value)
+{
+	vst1q_s32(sum, value);
+}
+
+inline void storeAverage(uint8_t* pixel, PixelSum sum, float scale)
+{
+	float32x4_t average = vmlaq_n_f32(vdupq_n_f32(0.5f), vcvtq_f32_s32(sum), scale);
+	uint16x4_t words = vqmovun_s32(vcvtq_s32_f32(average));
+	uint8x8_t bytes = vqmovn_u16(vcombine_u16(words, words));
+	uint32_t value = vget_lane_u32(vreinterpret_u32_u8(bytes), 0);
+	std::memcpy(pixel, &value, sizeof(value));
+}
+
+#else
+
+struct PixelSum
+{
+	int32_t channels[4];
+};
+
+inline PixelSum zeroSum()
+{
+	return { { 0, 0, 0, 0 } };
+}
+
+inline PixelSum loadPixel(const uint8_t* pixel)
+{
+	return { { pixel[0], pixel[1], pixel[2], pixel[3] } };
+}
+
+inline PixelSum add(PixelSum a, PixelSum b)
+{
+	for (int i = 0; i < 4; ++i) {
+		a.channels[i] += b.channels[i];
+	}
+	return a;
+}
+
+inline PixelSum sub(PixelSum a, PixelSum b)
+{
+	for (int i = 0; i < 4; ++i) {
+		a.channels[i] -= b.channels[i];
+	}
+	return a;
+}
+
+inline PixelSum loadSum(const int32_t* sum)
+{
+	return { { sum[0], sum[1], sum[2], sum[3] } };
+}
+
+inline void storeSum(int32_t* sum, PixelSum value)
+{
+	std::memcpy(sum, value.channels, sizeof(value.channels));
+}
+
+inline void storeAverage(uint8_t* pixel, PixelSum sum, float scale)
+{
+	for (int i = 0; i < 4; ++i) {
+		float average = float(sum.channels[i]) * scale + 0.5f;
+		pixel[i] = static_cast<uint8_t>(std::min(std::max(average, 0.0f), 255.0f));
+	}
+}
+
+#endif
+
+inline int clampIndex(int index, int size)
+{
+	return std::min(std::max(index, 0), size - 1);
+}
+
+void boxBlurRow(const uint8_t* src, uint8_t* dst, int width, int radius, float scale)
+{
+	PixelSum sum = zeroSum();
+	for (int i = -radius; i <= radius; ++i) {
+		sum = add(sum, loadPixel(src + clampIndex(i, width) * 4));
+	}
+
+	for (int x = 0; x < width; ++x) {
+		storeAverage(dst + x * 4, sum, scale);
+		const uint8_t* incoming = src + clampIndex(x + radius + 1, width) * 4;
+		const uint8_t* outgoing = src + clampIndex(x - radius, width) * 4;
+		sum = sub(add(sum, loadPixel(incoming)), loadPixel(outgoing));
+	}
+}
+
+// Runs down the columns keeping a sum per column, so rows are accessed
+// sequentially and the work for neighbor pixels is independent.
+void boxBlurColumns(
+	const uint8_t* src,
+	int srcBytesPerLine,
+	uint8_t* dst,
+	int dstBytesPerLine,
+	int width,
+	int height,
+	int radius,
+	float scale,
+	std::vector<int32_t>& sums)
+{
+	sums.assign(size_t(width) * 4, 0);
+	for (int i = -radius; i <= radius; ++i) {
+		const uint8_t* row = src + clampIndex(i, height) * srcBytesPerLine;
+		for (int x = 0; x < width; ++x) {
+			int32_t* sum = sums.data() + x * 4;
+			storeSum(sum, add(loadSum(sum), loadPixel(row + x * 4)));
+		}
+	}
+
+	for (int y = 0; y < height; ++y) {
+		uint8_t* dstRow = dst + y * dstBytesPerLine;
+		const uint8_t* incoming = src + clampIndex(y + radius + 1, height) * srcBytesPerLine;
+		const uint8_t* outgoing = src + clampIndex(y - radius, height) * srcBytesPerLine;
+		for (int x = 0; x < width; ++x) {
+			int32_t* sum = sums.data() + x * 4;
+			PixelSum value = loadSum(sum);
+			storeAverage(dstRow + x * 4, value, scale);
+			value = sub(add(value, loadPixel(incoming + x * 4)), loadPixel(outgoing + x * 4));
+			storeSum(sum, value);
+		}
+	}
+}
+
+}
+
+void blurBGRA(uint8_t* data, int width, int height, int bytesPerLine, int radius)
+{
+	if ((nullptr == data) || (width <= 0) || (height <= 0) || (radius <= 0)) {
+		return;
+	}
+
+	const int passes = 3;
+	const float scale = 1.0f / float(2 * radius + 1);
+	const int tmpBytesPerLine = width * 4;
+	std::vector<uint8_t> tmp(size_t(tmpBytesPerLine) * size_t(height));
+	std::vector<int32_t> sums;
+
+	for (int pass = 0; pass < passes; ++pass) {
+		for (int y = 0; y < height; ++y) {
+			boxBlurRow(
+				data + y * bytesPerLine,
+				tmp.data() + y * tmpBytesPerLine,
+				width,
+				radius,
+				scale
+			);
+		}
+		boxBlurColumns(
+			tmp.data(), tmpBytesPerLine,
+			data, bytesPerLine,
+			width, height,
+			radius, scale,
+			sums
+		);
+	}
+}
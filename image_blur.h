@@ -0,0 +1,10 @@
+#ifndef IMAGE_BLUR_H
+#define IMAGE_BLUR_H
+
+#include <cstdint>
+
+// Blurs BGRA pixels in place. Three separable box passes of the radius give a
+// close approximation of a gaussian blur with sigma equal to the radius.
+void blurBGRA(uint8_t* data, int width, int height, int bytesPerLine, int radius);
+
+#endif
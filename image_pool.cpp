@@ -0,0 +1,41 @@
+#include "image_pool.h"
+
+ImagePool::ImagePool(size_t capacity)
+	: _capacity(capacity)
+{
+	_images.reserve(capacity);
+}
+
+QImage ImagePool::acquire(const QSize& size, QImage::Format format)
+{
+	QImage* replaced = nullptr;
+	for (auto& image : _images) {
+		if (!image.isDetached()) {
+			continue;
+		}
+		if ((image.size() == size) && (image.format() == format)) {
+			return image;
+		}
+		replaced = &image;
+	}
+
+	QImage image(size, format);
+	if (_images.size() < _capacity) {
+		_images.push_back(image);
+	}
+	else if (nullptr != replaced) {
+		// A size or format change, the old buffers are not needed any more.
+		*replaced = image;
+	}
+	return image;
+}
+
+void ImagePool::clear()
+{
+	_images.clear();
+}
+
+uchar* ImagePool::pixels(const QImage& image)
+{
+	return const_cast<uchar*>(image.constBits());
+}
@@ -0,0 +1,29 @@
+#ifndef IMAGE_POOL_H
+#define IMAGE_POOL_H
+
+#include <QImage>
+
+#include <vector>
+
+// Reuses the buffers of images handed to consumers every frame. An image
+// comes back into use once every consumer has dropped it, one still held,
+// e.g. by the view, is never overwritten. Not thread safe, used by the
+// thread which produces the images.
+class ImagePool
+{
+public:
+	explicit ImagePool(size_t capacity = 4);
+
+	// An image only the pool and the caller reference. It has to be written
+	// through pixels(), bits() would detach it from the pool.
+	QImage acquire(const QSize& size, QImage::Format format);
+	void clear();
+
+	static uchar* pixels(const QImage& image);
+
+private:
+	size_t _capacity;
+	std::vector<QImage> _images;
+};
+
+#endif
@@ -1,9 +1,18 @@
+#include "batch_mode.h"
 #include "sample.h"
+#include "stream_mode.h"
 
 #include <QtWidgets>
 
 int main(int argc, char *argv[])
 {
+    if (isStreamModeRequested(argc, argv)) {
+        return runStreamMode(argc, argv);
+    }
+    if (isBatchModeRequested(argc, argv)) {
+        return runBatchMode(argc, argv);
+    }
+
     QApplication app(argc, argv);
     app.setOrganizationName(TSVB_COMPANY);
     app.setApplicationName(TSVB_APP_BIN_NAME);
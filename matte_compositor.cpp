@@ -0,0 +1,182 @@
+#include "matte_compositor.h"
+
+#include "allocation_tracker.h"
+#include "image_blur.h"
+#include "pixel_convert.h"
+
+#include <opencv2/opencv.hpp>
+
+#include <algorithm>
+#include <iterator>
+
+// Stripes per thread, smaller stripes balance the threads better.
+static const int stripesPerThread = 4;
+
+static QImage coverImage(const QImage& image, const QSize& size)
+{
+	QImage scaled = image.scaled(size, Qt::KeepAspectRatioByExpanding, Qt::SmoothTransformation);
+	QRect rect(
+		(scaled.width() - size.width()) / 2,
+		(scaled.height() - size.height()) / 2,
+		size.width(),
+		size.height()
+	);
+	return scaled.copy(rect).convertToFormat(QImage::Format_RGB32);
+}
+
+class CompositeStripes : public cv::ParallelLoopBody
+{
+public:
+	CompositeStripes(MatteCompositor* compositor, int height, int stripeCount, size_t rowWords, uint16_t* rows)
+		: _compositor(compositor)
+		, _height(height)
+		, _stripeCount(stripeCount)
+		, _rowWords(rowWords)
+		, _rows(rows)
+	{ }
+
+	void operator()(const cv::Range& range) const override
+	{
+		for (int i = range.start; i < range.end; ++i) {
+			_compositor->compositeRows(
+				_height * i / _stripeCount,
+				_height * (i + 1) / _stripeCount,
+				_rows + _rowWords * i
+			);
+		}
+	}
+
+private:
+	MatteCompositor* const _compositor;
+	const int _height;
+	const int _stripeCount;
+	const size_t _rowWords;
+	uint16_t* const _rows;
+};
+
+MatteCompositor::MatteCompositor(std::vector<CompositeOutput> outputs)
+	: _outputs(std::move(outputs))
+{
+}
+
+void MatteCompositor::prepareBackgrounds(const QSize& size)
+{
+	_size = size;
+	_backgrounds.clear();
+	_composites.clear();
+	_blurredFrames.clear();
+	_blurredFrameIndices.clear();
+	for (const auto& output : _outputs) {
+		QImage background;
+		int blurredFrameIndex = -1;
+		if (!output.background.isNull()) {
+			background = coverImage(output.background, size);
+			if (output.blurRadius > 0) {
+				blurBGRA(
+					background.bits(),
+					background.width(),
+					background.height(),
+					background.bytesPerLine(),
+					output.blurRadius
+				);
+			}
+		}
+		else if (output.blurRadius > 0) {
+			auto sameRadius = std::find_if(
+				_blurredFrames.begin(),
+				_blurredFrames.end(),
+				[&output](const BlurredFrame& blurred) { return blurred.radius == output.blurRadius; }
+			);
+			if (_blurredFrames.end() == sameRadius) {
+				_blurredFrames.push_back({ output.blurRadius, QImage(size, QImage::Format_RGB32) });
+				sameRadius = std::prev(_blurredFrames.end());
+			}
+			blurredFrameIndex = int(sameRadius - _blurredFrames.begin());
+		}
+		_backgrounds.push_back(background);
+		_blurredFrameIndices.push_back(blurredFrameIndex);
+		_composites.push_back(QImage(size, QImage::Format_RGB32));
+	}
+}
+
+void MatteCompositor::composite(const QImage& frame, const QImage& matte, MetricsClock::time_point timestamp)
+{
+	if (_outputs.empty() ||
+		(32 != frame.depth()) ||
+		(QImage::Format_Grayscale8 != matte.format()) ||
+		(matte.size() != frame.size())) {
+		return;
+	}
+	if (frame.size() != _size) {
+		prepareBackgrounds(frame.size());
+	}
+
+	for (auto& blurred : _blurredFrames) {
+		QImage& image = blurred.image;
+		convertBGRXToBGRA(
+			frame.constBits(),
+			frame.bytesPerLine(),
+			image.bits(),
+			image.bytesPerLine(),
+			_size.width(),
+			_size.height()
+		);
+		blurBGRA(image.bits(), _size.width(), _size.height(), image.bytesPerLine(), blurred.radius);
+	}
+
+	_frame = { frame.constBits(), frame.bytesPerLine() };
+	_matte = { matte.constBits(), matte.bytesPerLine() };
+	_backgroundPlanes.clear();
+	_compositeData.clear();
+	for (size_t i = 0; i < _outputs.size(); ++i) {
+		const int blurredFrameIndex = _blurredFrameIndices[i];
+		const QImage& background = !_backgrounds[i].isNull()
+			? _backgrounds[i]
+			: ((blurredFrameIndex >= 0) ? _blurredFrames[blurredFrameIndex].image : frame);
+		_backgroundPlanes.push_back({ background.constBits(), background.bytesPerLine() });
+		// A composite still held by a sink is detached rather than overwritten.
+		_compositeData.push_back(_composites[i].bits());
+	}
+
+	const int height = _size.height();
+	const int stripeCount = std::min(height, stripesPerThread * std::max(1, cv::getNumThreads()));
+	const size_t rowWords = size_t(_size.width()) * 4;
+	_premultipliedRows.resize(rowWords * stripeCount);
+	{
+		// The OpenCV thread pool allocates its jobs.
+		ExternalAllocationScope externalAllocations;
+		cv::parallel_for_(
+			cv::Range(0, stripeCount),
+			CompositeStripes(this, height, stripeCount, rowWords, _premultipliedRows.data())
+		);
+	}
+
+	for (size_t i = 0; i < _outputs.size(); ++i) {
+		if (nullptr != _outputs[i].sink) {
+			_outputs[i].sink->consume(_composites[i], timestamp);
+		}
+	}
+}
+
+void MatteCompositor::compositeRows(int beginRow, int endRow, uint16_t* premultipliedRow)
+{
+	const int width = _size.width();
+	const int compositeBytesPerLine = _composites.front().bytesPerLine();
+	for (int y = beginRow; y < endRow; ++y) {
+		premultiplyBGRA(
+			_frame.data + y * _frame.bytesPerLine, 0,
+			_matte.data + y * _matte.bytesPerLine, 0,
+			premultipliedRow, 0,
+			width, 1
+		);
+		for (size_t i = 0; i < _outputs.size(); ++i) {
+			const Plane& background = _backgroundPlanes[i];
+			blendPremultipliedBGRA(
+				premultipliedRow, 0,
+				background.data + y * background.bytesPerLine, 0,
+				_compositeData[i] + y * compositeBytesPerLine, 0,
+				width, 1
+			);
+		}
+	}
+}
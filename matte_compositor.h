@@ -0,0 +1,70 @@
+#ifndef MATTE_COMPOSITOR_H
+#define MATTE_COMPOSITOR_H
+
+#include "frame_sink.h"
+
+#include <memory>
+#include <vector>
+
+struct CompositeOutput
+{
+	// Scaled to cover the frame and cropped to it. A null image uses the
+	// camera frame itself, e.g. blurred for a preview.
+	QImage background;
+	// Blurs an image once, the camera frame on every frame.
+	int blurRadius = 0;
+	// Gets the composite as RGB32.
+	std::shared_ptr<FrameSink> sink;
+};
+
+// Composites the person over several backgrounds with one segmentation: the
+// camera frame is premultiplied with the matte of the video filter a row at
+// a time and the row is blended over every background while it is in the
+// cache. Stripes of rows run on the OpenCV threads.
+class MatteCompositor
+{
+public:
+	explicit MatteCompositor(std::vector<CompositeOutput> outputs);
+
+	// Takes the ARGB32 or RGB32 frame given to the video filter and the
+	// Grayscale8 matte of its output. Called on the pipeline thread.
+	void composite(const QImage& frame, const QImage& matte, MetricsClock::time_point timestamp);
+
+private:
+	friend class CompositeStripes;
+
+	// Prepares the image backgrounds at the frame size.
+	void prepareBackgrounds(const QSize& size);
+	void compositeRows(int beginRow, int endRow, uint16_t* premultipliedRow);
+
+private:
+	const std::vector<CompositeOutput> _outputs;
+	QSize _size;
+	std::vector<QImage> _backgrounds;
+	std::vector<QImage> _composites;
+	// The camera frame blurred once for each radius of the outputs without
+	// an image, outputs with the same radius share it.
+	struct BlurredFrame
+	{
+		int radius;
+		QImage image;
+	};
+	std::vector<BlurredFrame> _blurredFrames;
+	// Index into _blurredFrames for every output, -1 when it is not blurred.
+	std::vector<int> _blurredFrameIndices;
+	// One premultiplied row per stripe of rows.
+	std::vector<uint16_t> _premultipliedRows;
+
+	// Rows of the current frame, valid during composite().
+	struct Plane
+	{
+		const uint8_t* data;
+		int bytesPerLine;
+	};
+	Plane _frame;
+	Plane _matte;
+	std::vector<Plane> _backgroundPlanes;
+	std::vector<uint8_t*> _compositeData;
+};
+
+#endif
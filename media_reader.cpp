@@ -0,0 +1,154 @@
+#include "media_reader.h"
+
+static const size_t ringSize = 4;
+static const auto pollInterval = std::chrono::milliseconds(10);
+
+MediaReader::MediaReader(const std::string& filePath, Metrics* metrics)
+	: _filePath(filePath)
+	, _metrics(metrics)
+	, _writeCount(0)
+	, _readCount(0)
+	, _decodeFailed(false)
+	, _stopRequested(false)
+	, _frameDuration(std::chrono::milliseconds(33))
+	, _loopOffset(MetricsClock::duration::zero())
+	, _lastPosition(MetricsClock::duration::zero())
+{
+	if (!_videoCapture.open(_filePath)) {
+		return;
+	}
+
+	_frameRate = _videoCapture.get(cv::CAP_PROP_FPS);
+	if (_frameRate > 0) {
+		_frameDuration = std::chrono::duration_cast<MetricsClock::duration>(
+			std::chrono::duration<double>(1.0 / _frameRate)
+		);
+	}
+	else {
+		_frameRate = 0;
+	}
+
+	_slots.resize(ringSize);
+	_valid = true;
+	_decodeThread = std::thread([this] { decodeLoop(); });
+}
+
+MediaReader::~MediaReader()
+{
+	_stopRequested = true;
+	_condition.notify_all();
+	if (_decodeThread.joinable()) {
+		_decodeThread.join();
+	}
+}
+
+bool MediaReader::isValid() const
+{
+	return _valid;
+}
+
+double MediaReader::frameRate() const
+{
+	return _frameRate;
+}
+
+bool MediaReader::read(cv::Mat& frame, MetricsClock::duration& position)
+{
+	if (!_valid) {
+		return false;
+	}
+
+	uint64_t readCount = _readCount.load(std::memory_order_relaxed);
+	if (_holdsFrame) {
+		// The previous frame goes back to the decoder.
+		_holdsFrame = false;
+		++readCount;
+		_readCount.store(readCount, std::memory_order_release);
+		_condition.notify_all();
+	}
+
+	if (_writeCount.load(std::memory_order_acquire) <= readCount) {
+		std::unique_lock<std::mutex> lock(_mutex);
+		while ((_writeCount.load(std::memory_order_acquire) <= readCount) && !_decodeFailed) {
+			_condition.wait_for(lock, pollInterval);
+		}
+		if (_writeCount.load(std::memory_order_acquire) <= readCount) {
+			return false;
+		}
+
+		if (nullptr != _metrics) {
+			_metrics->onMediaReadStalled();
+		}
+	}
+
+	const Slot& slot = _slots[readCount % _slots.size()];
+	frame = slot.frame;
+	position = slot.position;
+	_holdsFrame = true;
+	return true;
+}
+
+bool MediaReader::decodeNext(Slot& slot)
+{
+	if (!_videoCapture.read(slot.frame)) {
+		// Loop the file, reopen it if the backend can not seek.
+		_loopOffset += _lastPosition + _frameDuration;
+		_videoCapture.set(cv::CAP_PROP_POS_FRAMES, 0);
+		if (!_videoCapture.read(slot.frame)) {
+			_videoCapture.release();
+			if (!_videoCapture.open(_filePath) || !_videoCapture.read(slot.frame)) {
+				return false;
+			}
+		}
+		_hasPosition = false;
+	}
+
+	auto position = std::chrono::duration_cast<MetricsClock::duration>(
+		std::chrono::duration<double, std::milli>(_videoCapture.get(cv::CAP_PROP_POS_MSEC))
+	);
+	if (_hasPosition && (position <= _lastPosition)) {
+		// Backends without timestamps.
+		position = _lastPosition + _frameDuration;
+	}
+	_lastPosition = position;
+	_hasPosition = true;
+	slot.position = _loopOffset + position;
+	return true;
+}
+
+void MediaReader::decodeLoop()
+{
+	// One slot is kept for the frame the pipeline processes.
+	const uint64_t capacity = _slots.size() - 1;
+	while (!_stopRequested) {
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+			_condition.wait_for(lock, pollInterval, [this, capacity] {
+				return _stopRequested || (_writeCount - _readCount < capacity);
+			});
+		}
+		uint64_t writeCount = _writeCount.load(std::memory_order_relaxed);
+		if (_stopRequested || (writeCount - _readCount.load(std::memory_order_acquire) >= capacity)) {
+			continue;
+		}
+
+		Slot& slot = _slots[writeCount % _slots.size()];
+		auto decodeBeginTime = MetricsClock::now();
+		if (!decodeNext(slot)) {
+			_decodeFailed = true;
+			_condition.notify_all();
+			return;
+		}
+		auto decodeEndTime = MetricsClock::now();
+
+		if (nullptr != _metrics) {
+			FrameTimeInfo frameTimeInfo;
+			frameTimeInfo.duration = decodeEndTime - decodeBeginTime;
+			frameTimeInfo.timestamp = decodeEndTime;
+			frameTimeInfo.size = QSize(slot.frame.cols, slot.frame.rows);
+			_metrics->onMediaFrameDecoded(frameTimeInfo);
+		}
+		_writeCount.store(writeCount + 1, std::memory_order_release);
+		_condition.notify_all();
+	}
+}
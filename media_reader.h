@@ -0,0 +1,64 @@
+#ifndef MEDIA_READER_H
+#define MEDIA_READER_H
+
+#include "frame_source.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Decodes a media file ahead on its own thread into a small ring of reused
+// frames, so the pipeline waits for decoding only when the decoder falls
+// behind. The file loops, positions keep growing across the loops.
+class MediaReader : public FrameSource
+{
+public:
+	MediaReader(const std::string& filePath, Metrics* metrics);
+	~MediaReader() override;
+
+	bool isValid() const override;
+	double frameRate() const override;
+
+	// Blocks until the next frame is decoded.
+	bool read(cv::Mat& frame, MetricsClock::duration& position) override;
+
+private:
+	struct Slot
+	{
+		cv::Mat frame;
+		MetricsClock::duration position;
+	};
+
+	bool decodeNext(Slot& slot);
+	void decodeLoop();
+
+private:
+	const std::string _filePath;
+	Metrics* const _metrics;
+	bool _valid = false;
+	double _frameRate = 0;
+
+	std::vector<Slot> _slots;
+	std::atomic<uint64_t> _writeCount;
+	std::atomic<uint64_t> _readCount;
+	bool _holdsFrame = false;
+
+	std::mutex _mutex;
+	std::condition_variable _condition;
+	std::atomic<bool> _decodeFailed;
+	std::atomic<bool> _stopRequested;
+	std::thread _decodeThread;
+
+	// Used by the decode thread only.
+	cv::VideoCapture _videoCapture;
+	MetricsClock::duration _frameDuration;
+	MetricsClock::duration _loopOffset;
+	MetricsClock::duration _lastPosition;
+	bool _hasPosition = false;
+};
+
+#endif
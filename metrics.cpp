@@ -1,6 +1,9 @@
 #include "metrics.h"
 
+#include "system_usage.h"
+
 #include <algorithm>
+#include <iterator>
 
 static const auto infoExpirationTime = std::chrono::seconds(1);
 
@@ -9,25 +12,181 @@ FrameTimeInfo::FrameTimeInfo()
 	, timestamp(MetricsClock::duration::zero())
 {}
 
+void FrameTimeHistory::append(const FrameTimeInfo& info, MetricsClock::duration maxAge)
+{
+	// Infos come in time order, the expired ones are at the front.
+	while ((_size > 0) && ((info.timestamp - front().timestamp) > maxAge)) {
+		_first = (_first + 1) % _items.size();
+		--_size;
+	}
+
+	if (_size == _items.size()) {
+		// Doubles, so a steady frame rate stops growing it quickly.
+		std::vector<FrameTimeInfo> items(std::max<size_t>(16, _items.size() * 2));
+		std::copy(begin(), end(), items.begin());
+		_items.swap(items);
+		_first = 0;
+	}
+	_items[(_first + _size) % _items.size()] = info;
+	++_size;
+}
+
+void FrameTimeHistory::clear()
+{
+	_first = 0;
+	_size = 0;
+}
+
+static MetricsClock::duration totalDuration(const FrameTimeHistory& infoList)
+{
+	auto sum = MetricsClock::duration::zero();
+	for (auto& info : infoList) {
+		sum += info.duration;
+	}
+	return sum;
+}
+
 Metrics::Metrics()
+	: m_cpuSampleTime(MetricsClock::now())
+	, m_cpuSampleCpuTime(processCpuTime())
+	, m_cpuUsage{0, 0}
 {
 	_cameraError = false;
 	_cameraSwitch = false;
+	_bypassActive = false;
+	_bypassedFrameCount = 0;
+	_staticFrameCount = 0;
+	_missedRefreshCount = 0;
+	_skippedFrameCount = 0;
+	_lowPowerMode = false;
+	_mediaReadStallCount = 0;
+	_sharedFramePublishedCount = 0;
+	_sharedFrameConsumedCount = 0;
+	_encoderDroppedFrameCount = 0;
+	_encoderQueueDepth = 0;
+	_encoderQueueCapacity = 0;
+	_rawRecordingDroppedFrameCount = 0;
+	_frameRateCap = 0;
+	_overCapFrameCount = 0;
+	_lateFrameCount = 0;
 }
 
 void Metrics::onFrameProcessed(const FrameTimeInfo& info)
 {
+	_bypassActive = false;
 	std::lock_guard<std::mutex> locker(m_mutex);
-	auto removedBeginIter = std::remove_if(
-		m_frameTimeInfoList.begin(), 
-		m_frameTimeInfoList.end(),
-		[&info](const FrameTimeInfo& oldInfo) { 
-			return ((info.timestamp - oldInfo.timestamp) > infoExpirationTime); 
-		}
-	);
-	m_frameTimeInfoList.erase(removedBeginIter, m_frameTimeInfoList.end());
+	m_frameTimeInfoList.append(info, infoExpirationTime);
+}
+
+void Metrics::onFrameBypassed(const FrameTimeInfo& info)
+{
+	_bypassActive = true;
+	++_bypassedFrameCount;
+	std::lock_guard<std::mutex> locker(m_mutex);
+	m_bypassInfoList.append(info, infoExpirationTime);
+}
+
+void Metrics::onFrameStatic(const FrameTimeInfo& info)
+{
+	_bypassActive = false;
+	++_staticFrameCount;
+	std::lock_guard<std::mutex> locker(m_mutex);
+	m_staticInfoList.append(info, infoExpirationTime);
+}
+
+void Metrics::onMediaFrameDecoded(const FrameTimeInfo& info)
+{
+	std::lock_guard<std::mutex> locker(m_mutex);
+	m_mediaDecodeInfoList.append(info, infoExpirationTime);
+}
+
+void Metrics::onMediaReadStalled()
+{
+	++_mediaReadStallCount;
+}
+
+void Metrics::onSharedFramePublished(uint64_t publishedCount, uint64_t consumedCount)
+{
+	_sharedFramePublishedCount = publishedCount;
+	_sharedFrameConsumedCount = consumedCount;
+}
+
+void Metrics::onFrameEncoded(const FrameTimeInfo& info)
+{
+	std::lock_guard<std::mutex> locker(m_mutex);
+	m_encodeInfoList.append(info, infoExpirationTime);
+}
+
+void Metrics::onEncoderFrameDropped()
+{
+	++_encoderDroppedFrameCount;
+}
+
+void Metrics::setEncoderQueueDepth(int depth, int capacity)
+{
+	_encoderQueueDepth = depth;
+	_encoderQueueCapacity = capacity;
+}
+
+void Metrics::resetEncoderStats()
+{
+	_encoderDroppedFrameCount = 0;
+	_encoderQueueDepth = 0;
+	_encoderQueueCapacity = 0;
+	std::lock_guard<std::mutex> locker(m_mutex);
+	m_encodeInfoList.clear();
+}
+
+void Metrics::onRawRecordingFrameDropped()
+{
+	++_rawRecordingDroppedFrameCount;
+}
+
+void Metrics::resetRawRecordingStats()
+{
+	_rawRecordingDroppedFrameCount = 0;
+}
+
+void Metrics::onFrameScaledForDisplay(const FrameTimeInfo& info)
+{
+	std::lock_guard<std::mutex> locker(m_mutex);
+	m_displayScaleInfoList.append(info, infoExpirationTime);
+}
+
+void Metrics::onFramePainted(const FrameTimeInfo& info)
+{
+	std::lock_guard<std::mutex> locker(m_mutex);
+	m_paintInfoList.append(info, infoExpirationTime);
+}
+
+void Metrics::onFramePresented(const FrameTimeInfo& info, MetricsClock::duration refreshPeriod)
+{
+	if (refreshPeriod > MetricsClock::duration::zero()) {
+		_missedRefreshCount += static_cast<uint64_t>(info.duration / refreshPeriod);
+	}
+	std::lock_guard<std::mutex> locker(m_mutex);
+	m_presentInfoList.append(info, infoExpirationTime);
+}
 
-	m_frameTimeInfoList.push_back(info);
+void Metrics::onFrameSkipped()
+{
+	++_skippedFrameCount;
+}
+
+void Metrics::onFrameOverCap()
+{
+	++_overCapFrameCount;
+}
+
+void Metrics::onFrameLate()
+{
+	++_lateFrameCount;
+}
+
+void Metrics::onBackgroundFrameDecoded(const FrameTimeInfo& info)
+{
+	std::lock_guard<std::mutex> locker(m_mutex);
+	m_backgroundDecodeInfoList.append(info, infoExpirationTime);
 }
 
 bool Metrics::hasCameraError() const
@@ -53,18 +212,282 @@ void Metrics::setCameraSwitch(bool cameraSwitch)
 MetricsClock::duration Metrics::avgTimePerFrame() const
 {
 	std::lock_guard<std::mutex> locker(m_mutex);
+	auto sum = totalDuration(m_frameTimeInfoList);
+
+	return sum / std::max<size_t>(m_frameTimeInfoList.size(), 1);
+}
+
+bool Metrics::isBypassActive() const
+{
+	return _bypassActive;
+}
+
+uint64_t Metrics::bypassedFrameCount() const
+{
+	return _bypassedFrameCount;
+}
+
+MetricsClock::duration Metrics::avgBypassTime() const
+{
+	std::lock_guard<std::mutex> locker(m_mutex);
+	auto sum = totalDuration(m_bypassInfoList);
+
+	return sum / std::max<size_t>(m_bypassInfoList.size(), 1);
+}
+
+uint64_t Metrics::staticFrameCount() const
+{
+	return _staticFrameCount;
+}
+
+double Metrics::staticFrameRatio() const
+{
+	std::lock_guard<std::mutex> locker(m_mutex);
+	auto now = MetricsClock::now();
+	auto isRecent = [&now](const FrameTimeInfo& info) {
+		return ((now - info.timestamp) <= infoExpirationTime);
+	};
+	auto staticCount = std::count_if(m_staticInfoList.begin(), m_staticInfoList.end(), isRecent);
+	auto processedCount = std::count_if(m_frameTimeInfoList.begin(), m_frameTimeInfoList.end(), isRecent);
+	if (0 == staticCount + processedCount) {
+		return 0;
+	}
+
+	return double(staticCount) / double(staticCount + processedCount);
+}
+
+double Metrics::staticSceneCpuSaved() const
+{
+	std::lock_guard<std::mutex> locker(m_mutex);
+	auto now = MetricsClock::now();
+	auto detectionTime = MetricsClock::duration::zero();
+	int64_t staticCount = 0;
+	for (auto& info : m_staticInfoList) {
+		if ((now - info.timestamp) <= infoExpirationTime) {
+			detectionTime += info.duration;
+			++staticCount;
+		}
+	}
+	if ((0 == staticCount) || m_frameTimeInfoList.empty()) {
+		return 0;
+	}
+	auto avgProcessTime = totalDuration(m_frameTimeInfoList) / static_cast<int64_t>(m_frameTimeInfoList.size());
+	auto saved = avgProcessTime * staticCount - detectionTime;
+
+	return std::max(0.0, std::chrono::duration<double>(saved) / infoExpirationTime);
+}
+
+MetricsClock::duration Metrics::avgBackgroundDecodeTime() const
+{
+	std::lock_guard<std::mutex> locker(m_mutex);
+	auto sum = totalDuration(m_backgroundDecodeInfoList);
+
+	return sum / std::max<size_t>(m_backgroundDecodeInfoList.size(), 1);
+}
+
+double Metrics::backgroundDecodeLoad() const
+{
+	std::lock_guard<std::mutex> locker(m_mutex);
+	auto now = MetricsClock::now();
 	auto sum = MetricsClock::duration::zero();
-	for (auto& info : m_frameTimeInfoList) {
-		sum += info.duration;
+	for (auto& info : m_backgroundDecodeInfoList) {
+		if ((now - info.timestamp) <= infoExpirationTime) {
+			sum += info.duration;
+		}
 	}
 
-	return sum / std::max<size_t>(m_frameTimeInfoList.size(), 1);
+	return std::chrono::duration<double>(sum) / infoExpirationTime;
+}
+
+MetricsClock::duration Metrics::avgMediaDecodeTime() const
+{
+	std::lock_guard<std::mutex> locker(m_mutex);
+	auto now = MetricsClock::now();
+	if (m_mediaDecodeInfoList.empty() ||
+		((now - m_mediaDecodeInfoList.back().timestamp) > infoExpirationTime)) {
+		return MetricsClock::duration::zero();
+	}
+	auto sum = totalDuration(m_mediaDecodeInfoList);
+
+	return sum / m_mediaDecodeInfoList.size();
+}
+
+uint64_t Metrics::mediaReadStallCount() const
+{
+	return _mediaReadStallCount;
+}
+
+uint64_t Metrics::sharedFramePublishedCount() const
+{
+	return _sharedFramePublishedCount;
+}
+
+uint64_t Metrics::sharedFrameConsumedCount() const
+{
+	return _sharedFrameConsumedCount;
+}
+
+MetricsClock::duration Metrics::avgEncodeTime() const
+{
+	std::lock_guard<std::mutex> locker(m_mutex);
+	auto now = MetricsClock::now();
+	if (m_encodeInfoList.empty() ||
+		((now - m_encodeInfoList.back().timestamp) > infoExpirationTime)) {
+		return MetricsClock::duration::zero();
+	}
+	auto sum = totalDuration(m_encodeInfoList);
+
+	return sum / m_encodeInfoList.size();
+}
+
+uint64_t Metrics::encoderDroppedFrameCount() const
+{
+	return _encoderDroppedFrameCount;
+}
+
+int Metrics::encoderQueueDepth() const
+{
+	return _encoderQueueDepth;
+}
+
+int Metrics::encoderQueueCapacity() const
+{
+	return _encoderQueueCapacity;
+}
+
+uint64_t Metrics::rawRecordingDroppedFrameCount() const
+{
+	return _rawRecordingDroppedFrameCount;
+}
+
+MetricsClock::duration Metrics::avgDisplayScaleTime() const
+{
+	std::lock_guard<std::mutex> locker(m_mutex);
+	auto sum = totalDuration(m_displayScaleInfoList);
+
+	return sum / std::max<size_t>(m_displayScaleInfoList.size(), 1);
+}
+
+MetricsClock::duration Metrics::avgPaintTime() const
+{
+	std::lock_guard<std::mutex> locker(m_mutex);
+	auto sum = totalDuration(m_paintInfoList);
+
+	return sum / std::max<size_t>(m_paintInfoList.size(), 1);
+}
+
+MetricsClock::duration Metrics::avgPresentLatency() const
+{
+	std::lock_guard<std::mutex> locker(m_mutex);
+	auto sum = totalDuration(m_presentInfoList);
+
+	return sum / std::max<size_t>(m_presentInfoList.size(), 1);
+}
+
+MetricsClock::duration Metrics::presentJitter() const
+{
+	std::lock_guard<std::mutex> locker(m_mutex);
+	if (m_presentInfoList.size() < 3) {
+		return MetricsClock::duration::zero();
+	}
+
+	auto intervalCount = static_cast<int64_t>(m_presentInfoList.size() - 1);
+	auto avgInterval =
+		(m_presentInfoList.back().timestamp - m_presentInfoList.front().timestamp) / intervalCount;
+	auto deviationSum = MetricsClock::duration::zero();
+	auto prevIter = m_presentInfoList.begin();
+	for (auto iter = std::next(prevIter); iter != m_presentInfoList.end(); prevIter = iter++) {
+		auto interval = iter->timestamp - prevIter->timestamp;
+		deviationSum += (interval > avgInterval) ? (interval - avgInterval) : (avgInterval - interval);
+	}
+
+	return deviationSum / intervalCount;
+}
+
+uint64_t Metrics::missedRefreshCount() const
+{
+	return _missedRefreshCount;
+}
+
+uint64_t Metrics::skippedFrameCount() const
+{
+	return _skippedFrameCount;
 }
 
 QSize Metrics::lastFrameSize() const
 {
+	std::lock_guard<std::mutex> locker(m_mutex);
 	if (m_frameTimeInfoList.empty()) {
 		return {};
 	}
 	return m_frameTimeInfoList.back().size;
 }
+
+double Metrics::frameRateCap() const
+{
+	return _frameRateCap;
+}
+
+void Metrics::setFrameRateCap(double fps)
+{
+	_frameRateCap = fps;
+}
+
+double Metrics::achievedFps() const
+{
+	std::lock_guard<std::mutex> locker(m_mutex);
+	auto now = MetricsClock::now();
+	auto isRecent = [&now](const FrameTimeInfo& info) {
+		return ((now - info.timestamp) <= infoExpirationTime);
+	};
+	auto frameCount =
+		std::count_if(m_frameTimeInfoList.begin(), m_frameTimeInfoList.end(), isRecent) +
+		std::count_if(m_bypassInfoList.begin(), m_bypassInfoList.end(), isRecent) +
+		std::count_if(m_staticInfoList.begin(), m_staticInfoList.end(), isRecent);
+
+	return frameCount / std::chrono::duration<double>(infoExpirationTime).count();
+}
+
+uint64_t Metrics::overCapFrameCount() const
+{
+	return _overCapFrameCount;
+}
+
+uint64_t Metrics::lateFrameCount() const
+{
+	return _lateFrameCount;
+}
+
+bool Metrics::isLowPowerMode() const
+{
+	return _lowPowerMode;
+}
+
+void Metrics::setLowPowerMode(bool lowPowerMode)
+{
+	_lowPowerMode = lowPowerMode;
+}
+
+void Metrics::sampleCpuUsage()
+{
+	auto now = MetricsClock::now();
+	auto cpuTime = processCpuTime();
+
+	std::lock_guard<std::mutex> locker(m_mutex);
+	auto elapsed = std::chrono::duration<double>(now - m_cpuSampleTime).count();
+	if (elapsed <= 0) {
+		return;
+	}
+
+	double usage = std::chrono::duration<double>(cpuTime - m_cpuSampleCpuTime).count() / elapsed;
+	double& modeUsage = m_cpuUsage[_lowPowerMode ? 1 : 0];
+	modeUsage = (modeUsage > 0) ? (0.75 * modeUsage + 0.25 * usage) : usage;
+	m_cpuSampleTime = now;
+	m_cpuSampleCpuTime = cpuTime;
+}
+
+double Metrics::cpuUsage(bool lowPowerMode) const
+{
+	std::lock_guard<std::mutex> locker(m_mutex);
+	return m_cpuUsage[lowPowerMode ? 1 : 0];
+}
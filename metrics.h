@@ -1,9 +1,13 @@
 #ifndef METRICS_H
 #define METRICS_H
 
+#include <atomic>
 #include <chrono>
-#include <list>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
 #include <mutex>
+#include <vector>
 #include <QSize>
 
 using MetricsClock = std::chrono::steady_clock;
@@ -17,6 +21,69 @@ struct FrameTimeInfo
 	QSize size;
 };
 
+// The frame times of the last second, oldest first. A ring which keeps its
+// capacity, so adding a frame does not allocate once it holds a second of
+// frames.
+class FrameTimeHistory
+{
+public:
+	class const_iterator
+	{
+	public:
+		using iterator_category = std::forward_iterator_tag;
+		using value_type = FrameTimeInfo;
+		using difference_type = std::ptrdiff_t;
+		using pointer = const FrameTimeInfo*;
+		using reference = const FrameTimeInfo&;
+
+		const_iterator(const FrameTimeHistory* history, size_t index)
+			: _history(history)
+			, _index(index)
+		{ }
+
+		reference operator*() const { return _history->at(_index); }
+		pointer operator->() const { return &_history->at(_index); }
+		const_iterator& operator++()
+		{
+			++_index;
+			return *this;
+		}
+		const_iterator operator++(int)
+		{
+			const_iterator previous = *this;
+			++_index;
+			return previous;
+		}
+		bool operator==(const const_iterator& other) const { return _index == other._index; }
+		bool operator!=(const const_iterator& other) const { return _index != other._index; }
+
+	private:
+		const FrameTimeHistory* _history;
+		size_t _index;
+	};
+
+	// Drops the infos older than maxAge before the new one.
+	void append(const FrameTimeInfo& info, MetricsClock::duration maxAge);
+	void clear();
+
+	bool empty() const { return 0 == _size; }
+	size_t size() const { return _size; }
+	// The infos it holds without allocating.
+	size_t capacity() const { return _items.size(); }
+	const FrameTimeInfo& front() const { return at(0); }
+	const FrameTimeInfo& back() const { return at(_size - 1); }
+	const_iterator begin() const { return const_iterator(this, 0); }
+	const_iterator end() const { return const_iterator(this, _size); }
+
+private:
+	const FrameTimeInfo& at(size_t index) const { return _items[(_first + index) % _items.size()]; }
+
+private:
+	std::vector<FrameTimeInfo> _items;
+	size_t _first = 0;
+	size_t _size = 0;
+};
+
 class Metrics
 {
 public:
@@ -24,6 +91,40 @@ public:
 	~Metrics() = default;
 
 	void onFrameProcessed(const FrameTimeInfo& info);
+	// Called from the decode thread of an animated background.
+	void onBackgroundFrameDecoded(const FrameTimeInfo& info);
+	// Called from the decode thread of a media file source.
+	void onMediaFrameDecoded(const FrameTimeInfo& info);
+	// The pipeline had to wait for the media decoder.
+	void onMediaReadStalled();
+	// Frames published to shared memory and the number of the last one a consumer read.
+	void onSharedFramePublished(uint64_t publishedCount, uint64_t consumedCount);
+	// Called from the encode thread of the output recording.
+	void onFrameEncoded(const FrameTimeInfo& info);
+	void onEncoderFrameDropped();
+	void setEncoderQueueDepth(int depth, int capacity);
+	void resetEncoderStats();
+	// Called from the pipeline thread for a captured frame the raw recorder
+	// had no free buffer for.
+	void onRawRecordingFrameDropped();
+	void resetRawRecordingStats();
+	// Called instead of onFrameProcessed() for frames shown without the filter.
+	void onFrameBypassed(const FrameTimeInfo& info);
+	// Called instead of onFrameProcessed() for static frames which got the
+	// last output, the duration is the detection.
+	void onFrameStatic(const FrameTimeInfo& info);
+	// Scaling of processed frames to the view size on the pipeline thread.
+	void onFrameScaledForDisplay(const FrameTimeInfo& info);
+	// Called from the GUI thread.
+	void onFramePainted(const FrameTimeInfo& info);
+	// The duration is the wait from the frame arrival to its paint,
+	// refreshPeriod is zero when the screen does not report it.
+	void onFramePresented(const FrameTimeInfo& info, MetricsClock::duration refreshPeriod);
+	// A frame replaced by a newer one before it was painted.
+	void onFrameSkipped();
+	// Read frames the pipeline dropped for the frame rate cap or for being late.
+	void onFrameOverCap();
+	void onFrameLate();
 
 	bool hasCameraError() const;
 	void setCameraError(bool hasError);
@@ -32,12 +133,90 @@ public:
 	void setCameraSwitch(bool cameraSwitch);
 
 	MetricsClock::duration avgTimePerFrame() const;
+	bool isBypassActive() const;
+	uint64_t bypassedFrameCount() const;
+	MetricsClock::duration avgBypassTime() const;
+	uint64_t staticFrameCount() const;
+	// Share of the frames of the last second which reused the last output.
+	double staticFrameRatio() const;
+	// Share of one CPU core the reused frames saved during the last second,
+	// estimated from the average processing time less the detection time.
+	double staticSceneCpuSaved() const;
+
+	MetricsClock::duration avgBackgroundDecodeTime() const;
+	// Share of one CPU core spent on background decoding during the last second.
+	double backgroundDecodeLoad() const;
+
+	MetricsClock::duration avgMediaDecodeTime() const;
+	uint64_t mediaReadStallCount() const;
+
+	uint64_t sharedFramePublishedCount() const;
+	uint64_t sharedFrameConsumedCount() const;
+
+	// Zero when nothing was encoded recently.
+	MetricsClock::duration avgEncodeTime() const;
+	uint64_t encoderDroppedFrameCount() const;
+	int encoderQueueDepth() const;
+	// Zero while not recording.
+	int encoderQueueCapacity() const;
+	uint64_t rawRecordingDroppedFrameCount() const;
+
+	MetricsClock::duration avgDisplayScaleTime() const;
+	MetricsClock::duration avgPaintTime() const;
+	MetricsClock::duration avgPresentLatency() const;
+	// Mean deviation of the intervals between presented frames from their average.
+	MetricsClock::duration presentJitter() const;
+	uint64_t missedRefreshCount() const;
+	uint64_t skippedFrameCount() const;
 
 	QSize lastFrameSize() const;
 
+	double frameRateCap() const;
+	void setFrameRateCap(double fps);
+	// Frames processed, bypassed or static during the last second.
+	double achievedFps() const;
+	uint64_t overCapFrameCount() const;
+	uint64_t lateFrameCount() const;
+
+	// Set by the pipeline while frames are not processed for lack of consumers.
+	bool isLowPowerMode() const;
+	void setLowPowerMode(bool lowPowerMode);
+	// Attributes the process CPU time since the previous call to the current
+	// mode, called periodically from the GUI thread.
+	void sampleCpuUsage();
+	// Share of one CPU core used by the process, smoothed over recent samples.
+	double cpuUsage(bool lowPowerMode) const;
+
 private:
 	mutable std::mutex m_mutex;
-	std::list<FrameTimeInfo> m_frameTimeInfoList;
+	FrameTimeHistory m_frameTimeInfoList;
+	FrameTimeHistory m_backgroundDecodeInfoList;
+	FrameTimeHistory m_mediaDecodeInfoList;
+	std::atomic<uint64_t> _mediaReadStallCount;
+	std::atomic<uint64_t> _sharedFramePublishedCount;
+	std::atomic<uint64_t> _sharedFrameConsumedCount;
+	FrameTimeHistory m_encodeInfoList;
+	std::atomic<uint64_t> _encoderDroppedFrameCount;
+	std::atomic<int> _encoderQueueDepth;
+	std::atomic<int> _encoderQueueCapacity;
+	std::atomic<uint64_t> _rawRecordingDroppedFrameCount;
+	FrameTimeHistory m_bypassInfoList;
+	FrameTimeHistory m_displayScaleInfoList;
+	FrameTimeHistory m_paintInfoList;
+	FrameTimeHistory m_presentInfoList;
+	std::atomic<uint64_t> _missedRefreshCount;
+	std::atomic<uint64_t> _skippedFrameCount;
+	std::atomic<bool> _bypassActive;
+	std::atomic<uint64_t> _bypassedFrameCount;
+	FrameTimeHistory m_staticInfoList;
+	std::atomic<uint64_t> _staticFrameCount;
+	std::atomic<double> _frameRateCap;
+	std::atomic<uint64_t> _overCapFrameCount;
+	std::atomic<uint64_t> _lateFrameCount;
+	std::atomic<bool> _lowPowerMode;
+	MetricsClock::time_point m_cpuSampleTime;
+	MetricsClock::duration m_cpuSampleCpuTime;
+	double m_cpuUsage[2];
 	std::atomic<bool> _cameraError;
 	std::atomic<bool> _cameraSwitch;
 
@@ -17,9 +17,65 @@ MetricsView::MetricsView()
 	palette.setColor(QPalette::WindowText, Qt::white);
 	m_avgTimePerFrame->setPalette(palette);
 
+	m_backgroundDecode = new QLabel(this);
+	m_backgroundDecode->setFont(font);
+	m_backgroundDecode->setPalette(palette);
+	m_backgroundDecode->hide();
+
+	m_mediaDecode = new QLabel(this);
+	m_mediaDecode->setFont(font);
+	m_mediaDecode->setPalette(palette);
+	m_mediaDecode->hide();
+
+	m_sharedMemory = new QLabel(this);
+	m_sharedMemory->setFont(font);
+	m_sharedMemory->setPalette(palette);
+	m_sharedMemory->hide();
+
+	m_encoder = new QLabel(this);
+	m_encoder->setFont(font);
+	m_encoder->setPalette(palette);
+	m_encoder->hide();
+
+	m_rawRecording = new QLabel(this);
+	m_rawRecording->setFont(font);
+	m_rawRecording->setPalette(palette);
+	m_rawRecording->hide();
+
+	m_present = new QLabel(this);
+	m_present->setFont(font);
+	m_present->setPalette(palette);
+
+	m_presentPacing = new QLabel(this);
+	m_presentPacing->setFont(font);
+	m_presentPacing->setPalette(palette);
+
+	m_frameRate = new QLabel(this);
+	m_frameRate->setFont(font);
+	m_frameRate->setPalette(palette);
+
+	m_staticScene = new QLabel(this);
+	m_staticScene->setFont(font);
+	m_staticScene->setPalette(palette);
+	m_staticScene->hide();
+
+	m_cpuUsage = new QLabel(this);
+	m_cpuUsage->setFont(font);
+	m_cpuUsage->setPalette(palette);
+
 	auto layout = new QVBoxLayout(this);
 	layout->setContentsMargins(5, 3, 5, 3);
 	layout->addWidget(m_avgTimePerFrame);
+	layout->addWidget(m_backgroundDecode);
+	layout->addWidget(m_mediaDecode);
+	layout->addWidget(m_sharedMemory);
+	layout->addWidget(m_encoder);
+	layout->addWidget(m_rawRecording);
+	layout->addWidget(m_present);
+	layout->addWidget(m_presentPacing);
+	layout->addWidget(m_frameRate);
+	layout->addWidget(m_staticScene);
+	layout->addWidget(m_cpuUsage);
 }
 
 void MetricsView::update(const MetricsClock::duration& avgDuration, const QSize& size)
@@ -35,6 +91,191 @@ void MetricsView::update(const MetricsClock::duration& avgDuration, const QSize&
 	m_avgTimePerFrame->setText(text);
 }
 
+void MetricsView::updateBackgroundDecode(const MetricsClock::duration& avgDuration, double load)
+{
+	if (load <= 0) {
+		m_backgroundDecode->hide();
+		return;
+	}
+
+	auto microsecondsPerFrame =
+		std::chrono::duration_cast<std::chrono::microseconds>(avgDuration);
+	auto milisecondsPerFrame = double(microsecondsPerFrame.count()) / 1000;
+
+	m_backgroundDecode->setText(
+		QString("Background decode: %1 ms per frame, %2% CPU")
+			.arg(milisecondsPerFrame, 0, 'g', 3)
+			.arg(load * 100, 0, 'f', 1)
+	);
+	m_backgroundDecode->show();
+}
+
+void MetricsView::updateMediaDecode(const MetricsClock::duration& avgDuration, uint64_t stallCount)
+{
+	if (avgDuration <= MetricsClock::duration::zero()) {
+		m_mediaDecode->hide();
+		return;
+	}
+
+	auto microsecondsPerFrame =
+		std::chrono::duration_cast<std::chrono::microseconds>(avgDuration);
+	auto milisecondsPerFrame = double(microsecondsPerFrame.count()) / 1000;
+
+	m_mediaDecode->setText(
+		QString("Media decode: %1 ms per frame, %2 stalls")
+			.arg(milisecondsPerFrame, 0, 'g', 3)
+			.arg(stallCount)
+	);
+	m_mediaDecode->show();
+}
+
+void MetricsView::updateSharedMemory(uint64_t publishedCount, uint64_t consumedCount)
+{
+	if (0 == publishedCount) {
+		m_sharedMemory->hide();
+		return;
+	}
+
+	auto text = QString("Shared memory: %1 frames, ").arg(publishedCount);
+	if (0 == consumedCount) {
+		text += "no consumer";
+	}
+	else {
+		uint64_t lag = (consumedCount < publishedCount) ? (publishedCount - consumedCount) : 0;
+		text += QString("consumer lag %1 frames").arg(lag);
+	}
+	m_sharedMemory->setText(text);
+	m_sharedMemory->show();
+}
+
+void MetricsView::updateEncoder(
+	const MetricsClock::duration& avgDuration,
+	int queueDepth,
+	int queueCapacity,
+	uint64_t droppedCount
+)
+{
+	if (queueCapacity <= 0) {
+		m_encoder->hide();
+		return;
+	}
+
+	auto microsecondsPerFrame =
+		std::chrono::duration_cast<std::chrono::microseconds>(avgDuration);
+	auto milisecondsPerFrame = double(microsecondsPerFrame.count()) / 1000;
+
+	m_encoder->setText(
+		QString("Encoder: %1 ms per frame, queue %2/%3, %4 dropped")
+			.arg(milisecondsPerFrame, 0, 'g', 3)
+			.arg(queueDepth)
+			.arg(queueCapacity)
+			.arg(droppedCount)
+	);
+	m_encoder->show();
+}
+
+void MetricsView::updateRawRecording(bool recording, uint64_t droppedCount)
+{
+	if (!recording) {
+		m_rawRecording->hide();
+		return;
+	}
+
+	m_rawRecording->setText(QString("Raw recording: %1 dropped").arg(droppedCount));
+	m_rawRecording->show();
+}
+
+void MetricsView::updatePresent(
+	const MetricsClock::duration& avgScaleDuration,
+	const MetricsClock::duration& avgPaintDuration
+)
+{
+	auto scaleMicroseconds =
+		std::chrono::duration_cast<std::chrono::microseconds>(avgScaleDuration);
+	auto paintMicroseconds =
+		std::chrono::duration_cast<std::chrono::microseconds>(avgPaintDuration);
+
+	m_present->setText(
+		QString("Display scale: %1 ms, paint: %2 ms")
+			.arg(double(scaleMicroseconds.count()) / 1000, 0, 'g', 3)
+			.arg(double(paintMicroseconds.count()) / 1000, 0, 'g', 3)
+	);
+}
+
+void MetricsView::updatePresentPacing(
+	const MetricsClock::duration& avgLatency,
+	const MetricsClock::duration& jitter,
+	uint64_t missedRefreshCount,
+	uint64_t skippedFrameCount
+)
+{
+	auto latencyMicroseconds =
+		std::chrono::duration_cast<std::chrono::microseconds>(avgLatency);
+	auto jitterMicroseconds =
+		std::chrono::duration_cast<std::chrono::microseconds>(jitter);
+
+	m_presentPacing->setText(
+		QString("Present: %1 ms wait, %2 ms jitter, %3 missed refreshes, %4 skipped")
+			.arg(double(latencyMicroseconds.count()) / 1000, 0, 'g', 3)
+			.arg(double(jitterMicroseconds.count()) / 1000, 0, 'g', 3)
+			.arg(missedRefreshCount)
+			.arg(skippedFrameCount)
+	);
+}
+
+void MetricsView::updateFrameRate(
+	double cap,
+	double achievedFps,
+	uint64_t overCapCount,
+	uint64_t lateCount
+)
+{
+	auto text = QString("%1 fps").arg(achievedFps, 0, 'f', 1);
+	if (cap > 0) {
+		text += QString(" of %1 cap, %2 over cap").arg(cap, 0, 'g', 3).arg(overCapCount);
+	}
+	text += QString(", %1 late").arg(lateCount);
+	m_frameRate->setText(text);
+}
+
+void MetricsView::updateStaticScene(double staticRatio, double cpuSaved, uint64_t frameCount)
+{
+	if (staticRatio <= 0) {
+		m_staticScene->hide();
+		return;
+	}
+
+	m_staticScene->setText(
+		QString("Static scene: %1% of frames reused, %2% CPU saved, %3 frames")
+			.arg(staticRatio * 100, 0, 'f', 1)
+			.arg(cpuSaved * 100, 0, 'f', 1)
+			.arg(frameCount)
+	);
+	m_staticScene->show();
+}
+
+void MetricsView::updateCpuUsage(double activeUsage, double lowPowerUsage)
+{
+	auto text = QString("CPU: %1%").arg(activeUsage * 100, 0, 'f', 1);
+	if (lowPowerUsage > 0) {
+		text += QString(", %1% while hidden").arg(lowPowerUsage * 100, 0, 'f', 1);
+	}
+	m_cpuUsage->setText(text);
+}
+
+void MetricsView::setBypass(const MetricsClock::duration& avgDuration, uint64_t frameCount)
+{
+	auto microsecondsPerFrame =
+		std::chrono::duration_cast<std::chrono::microseconds>(avgDuration);
+	auto milisecondsPerFrame = double(microsecondsPerFrame.count()) / 1000;
+
+	m_avgTimePerFrame->setText(
+		QString("No effects, bypass: %1 ms per frame, %2 frames")
+			.arg(milisecondsPerFrame, 0, 'g', 3)
+			.arg(frameCount)
+	);
+}
+
 void MetricsView::setCameraSwitch()
 {
 	m_avgTimePerFrame->setText("Switch camera");
@@ -12,11 +12,55 @@ public:
 	MetricsView();
 
 	void update(const MetricsClock::duration& avgDuration, const QSize& size);
+	void updateBackgroundDecode(const MetricsClock::duration& avgDuration, double load);
+	// Hidden when nothing was decoded recently.
+	void updateMediaDecode(const MetricsClock::duration& avgDuration, uint64_t stallCount);
+	// Hidden until a frame is published.
+	void updateSharedMemory(uint64_t publishedCount, uint64_t consumedCount);
+	// Hidden while not recording.
+	void updateEncoder(
+		const MetricsClock::duration& avgDuration,
+		int queueDepth,
+		int queueCapacity,
+		uint64_t droppedCount
+	);
+	// Hidden while not recording.
+	void updateRawRecording(bool recording, uint64_t droppedCount);
+	void updatePresent(
+		const MetricsClock::duration& avgScaleDuration,
+		const MetricsClock::duration& avgPaintDuration
+	);
+	void updatePresentPacing(
+		const MetricsClock::duration& avgLatency,
+		const MetricsClock::duration& jitter,
+		uint64_t missedRefreshCount,
+		uint64_t skippedFrameCount
+	);
+	void updateFrameRate(
+		double cap,
+		double achievedFps,
+		uint64_t overCapCount,
+		uint64_t lateCount
+	);
+	// Hidden when no frame reused the last output recently.
+	void updateStaticScene(double staticRatio, double cpuSaved, uint64_t frameCount);
+	void updateCpuUsage(double activeUsage, double lowPowerUsage);
+	void setBypass(const MetricsClock::duration& avgDuration, uint64_t frameCount);
 	void setCameraSwitch();
 	void setCameraError();
 
 private:
 	QLabel* m_avgTimePerFrame = nullptr;
+	QLabel* m_backgroundDecode = nullptr;
+	QLabel* m_mediaDecode = nullptr;
+	QLabel* m_sharedMemory = nullptr;
+	QLabel* m_encoder = nullptr;
+	QLabel* m_rawRecording = nullptr;
+	QLabel* m_present = nullptr;
+	QLabel* m_presentPacing = nullptr;
+	QLabel* m_frameRate = nullptr;
+	QLabel* m_staticScene = nullptr;
+	QLabel* m_cpuUsage = nullptr;
 };
 
 #endif
@@ -1,14 +1,71 @@
 #include "pipeline.h"
 
+#include "frame_scheduler.h"
+#include "frame_view.h"
+#include "image_pool.h"
+#include "matte_compositor.h"
+#include "media_reader.h"
+#include "pixel_convert.h"
+#include "raw_recording.h"
+#include "static_scene.h"
+
+#include <algorithm>
+#include <memory>
+
 #include <opencv2/opencv.hpp>
 
+// Frames read while nobody consumes them, keeps the device streaming.
+static const auto keepAliveFrameInterval = std::chrono::milliseconds(500);
+// Captured frames the raw recorder buffers while the disk is busy.
+static const int rawRecordingQueueSize = 8;
+// Assumed when the source does not report its frame rate.
+static const double defaultSourceFps = 30;
+
+#if (CV_MAJOR_VERSION >= 3)
+static const int positionMsecProperty = cv::CAP_PROP_POS_MSEC;
+static const int fpsProperty = cv::CAP_PROP_FPS;
+#else
+static const int positionMsecProperty = CV_CAP_PROP_POS_MSEC;
+static const int fpsProperty = CV_CAP_PROP_FPS;
+#endif
+
+// On Linux cameras are opened by their device path.
+static bool isDevicePath(const std::string& path)
+{
+	return (0 == path.compare(0, 5, "/dev/"));
+}
+
+// Fits the processing size into the captured frame keeping its aspect ratio.
+static QSize processingSizeFor(const QSize& captureSize, const QSize& requestedSize)
+{
+	if (!requestedSize.isValid() ||
+		((requestedSize.width() >= captureSize.width()) &&
+		 (requestedSize.height() >= captureSize.height()))) {
+		return captureSize;
+	}
+
+	QSize size = captureSize.scaled(requestedSize, Qt::KeepAspectRatio);
+	return QSize(std::max(2, size.width() & ~1), std::max(2, size.height() & ~1));
+}
+
 Pipeline::Pipeline(QObject* parent)
 	: QObject(parent)
 	, _stopRequested(false)
 	, _openDeviceRequested(true)
 	, _deviceIndex(0)
-	, _frameWidth(1280)
-	, _frameHeight(720)
+	, _frameWidth(DEFAULT_CAPTURE_WIDTH)
+	, _frameHeight(DEFAULT_CAPTURE_HEIGHT)
+	, _processingWidth(DEFAULT_SCALE_WIDTH)
+	, _processingHeight(DEFAULT_SCALE_HEIGHT)
+	, _displaySize(0)
+	, _viewVisible(true)
+	, _targetFps(0)
+	, _benchmarkMode(false)
+	, _staticSceneThreshold(0)
+	, _recording(false)
+	, _sinkCount(0)
+	, _matteSinkCount(0)
+	, _compositing(false)
 {
 #ifdef  Q_OS_WINDOWS
 	bool notDefined = qgetenv("OPENCV_VIDEOIO_MSMF_ENABLE_HW_TRANSFORMS").isEmpty();
@@ -17,11 +74,20 @@ Pipeline::Pipeline(QObject* parent)
 		qputenv("OPENCV_VIDEOIO_MSMF_ENABLE_HW_TRANSFORMS", "0");
 	}
 #endif
+
+	if (m_videoFilter.isValid()) {
+		m_videoFilter.setMetrics(&m_metrics);
+		m_videoFilter.setFrameSize(QSize(_processingWidth, _processingHeight));
+	}
 }
 
 Pipeline::~Pipeline()
 {
-	_stopRequested = true;
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_stopRequested = true;
+	}
+	_consumerCondition.notify_all();
 	if (_loopThread.joinable()) {
 		_loopThread.join();
 	}
@@ -49,6 +115,16 @@ void Pipeline::setMediaPath(const std::string& path)
 	_openDeviceRequested = true;
 }
 
+void Pipeline::setFrameSource(std::unique_ptr<FrameSource> source)
+{
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_pendingSource = std::move(source);
+		_openDeviceRequested = true;
+	}
+	_consumerCondition.notify_all();
+}
+
 void Pipeline::getFrameSize(int& width, int& height)
 {
 	std::lock_guard<std::mutex> lock(_mutex);
@@ -68,6 +144,157 @@ void Pipeline::trySetFrameSize(int width, int height)
 	_openDeviceRequested = true;
 }
 
+void Pipeline::getProcessingSize(int& width, int& height)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	width = _processingWidth;
+	height = _processingHeight;
+}
+
+void Pipeline::setProcessingSize(int width, int height)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	_processingWidth = width;
+	_processingHeight = height;
+	if ((width > _frameWidth) || (height > _frameHeight)) {
+		_frameWidth = std::max(width, _frameWidth);
+		_frameHeight = std::max(height, _frameHeight);
+		_openDeviceRequested = true;
+	}
+}
+
+void Pipeline::setDisplaySize(const QSize& size)
+{
+	uint64_t width = static_cast<uint32_t>(std::max(size.width(), 0));
+	uint64_t height = static_cast<uint32_t>(std::max(size.height(), 0));
+	_displaySize = (width << 32) | height;
+}
+
+void Pipeline::setViewVisible(bool visible)
+{
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_viewVisible = visible;
+	}
+	_consumerCondition.notify_all();
+}
+
+void Pipeline::setTargetFps(double fps)
+{
+	_targetFps = fps;
+	m_metrics.setFrameRateCap(fps);
+}
+
+void Pipeline::setBenchmarkMode(bool benchmarkMode)
+{
+	_benchmarkMode = benchmarkMode;
+}
+
+void Pipeline::setStaticSceneThreshold(double threshold)
+{
+	_staticSceneThreshold = threshold;
+}
+
+bool Pipeline::startRecording(const QString& filePath)
+{
+	std::unique_ptr<RawRecorder> recorder(new RawRecorder(filePath, rawRecordingQueueSize, &m_metrics));
+	if (!recorder->isValid()) {
+		return false;
+	}
+	m_metrics.resetRawRecordingStats();
+
+	{
+		std::lock_guard<std::mutex> lock(_recorderMutex);
+		_recorder = std::move(recorder);
+		_recordingStartTime = MetricsClock::now();
+		_recording = true;
+	}
+	_consumerCondition.notify_all();
+	return true;
+}
+
+void Pipeline::stopRecording()
+{
+	std::unique_ptr<RawRecorder> recorder;
+	{
+		std::lock_guard<std::mutex> lock(_recorderMutex);
+		_recording = false;
+		recorder = std::move(_recorder);
+	}
+	if (nullptr == recorder) {
+		emit recordingFinished(false);
+		return;
+	}
+
+	RawRecorder* finishing = recorder.get();
+	_finishingRecorders.push_back(std::move(recorder));
+	finishing->finish([this, finishing](bool written) {
+		// Called last on the writer thread, which is joined right away.
+		QMetaObject::invokeMethod(this, [this, finishing, written]() {
+			_finishingRecorders.erase(
+				std::remove_if(
+					_finishingRecorders.begin(),
+					_finishingRecorders.end(),
+					[finishing](const std::unique_ptr<RawRecorder>& recorder) {
+						return recorder.get() == finishing;
+					}
+				),
+				_finishingRecorders.end()
+			);
+			emit recordingFinished(written);
+		}, Qt::QueuedConnection);
+	});
+}
+
+void Pipeline::addSink(const std::shared_ptr<FrameSink>& sink)
+{
+	{
+		std::lock_guard<std::mutex> lock(_sinkMutex);
+		_sinks.push_back(sink);
+		_sinkCount = static_cast<int>(_sinks.size());
+	}
+	_consumerCondition.notify_all();
+}
+
+void Pipeline::removeSink(const std::shared_ptr<FrameSink>& sink)
+{
+	std::lock_guard<std::mutex> lock(_sinkMutex);
+	_sinks.erase(std::remove(_sinks.begin(), _sinks.end(), sink), _sinks.end());
+	_sinkCount = static_cast<int>(_sinks.size());
+}
+
+void Pipeline::addMatteSink(const std::shared_ptr<FrameSink>& sink)
+{
+	{
+		std::lock_guard<std::mutex> lock(_sinkMutex);
+		_matteSinks.push_back(sink);
+		_matteSinkCount = static_cast<int>(_matteSinks.size());
+	}
+	_consumerCondition.notify_all();
+}
+
+void Pipeline::removeMatteSink(const std::shared_ptr<FrameSink>& sink)
+{
+	std::lock_guard<std::mutex> lock(_sinkMutex);
+	_matteSinks.erase(std::remove(_matteSinks.begin(), _matteSinks.end(), sink), _matteSinks.end());
+	_matteSinkCount = static_cast<int>(_matteSinks.size());
+}
+
+void Pipeline::setMatteCompositor(const std::shared_ptr<MatteCompositor>& compositor)
+{
+	{
+		std::lock_guard<std::mutex> lock(_sinkMutex);
+		_matteCompositor = compositor;
+		_compositing = (nullptr != compositor);
+	}
+	_consumerCondition.notify_all();
+}
+
+bool Pipeline::hasFrameConsumers() const
+{
+	return _viewVisible || _recording || (_sinkCount > 0) || (_matteSinkCount > 0) || _compositing;
+}
+
 void Pipeline::start()
 {
 	if (_started) {
@@ -88,16 +315,35 @@ Metrics* Pipeline::metrics()
 	return &m_metrics;
 }
 
+AllocationReport* Pipeline::allocationReport()
+{
+	return &_allocationReport;
+}
+
 void Pipeline::runLoop()
 {
 	cv::Mat readMat;
+	cv::Mat scaledMat;
 	cv::VideoCapture capturer;
+	// Used instead of the capturer for media files and raw recordings.
+	std::unique_ptr<FrameSource> fileSource;
 	QImage cameraFrame;
+	QSize cameraFrameSize;
+	// A frame still held by a consumer, e.g. the view, is not overwritten.
+	ImagePool cameraFramePool;
+	FrameScheduler scheduler;
+	FrameAllocationTracker allocations;
+	StaticSceneDetector staticScene;
+	// The last output of the filter, reused for static frames while the
+	// settings it was produced with are unchanged.
+	QImage lastOutput;
+	uint64_t lastOutputGeneration = 0;
 
 	while (!_stopRequested) {
 		if (_openDeviceRequested.exchange(false)) {
 			m_metrics.setCameraSwitch(true);
 			capturer.release();
+			fileSource.reset();
 
 			int frameWidth;
 			int frameHeight;
@@ -109,59 +355,330 @@ void Pipeline::runLoop()
 				frameHeight = _frameHeight;
 				deviceIndex = _deviceIndex;
 				mediaPath = _mediaPath;
+				fileSource = std::move(_pendingSource);
 			}
-			if (!mediaPath.empty()) {
-				capturer.open(mediaPath);
+			const bool mediaFile = (nullptr != fileSource) || (!mediaPath.empty() && !isDevicePath(mediaPath));
+			double sourceFps = 0;
+			if (mediaFile) {
+				// A source set with setFrameSource() is used as is.
+				if (nullptr == fileSource) {
+					if (RawReplay::isRawRecording(mediaPath)) {
+						fileSource.reset(new RawReplay(mediaPath));
+					}
+					else {
+						fileSource.reset(new MediaReader(mediaPath, &m_metrics));
+					}
+				}
+				sourceFps = fileSource->frameRate();
 			}
 			else {
-				capturer.open(deviceIndex);
+				if (!mediaPath.empty()) {
+					capturer.open(mediaPath);
+				}
+				else {
+					capturer.open(deviceIndex);
+				}
+				#if (CV_MAJOR_VERSION >= 3)
+				capturer.set(cv::CAP_PROP_FRAME_WIDTH, frameWidth);
+				capturer.set(cv::CAP_PROP_FRAME_HEIGHT, frameHeight);
+				#else
+				capturer.set(CV_CAP_PROP_FRAME_WIDTH, frameWidth);
+				capturer.set(CV_CAP_PROP_FRAME_HEIGHT, frameHeight);
+				#endif
+				sourceFps = capturer.get(fpsProperty);
+			}
+
+			if (!(sourceFps > 0)) {
+				sourceFps = defaultSourceFps;
 			}
-			#if (CV_MAJOR_VERSION >= 3)
-			capturer.set(cv::CAP_PROP_FRAME_WIDTH, frameWidth);
-			capturer.set(cv::CAP_PROP_FRAME_HEIGHT, frameHeight);
-			#else
-			capturer.set(CV_CAP_PROP_FRAME_WIDTH, frameWidth);
-			capturer.set(CV_CAP_PROP_FRAME_HEIGHT, frameHeight);
-			#endif
+			scheduler.reset(
+				mediaFile,
+				std::chrono::duration_cast<MetricsClock::duration>(
+					std::chrono::duration<double>(1.0 / sourceFps)
+				)
+			);
+			staticScene.reset();
 
 			m_metrics.setCameraSwitch(false);
 			m_metrics.setCameraError(false);
 		}
 
-		if (!capturer.read(readMat)) {
+		auto readBeginTime = MetricsClock::now();
+		auto position = MetricsClock::duration::zero();
+		bool frameRead = false;
+		if (nullptr != fileSource) {
+			frameRead = fileSource->read(readMat, position);
+		}
+		else {
+			// The capture backend allocates inside OpenCV.
+			ExternalAllocationScope externalAllocations;
+			frameRead = capturer.read(readMat);
+		}
+		if (!frameRead) {
+			if ((nullptr != fileSource) && fileSource->atEnd()) {
+				emit sourceFinished();
+				std::unique_lock<std::mutex> lock(_mutex);
+				_consumerCondition.wait(lock, [this]() {
+					return _stopRequested || _openDeviceRequested;
+				});
+				continue;
+			}
 			m_metrics.setCameraError(true);
 			continue;
 		}
+		auto readEndTime = MetricsClock::now();
+		if (nullptr == fileSource) {
+			position = std::chrono::duration_cast<MetricsClock::duration>(
+				std::chrono::duration<double, std::milli>(capturer.get(positionMsecProperty))
+			);
+		}
 		m_metrics.setCameraError(false);
+		allocations.endStage(FrameStage::read);
 
-		if ((cameraFrame.width() != readMat.cols) || (cameraFrame.height() != readMat.rows)) {
-			cameraFrame = QImage(readMat.cols, readMat.rows, QImage::Format_ARGB32);
+		if (_recording) {
+			std::lock_guard<std::mutex> lock(_recorderMutex);
+			if (nullptr != _recorder) {
+				_recorder->writeFrame(readMat, readEndTime - _recordingStartTime);
+			}
+		}
+
+		if (!hasFrameConsumers()) {
+			m_metrics.setLowPowerMode(true);
+			std::unique_lock<std::mutex> lock(_mutex);
+			_consumerCondition.wait_for(lock, keepAliveFrameInterval, [this]() {
+				return _stopRequested || _openDeviceRequested || hasFrameConsumers();
+			});
+			continue;
 		}
-		cv::Mat cameraFrameMat(
-			cameraFrame.height(),
-			cameraFrame.width(),
-			CV_8UC4,
-			cameraFrame.bits(),
-			cameraFrame.bytesPerLine()
+		m_metrics.setLowPowerMode(false);
+
+		scheduler.setTargetFps(_targetFps);
+		scheduler.setBenchmarkMode(_benchmarkMode);
+		MetricsClock::time_point dueTime;
+		auto decision = scheduler.schedule(
+			readEndTime,
+			readEndTime - readBeginTime,
+			position,
+			dueTime
 		);
-		cv::cvtColor(readMat, cameraFrameMat, cv::COLOR_BGR2BGRA);
+		if (FrameScheduler::Decision::dropOverCap == decision) {
+			m_metrics.onFrameOverCap();
+			continue;
+		}
+		if (FrameScheduler::Decision::dropLate == decision) {
+			m_metrics.onFrameLate();
+			continue;
+		}
+		if (FrameScheduler::Decision::wait == decision) {
+			std::unique_lock<std::mutex> lock(_mutex);
+			bool interrupted = _consumerCondition.wait_until(lock, dueTime, [this]() {
+				return _stopRequested || _openDeviceRequested;
+			});
+			if (interrupted) {
+				continue;
+			}
+		}
+
+		QSize requestedSize;
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			requestedSize = QSize(_processingWidth, _processingHeight);
+		}
+		const cv::Mat* frameMat = &readMat;
+		QSize processingSize = processingSizeFor(QSize(readMat.cols, readMat.rows), requestedSize);
+		if ((processingSize.width() != readMat.cols) || (processingSize.height() != readMat.rows)) {
+			// Area averaging for strong downscales, bilinear is sharp enough otherwise.
+			bool strongDownscale = (readMat.cols >= 2 * processingSize.width());
+			ExternalAllocationScope externalAllocations;
+			cv::resize(
+				readMat,
+				scaledMat,
+				cv::Size(processingSize.width(), processingSize.height()),
+				0,
+				0,
+				strongDownscale ? cv::INTER_AREA : cv::INTER_LINEAR
+			);
+			frameMat = &scaledMat;
+		}
+
+		// Without effects the filter is not called and the frame goes to the view
+		// as opaque RGB32, which is also the cheapest format to paint.
+		const bool bypass = !m_videoFilter.hasEnabledEffects();
+		const QImage::Format frameFormat = bypass ? QImage::Format_RGB32 : QImage::Format_ARGB32;
+		const QSize frameSize(frameMat->cols, frameMat->rows);
+		if (frameSize != cameraFrameSize) {
+			cameraFrameSize = frameSize;
+			m_videoFilter.setFrameSize(frameSize);
+		}
+		// Dropped first, the pool hands out its buffer again if nobody else holds it.
+		cameraFrame = QImage();
+		cameraFrame = cameraFramePool.acquire(frameSize, frameFormat);
+		uchar* cameraPixels = ImagePool::pixels(cameraFrame);
+
+		auto convertBeginTime = MetricsClock::now();
+		if (CV_8UC3 == frameMat->type()) {
+			convertBGRToBGRA(
+				frameMat->data,
+				static_cast<int>(frameMat->step),
+				cameraPixels,
+				cameraFrame.bytesPerLine(),
+				cameraFrame.width(),
+				cameraFrame.height()
+			);
+		}
+		else if (CV_8UC4 == frameMat->type()) {
+			convertBGRXToBGRA(
+				frameMat->data,
+				static_cast<int>(frameMat->step),
+				cameraPixels,
+				cameraFrame.bytesPerLine(),
+				cameraFrame.width(),
+				cameraFrame.height()
+			);
+		}
+		else {
+			cv::Mat cameraFrameMat(
+				cameraFrame.height(),
+				cameraFrame.width(),
+				CV_8UC4,
+				cameraPixels,
+				cameraFrame.bytesPerLine()
+			);
+			ExternalAllocationScope externalAllocations;
+			cv::cvtColor(
+				*frameMat,
+				cameraFrameMat,
+				(CV_8UC1 == frameMat->type()) ? cv::COLOR_GRAY2BGRA : cv::COLOR_BGR2BGRA
+			);
+		}
+
+		allocations.endStage(FrameStage::prepare);
+
+		if (bypass) {
+			auto convertEndTime = MetricsClock::now();
+			FrameTimeInfo frameTimeInfo;
+			frameTimeInfo.duration = (convertEndTime - convertBeginTime);
+			frameTimeInfo.timestamp = convertEndTime;
+			frameTimeInfo.size = cameraFrame.size();
+			m_metrics.onFrameBypassed(frameTimeInfo);
+			staticScene.reset();
+			allocations.endStage(FrameStage::filter);
+
+			deliverFrame(cameraFrame, readEndTime);
+			allocations.endStage(FrameStage::deliver);
+			_allocationReport.addFrame(allocations, readEndTime);
+			allocations.reset();
+			continue;
+		}
+
+		// Read before processing, a change made meanwhile must not be taken
+		// for the settings of this output.
+		const uint64_t settingsGeneration = m_videoFilter.settingsGeneration();
+		staticScene.setThreshold(_staticSceneThreshold);
+		auto detectBeginTime = MetricsClock::now();
+		const bool staticFrame = staticScene.isStatic(cameraFrame, readEndTime) &&
+			!lastOutput.isNull() &&
+			(lastOutputGeneration == settingsGeneration) &&
+			!m_videoFilter.isBackgroundAnimated();
+		allocations.endStage(FrameStage::staticScene);
+		if (staticFrame) {
+			auto detectEndTime = MetricsClock::now();
+			FrameTimeInfo frameTimeInfo;
+			frameTimeInfo.duration = (detectEndTime - detectBeginTime);
+			frameTimeInfo.timestamp = detectEndTime;
+			frameTimeInfo.size = lastOutput.size();
+			m_metrics.onFrameStatic(frameTimeInfo);
+
+			// The matte of the last output is composited with the current frame.
+			deliverFrame(lastOutput, readEndTime);
+			deliverMatte(cameraFrame, readEndTime);
+			allocations.endStage(FrameStage::deliver);
+			_allocationReport.addFrame(allocations, readEndTime);
+			allocations.reset();
+			continue;
+		}
+
 		auto replaceBeginTime = MetricsClock::now();
 		QImage result = m_videoFilter.replaceBG(cameraFrame);
 		auto replaceEndTime = MetricsClock::now();
+		lastOutput = result;
+		lastOutputGeneration = settingsGeneration;
+		if (!result.isNull()) {
+			staticScene.acceptFrame(readEndTime);
+		}
 
 		FrameTimeInfo frameTimeInfo;
 		frameTimeInfo.duration = (replaceEndTime - replaceBeginTime);
 		frameTimeInfo.timestamp = replaceEndTime;
 		frameTimeInfo.size = !result.isNull() ? result.size() : cameraFrame.size();
 		m_metrics.onFrameProcessed(frameTimeInfo);
+		allocations.endStage(FrameStage::filter);
 
-		if (!result.isNull()) {
-			emit frameAvailable(result);
-		}
-		else {
-			emit frameAvailable(cameraFrame);
-		}
+		deliverFrame(!result.isNull() ? result : cameraFrame, readEndTime);
+		deliverMatte(cameraFrame, readEndTime);
+		allocations.endStage(FrameStage::deliver);
+		_allocationReport.addFrame(allocations, readEndTime);
+		allocations.reset();
 	}
 
 	capturer.release();
+	fileSource.reset();
+}
+
+void Pipeline::deliverFrame(const QImage& frame, MetricsClock::time_point timestamp)
+{
+	if (_sinkCount > 0) {
+		std::lock_guard<std::mutex> lock(_sinkMutex);
+		for (auto& sink : _sinks) {
+			sink->consume(frame, timestamp);
+		}
+	}
+	if (_viewVisible) {
+		QImage displayFrame = scaleForDisplay(frame);
+		// Qt allocates the event of the queued connection.
+		ExternalAllocationScope externalAllocations;
+		emit frameAvailable(displayFrame);
+	}
+}
+
+void Pipeline::deliverMatte(const QImage& cameraFrame, MetricsClock::time_point timestamp)
+{
+	if ((0 == _matteSinkCount) && !_compositing) {
+		return;
+	}
+
+	QImage matte = m_videoFilter.matte();
+	if (matte.isNull()) {
+		return;
+	}
+	std::lock_guard<std::mutex> lock(_sinkMutex);
+	for (auto& sink : _matteSinks) {
+		sink->consume(matte, timestamp);
+	}
+	if (nullptr != _matteCompositor) {
+		_matteCompositor->composite(cameraFrame, matte, timestamp);
+	}
+}
+
+QImage Pipeline::scaleForDisplay(const QImage& frame)
+{
+	uint64_t displaySize = _displaySize;
+	QSize dstSize = frame.size().scaled(
+		QSize(static_cast<int>(displaySize >> 32), static_cast<int>(displaySize & 0xFFFFFFFF)),
+		Qt::KeepAspectRatio
+	);
+	if (dstSize.isEmpty()) {
+		return frame;
+	}
+
+	auto scaleBeginTime = MetricsClock::now();
+	QImage scaled = scaleImageForDisplay(frame, dstSize, &_displayImagePool);
+	auto scaleEndTime = MetricsClock::now();
+	FrameTimeInfo scaleTimeInfo;
+	scaleTimeInfo.duration = (scaleEndTime - scaleBeginTime);
+	scaleTimeInfo.timestamp = scaleEndTime;
+	scaleTimeInfo.size = scaled.size();
+	m_metrics.onFrameScaledForDisplay(scaleTimeInfo);
+
+	return scaled;
 }
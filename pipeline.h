@@ -1,6 +1,9 @@
 #ifndef PIPELINE_H
 #define PIPELINE_H
 
+#include "allocation_tracker.h"
+#include "frame_sink.h"
+#include "image_pool.h"
 #include "video_filter.h"
 #include "metrics.h"
 
@@ -8,7 +11,14 @@
 #include <QImage>
 
 #include <atomic>
+#include <condition_variable>
+#include <memory>
 #include <thread>
+#include <vector>
+
+class FrameSource;
+class MatteCompositor;
+class RawRecorder;
 
 class Pipeline : public QObject 
 {
@@ -19,20 +29,79 @@ public:
 
 	void setDeviceIndex(int index);
 	void setMediaPath(const std::string& path);
+	// Reads from the source instead of the device or media path until the
+	// next reopen. sourceFinished() is emitted once the source is at its end.
+	void setFrameSource(std::unique_ptr<FrameSource> source);
 
+	// Capture size, changing it reopens the device.
 	void getFrameSize(int& width, int& height);
 	void trySetFrameSize(int width, int height);
 
+	// Frames are scaled down to fit the processing size before the video
+	// filter, the change applies from the next frame. Only a size above the
+	// capture size raises the capture size.
+	void getProcessingSize(int& width, int& height);
+	void setProcessingSize(int width, int height);
+
+	// Frames are scaled to fit the size before frameAvailable, thread safe.
+	void setDisplaySize(const QSize& size);
+	// Without a visible view the SDK is not called and frames are read at a
+	// keep-alive rate, full rate resumes with the next frame.
+	void setViewVisible(bool visible);
+
+	// Frames above the rate are dropped, zero disables the cap.
+	void setTargetFps(double fps);
+	// Processes every frame as fast as possible, files are not paced.
+	void setBenchmarkMode(bool benchmarkMode);
+	// Frames which barely differ from the last processed one get its output
+	// instead of going through the SDK, at most for half a second. The
+	// threshold is the mean luma difference of the most changed 8x8 tile of
+	// a downscaled frame, zero disables it. See static_scene.h.
+	void setStaticSceneThreshold(double threshold);
+
+	// Writes every captured frame unchanged to a raw recording, which can be
+	// replayed with setMediaPath(). The frames are written on a thread of the
+	// recorder, the ones it has no room for are dropped and counted in the
+	// metrics. See raw_recording.h.
+	bool startRecording(const QString& filePath);
+	// Returns at once, recordingFinished() tells whether the recording was
+	// written. Called from the thread of the pipeline object.
+	void stopRecording();
+
+	// Sinks get every processed frame on the pipeline thread, and keep the
+	// pipeline at full rate while the view is hidden.
+	void addSink(const std::shared_ptr<FrameSink>& sink);
+	void removeSink(const std::shared_ptr<FrameSink>& sink);
+	// Matte sinks get the Grayscale8 matte of every processed frame while the
+	// matte export of the video filter is enabled.
+	void addMatteSink(const std::shared_ptr<FrameSink>& sink);
+	void removeMatteSink(const std::shared_ptr<FrameSink>& sink);
+	// Composites every processed frame with its matte over the backgrounds of
+	// the compositor, null removes it. Needs the matte export as well.
+	void setMatteCompositor(const std::shared_ptr<MatteCompositor>& compositor);
+
 	void start();
 
 	VideoFilter* videoFilter();
 	Metrics* metrics();
+	// Allocations per frame of the stages of the pipeline thread, empty
+	// unless built with ENABLE_ALLOCATION_TRACKING.
+	AllocationReport* allocationReport();
 
 signals:
 	void frameAvailable(const QImage& frame);
+	void sourceFinished();
+	void recordingFinished(bool written);
 
 private:
 	void runLoop();
+	// Returns RGB32 or ARGB32_Premultiplied, ready to be drawn without conversions.
+	QImage scaleForDisplay(const QImage& frame);
+	// Hands the frame to the sinks and to the view if it is visible.
+	void deliverFrame(const QImage& frame, MetricsClock::time_point timestamp);
+	// Hands the matte of the processed frame to the matte sinks and the compositor.
+	void deliverMatte(const QImage& cameraFrame, MetricsClock::time_point timestamp);
+	bool hasFrameConsumers() const;
 
 private:
 	bool _started = false;
@@ -41,11 +110,40 @@ private:
 	std::mutex _mutex;
 	int _deviceIndex;
 	std::string _mediaPath;
+	std::unique_ptr<FrameSource> _pendingSource;
 	int _frameWidth;
 	int _frameHeight;
+	int _processingWidth;
+	int _processingHeight;
+	// Width in the high half, height in the low one.
+	std::atomic<uint64_t> _displaySize;
+	std::atomic<bool> _viewVisible;
+	std::atomic<double> _targetFps;
+	std::atomic<bool> _benchmarkMode;
+	std::atomic<double> _staticSceneThreshold;
 
-	VideoFilter m_videoFilter;
+	std::mutex _recorderMutex;
+	std::unique_ptr<RawRecorder> _recorder;
+	// Stopped recorders still writing, on the thread of the pipeline object.
+	std::vector<std::unique_ptr<RawRecorder>> _finishingRecorders;
+	MetricsClock::time_point _recordingStartTime;
+	std::atomic<bool> _recording;
+
+	std::mutex _sinkMutex;
+	std::vector<std::shared_ptr<FrameSink>> _sinks;
+	std::atomic<int> _sinkCount;
+	std::vector<std::shared_ptr<FrameSink>> _matteSinks;
+	std::atomic<int> _matteSinkCount;
+	std::shared_ptr<MatteCompositor> _matteCompositor;
+	std::atomic<bool> _compositing;
+	std::condition_variable _consumerCondition;
+
+	// Declared first, the video filter reports to the metrics until destroyed.
 	Metrics m_metrics;
+	VideoFilter m_videoFilter;
+	AllocationReport _allocationReport;
+	// Used by scaleForDisplay() on the pipeline thread.
+	ImagePool _displayImagePool;
 
 	std::atomic<bool> _stopRequested;
 	std::thread _loopThread;
@@ -0,0 +1,586 @@
+#include "pixel_convert.h"
+
+#include "pixel_convert_kernels.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define PIXEL_CONVERT_X86
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+namespace {
+
+inline uint8_t clampByte(int value)
+{
+	return static_cast<uint8_t>(std::min(std::max(value, 0), 255));
+}
+
+inline uint8_t average(uint8_t a, uint8_t b)
+{
+	return static_cast<uint8_t>((a + b + 1) >> 1);
+}
+
+// BT.601 limited range with 6 fractional bits.
+inline void storeYuvAsBgra(uint8_t* dst, int y, int u, int v)
+{
+	int luma = ((y * 149) >> 1) - 1192;
+	u -= 128;
+	v -= 128;
+	dst[0] = clampByte((luma + 129 * u + 32) >> 6);
+	dst[1] = clampByte((luma - 25 * u - 52 * v + 32) >> 6);
+	dst[2] = clampByte((luma + 102 * v + 32) >> 6);
+	dst[3] = 255;
+}
+
+// The coefficients have 7 fractional bits to fit signed bytes in SIMD.
+inline uint8_t bgraToY(const uint8_t* pixel)
+{
+	return static_cast<uint8_t>(((13 * pixel[0] + 64 * pixel[1] + 33 * pixel[2] + 64) >> 7) + 16);
+}
+
+inline uint8_t bgraToU(const uint8_t* pixel)
+{
+	return static_cast<uint8_t>(((56 * pixel[0] - 37 * pixel[1] - 19 * pixel[2] + 64) >> 7) + 128);
+}
+
+inline uint8_t bgraToV(const uint8_t* pixel)
+{
+	return static_cast<uint8_t>(((-9 * pixel[0] - 47 * pixel[1] + 56 * pixel[2] + 64) >> 7) + 128);
+}
+
+// Averages the 2x2 block at x, rows first, the same order as the SIMD kernels.
+inline void averageBlock(const uint8_t* src0, const uint8_t* src1, int x, int width, uint8_t* block)
+{
+	int next = std::min(x + 1, width - 1);
+	for (int c = 0; c < 4; ++c) {
+		block[c] = average(
+			average(src0[4 * x + c], src1[4 * x + c]),
+			average(src0[4 * next + c], src1[4 * next + c])
+		);
+	}
+}
+
+} // namespace
+
+void bgrToBgraRowScalar(const uint8_t* src, uint8_t* dst, int width)
+{
+	for (int x = 0; x < width; ++x) {
+		dst[4 * x + 0] = src[3 * x + 0];
+		dst[4 * x + 1] = src[3 * x + 1];
+		dst[4 * x + 2] = src[3 * x + 2];
+		dst[4 * x + 3] = 255;
+	}
+}
+
+void rgbxToBgraRowScalar(const uint8_t* src, uint8_t* dst, int width)
+{
+	for (int x = 0; x < width; ++x) {
+		uint8_t red = src[4 * x + 0];
+		dst[4 * x + 0] = src[4 * x + 2];
+		dst[4 * x + 1] = src[4 * x + 1];
+		dst[4 * x + 2] = red;
+		dst[4 * x + 3] = 255;
+	}
+}
+
+void bgrxToBgraRowScalar(const uint8_t* src, uint8_t* dst, int width)
+{
+	for (int x = 0; x < width; ++x) {
+		dst[4 * x + 0] = src[4 * x + 0];
+		dst[4 * x + 1] = src[4 * x + 1];
+		dst[4 * x + 2] = src[4 * x + 2];
+		dst[4 * x + 3] = 255;
+	}
+}
+
+void yuyvToBgraRowScalar(const uint8_t* src, uint8_t* dst, int width)
+{
+	for (int x = 0; x < width; ++x) {
+		const uint8_t* pair = src + 4 * (x / 2);
+		storeYuvAsBgra(dst + 4 * x, src[2 * x], pair[1], pair[3]);
+	}
+}
+
+void nv12ToBgraRowScalar(const uint8_t* srcY, const uint8_t* srcUV, uint8_t* dst, int width)
+{
+	for (int x = 0; x < width; ++x) {
+		const uint8_t* chroma = srcUV + 2 * (x / 2);
+		storeYuvAsBgra(dst + 4 * x, srcY[x], chroma[0], chroma[1]);
+	}
+}
+
+void yuyvToNv12RowScalar(
+	const uint8_t* src0, const uint8_t* src1,
+	uint8_t* dstY0, uint8_t* dstY1, uint8_t* dstUV,
+	int width
+)
+{
+	for (int x = 0; x < width; ++x) {
+		dstY0[x] = src0[2 * x];
+		dstY1[x] = src1[2 * x];
+		dstUV[x] = average(src0[2 * x + 1], src1[2 * x + 1]);
+	}
+}
+
+void bgraToYRowScalar(const uint8_t* src, uint8_t* dstY, int width)
+{
+	for (int x = 0; x < width; ++x) {
+		dstY[x] = bgraToY(src + 4 * x);
+	}
+}
+
+void bgraToUVRowScalar(const uint8_t* src0, const uint8_t* src1, uint8_t* dstUV, int width)
+{
+	uint8_t block[4];
+	for (int x = 0; x < width; x += 2) {
+		averageBlock(src0, src1, x, width, block);
+		dstUV[x] = bgraToU(block);
+		dstUV[x + 1] = bgraToV(block);
+	}
+}
+
+void bgraToUVPlanarRowScalar(
+	const uint8_t* src0, const uint8_t* src1,
+	uint8_t* dstU, uint8_t* dstV,
+	int width
+)
+{
+	uint8_t block[4];
+	for (int x = 0; x < width; x += 2) {
+		averageBlock(src0, src1, x, width, block);
+		dstU[x / 2] = bgraToU(block);
+		dstV[x / 2] = bgraToV(block);
+	}
+}
+
+void bgraToAlphaRowScalar(const uint8_t* src, uint8_t* dstA, int width)
+{
+	for (int x = 0; x < width; ++x) {
+		dstA[x] = src[4 * x + 3];
+	}
+}
+
+void premultiplyRowScalar(const uint8_t* src, const uint8_t* alpha, uint16_t* dst, int width)
+{
+	for (int x = 0; x < width; ++x) {
+		dst[4 * x + 0] = static_cast<uint16_t>(src[4 * x + 0] * alpha[x] + 128);
+		dst[4 * x + 1] = static_cast<uint16_t>(src[4 * x + 1] * alpha[x] + 128);
+		dst[4 * x + 2] = static_cast<uint16_t>(src[4 * x + 2] * alpha[x] + 128);
+		dst[4 * x + 3] = static_cast<uint16_t>(255 - alpha[x]);
+	}
+}
+
+void blendPremultipliedRowScalar(const uint16_t* src, const uint8_t* background, uint8_t* dst, int width)
+{
+	for (int x = 0; x < width; ++x) {
+		int inverseAlpha = src[4 * x + 3];
+		for (int c = 0; c < 3; ++c) {
+			int sum = src[4 * x + c] + background[4 * x + c] * inverseAlpha;
+			dst[4 * x + c] = static_cast<uint8_t>((sum + (sum >> 8)) >> 8);
+		}
+		dst[4 * x + 3] = 255;
+	}
+}
+
+void sumAbsDiff8RowScalar(const uint8_t* a, const uint8_t* b, uint32_t* sums, int width)
+{
+	for (int x = 0; x < width; ++x) {
+		sums[x / 8] += static_cast<uint32_t>(std::abs(a[x] - b[x]));
+	}
+}
+
+const PixelRowKernels* scalarPixelRowKernels()
+{
+	static const PixelRowKernels kernels = {
+		&bgrToBgraRowScalar,
+		&rgbxToBgraRowScalar,
+		&bgrxToBgraRowScalar,
+		&yuyvToBgraRowScalar,
+		&nv12ToBgraRowScalar,
+		&yuyvToNv12RowScalar,
+		&bgraToYRowScalar,
+		&bgraToUVRowScalar,
+		&bgraToUVPlanarRowScalar,
+		&bgraToAlphaRowScalar,
+		&premultiplyRowScalar,
+		&blendPremultipliedRowScalar,
+		&sumAbsDiff8RowScalar
+	};
+	return &kernels;
+}
+
+namespace {
+
+#if defined(PIXEL_CONVERT_X86)
+
+struct CpuFeatures
+{
+	bool sse41 = false;
+	bool avx2 = false;
+	bool avx512 = false;
+};
+
+void cpuid(unsigned leaf, unsigned subleaf, unsigned registers[4])
+{
+#if defined(_MSC_VER)
+	int values[4];
+	__cpuidex(values, static_cast<int>(leaf), static_cast<int>(subleaf));
+	for (int i = 0; i < 4; ++i) {
+		registers[i] = static_cast<unsigned>(values[i]);
+	}
+#else
+	__cpuid_count(leaf, subleaf, registers[0], registers[1], registers[2], registers[3]);
+#endif
+}
+
+uint64_t enabledXSaveFeatures()
+{
+#if defined(_MSC_VER)
+	return _xgetbv(0);
+#else
+	uint32_t eax = 0;
+	uint32_t edx = 0;
+	__asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+	return (uint64_t(edx) << 32) | eax;
+#endif
+}
+
+CpuFeatures detectCpuFeatures()
+{
+	CpuFeatures features;
+	unsigned registers[4] = {};
+	cpuid(0, 0, registers);
+	const unsigned maxLeaf = registers[0];
+	if (maxLeaf < 1) {
+		return features;
+	}
+
+	cpuid(1, 0, registers);
+	const unsigned ecx1 = registers[2];
+	features.sse41 = (0 != (ecx1 & (1u << 9))) && (0 != (ecx1 & (1u << 19)));
+
+	// The OS must save the YMM and ZMM registers on context switches.
+	bool osxsave = (0 != (ecx1 & (1u << 27))) && (0 != (ecx1 & (1u << 28)));
+	if (!osxsave || (maxLeaf < 7)) {
+		return features;
+	}
+	uint64_t xsave = enabledXSaveFeatures();
+	bool ymmEnabled = (0x06 == (xsave & 0x06));
+	bool zmmEnabled = (0xE6 == (xsave & 0xE6));
+
+	cpuid(7, 0, registers);
+	const unsigned ebx7 = registers[1];
+	features.avx2 = ymmEnabled && (0 != (ebx7 & (1u << 5)));
+	features.avx512 = features.avx2 && zmmEnabled &&
+		(0 != (ebx7 & (1u << 16))) &&
+		(0 != (ebx7 & (1u << 30)));
+	return features;
+}
+
+const CpuFeatures& cpuFeatures()
+{
+	static const CpuFeatures features = detectCpuFeatures();
+	return features;
+}
+
+#endif
+
+const PixelRowKernels* kernelsFor(PixelConvertIsa isa)
+{
+	switch (isa) {
+	case PixelConvertIsa::scalar:
+		return scalarPixelRowKernels();
+#if defined(PIXEL_CONVERT_X86)
+	case PixelConvertIsa::sse41:
+		return cpuFeatures().sse41 ? sse41PixelRowKernels() : nullptr;
+	case PixelConvertIsa::avx2:
+		return cpuFeatures().avx2 ? avx2PixelRowKernels() : nullptr;
+	case PixelConvertIsa::avx512:
+		return cpuFeatures().avx512 ? avx512PixelRowKernels() : nullptr;
+#else
+	case PixelConvertIsa::neon:
+		return neonPixelRowKernels();
+#endif
+	default:
+		return nullptr;
+	}
+}
+
+PixelConvertIsa detectIsa()
+{
+	const PixelConvertIsa preferred[] = {
+		PixelConvertIsa::avx512,
+		PixelConvertIsa::avx2,
+		PixelConvertIsa::sse41,
+		PixelConvertIsa::neon
+	};
+	for (PixelConvertIsa isa : preferred) {
+		if (nullptr != kernelsFor(isa)) {
+			return isa;
+		}
+	}
+	return PixelConvertIsa::scalar;
+}
+
+std::atomic<int> activeIsa(-1);
+
+PixelConvertIsa currentIsa()
+{
+	int isa = activeIsa.load(std::memory_order_acquire);
+	if (isa < 0) {
+		isa = static_cast<int>(detectIsa());
+		activeIsa.store(isa, std::memory_order_release);
+	}
+	return static_cast<PixelConvertIsa>(isa);
+}
+
+const PixelRowKernels& kernels()
+{
+	return *kernelsFor(currentIsa());
+}
+
+} // namespace
+
+PixelConvertIsa pixelConvertIsa()
+{
+	return currentIsa();
+}
+
+bool setPixelConvertIsa(PixelConvertIsa isa)
+{
+	if (nullptr == kernelsFor(isa)) {
+		return false;
+	}
+	activeIsa.store(static_cast<int>(isa), std::memory_order_release);
+	return true;
+}
+
+const char* pixelConvertIsaName(PixelConvertIsa isa)
+{
+	switch (isa) {
+	case PixelConvertIsa::scalar:
+		return "scalar";
+	case PixelConvertIsa::sse41:
+		return "SSE4.1";
+	case PixelConvertIsa::avx2:
+		return "AVX2";
+	case PixelConvertIsa::avx512:
+		return "AVX-512";
+	case PixelConvertIsa::neon:
+		return "NEON";
+	}
+	return "";
+}
+
+void convertBGRToBGRA(
+	const uint8_t* src, int srcBytesPerLine,
+	uint8_t* dst, int dstBytesPerLine,
+	int width, int height
+)
+{
+	auto row = kernels().bgrToBgra;
+	for (int y = 0; y < height; ++y) {
+		row(src + y * srcBytesPerLine, dst + y * dstBytesPerLine, width);
+	}
+}
+
+void convertRGBXToBGRA(
+	const uint8_t* src, int srcBytesPerLine,
+	uint8_t* dst, int dstBytesPerLine,
+	int width, int height
+)
+{
+	auto row = kernels().rgbxToBgra;
+	for (int y = 0; y < height; ++y) {
+		row(src + y * srcBytesPerLine, dst + y * dstBytesPerLine, width);
+	}
+}
+
+void convertBGRXToBGRA(
+	const uint8_t* src, int srcBytesPerLine,
+	uint8_t* dst, int dstBytesPerLine,
+	int width, int height
+)
+{
+	auto row = kernels().bgrxToBgra;
+	for (int y = 0; y < height; ++y) {
+		row(src + y * srcBytesPerLine, dst + y * dstBytesPerLine, width);
+	}
+}
+
+void convertYUYVToBGRA(
+	const uint8_t* src, int srcBytesPerLine,
+	uint8_t* dst, int dstBytesPerLine,
+	int width, int height
+)
+{
+	auto row = kernels().yuyvToBgra;
+	for (int y = 0; y < height; ++y) {
+		row(src + y * srcBytesPerLine, dst + y * dstBytesPerLine, width);
+	}
+}
+
+void convertYUYVToNV12(
+	const uint8_t* src, int srcBytesPerLine,
+	uint8_t* dstY, int dstYBytesPerLine,
+	uint8_t* dstUV, int dstUVBytesPerLine,
+	int width, int height
+)
+{
+	auto row = kernels().yuyvToNv12;
+	for (int y = 0; y < height; y += 2) {
+		int next = std::min(y + 1, height - 1);
+		row(
+			src + y * srcBytesPerLine,
+			src + next * srcBytesPerLine,
+			dstY + y * dstYBytesPerLine,
+			dstY + next * dstYBytesPerLine,
+			dstUV + (y / 2) * dstUVBytesPerLine,
+			width
+		);
+	}
+}
+
+void convertNV12ToBGRA(
+	const uint8_t* srcY, int srcYBytesPerLine,
+	const uint8_t* srcUV, int srcUVBytesPerLine,
+	uint8_t* dst, int dstBytesPerLine,
+	int width, int height
+)
+{
+	auto row = kernels().nv12ToBgra;
+	for (int y = 0; y < height; ++y) {
+		row(
+			srcY + y * srcYBytesPerLine,
+			srcUV + (y / 2) * srcUVBytesPerLine,
+			dst + y * dstBytesPerLine,
+			width
+		);
+	}
+}
+
+void convertBGRAToNV12(
+	const uint8_t* src, int srcBytesPerLine,
+	uint8_t* dstY, int dstYBytesPerLine,
+	uint8_t* dstUV, int dstUVBytesPerLine,
+	int width, int height
+)
+{
+	const PixelRowKernels& rows = kernels();
+	for (int y = 0; y < height; ++y) {
+		rows.bgraToY(src + y * srcBytesPerLine, dstY + y * dstYBytesPerLine, width);
+	}
+	for (int y = 0; y < height; y += 2) {
+		int next = std::min(y + 1, height - 1);
+		rows.bgraToUV(
+			src + y * srcBytesPerLine,
+			src + next * srcBytesPerLine,
+			dstUV + (y / 2) * dstUVBytesPerLine,
+			width
+		);
+	}
+}
+
+void convertBGRAToI420(
+	const uint8_t* src, int srcBytesPerLine,
+	uint8_t* dstY, int dstYBytesPerLine,
+	uint8_t* dstU, int dstUBytesPerLine,
+	uint8_t* dstV, int dstVBytesPerLine,
+	int width, int height
+)
+{
+	const PixelRowKernels& rows = kernels();
+	for (int y = 0; y < height; ++y) {
+		rows.bgraToY(src + y * srcBytesPerLine, dstY + y * dstYBytesPerLine, width);
+	}
+	for (int y = 0; y < height; y += 2) {
+		int next = std::min(y + 1, height - 1);
+		rows.bgraToUVPlanar(
+			src + y * srcBytesPerLine,
+			src + next * srcBytesPerLine,
+			dstU + (y / 2) * dstUBytesPerLine,
+			dstV + (y / 2) * dstVBytesPerLine,
+			width
+		);
+	}
+}
+
+void extractBGRAAlpha(
+	const uint8_t* src, int srcBytesPerLine,
+	uint8_t* dstA, int dstABytesPerLine,
+	int width, int height
+)
+{
+	auto row = kernels().bgraToAlpha;
+	for (int y = 0; y < height; ++y) {
+		row(src + y * srcBytesPerLine, dstA + y * dstABytesPerLine, width);
+	}
+}
+
+void premultiplyBGRA(
+	const uint8_t* src, int srcBytesPerLine,
+	const uint8_t* alpha, int alphaBytesPerLine,
+	uint16_t* dst, int dstWordsPerLine,
+	int width, int height
+)
+{
+	auto row = kernels().premultiply;
+	for (int y = 0; y < height; ++y) {
+		row(src + y * srcBytesPerLine, alpha + y * alphaBytesPerLine, dst + y * dstWordsPerLine, width);
+	}
+}
+
+void blendPremultipliedBGRA(
+	const uint16_t* src, int srcWordsPerLine,
+	const uint8_t* background, int backgroundBytesPerLine,
+	uint8_t* dst, int dstBytesPerLine,
+	int width, int height
+)
+{
+	auto row = kernels().blendPremultiplied;
+	for (int y = 0; y < height; ++y) {
+		row(
+			src + y * srcWordsPerLine,
+			background + y * backgroundBytesPerLine,
+			dst + y * dstBytesPerLine,
+			width
+		);
+	}
+}
+
+void convertBGRAToY(
+	const uint8_t* src, int srcBytesPerLine,
+	uint8_t* dstY, int dstYBytesPerLine,
+	int width, int height
+)
+{
+	auto row = kernels().bgraToY;
+	for (int y = 0; y < height; ++y) {
+		row(src + y * srcBytesPerLine, dstY + y * dstYBytesPerLine, width);
+	}
+}
+
+void sumAbsDifference8x8(
+	const uint8_t* a, int aBytesPerLine,
+	const uint8_t* b, int bBytesPerLine,
+	uint32_t* tileSums,
+	int width, int height
+)
+{
+	auto row = kernels().sumAbsDiff8;
+	int tilesPerRow = (width + 7) / 8;
+	for (int y = 0; y < height; ++y) {
+		uint32_t* sums = tileSums + (y / 8) * tilesPerRow;
+		if (0 == y % 8) {
+			std::fill(sums, sums + tilesPerRow, 0u);
+		}
+		row(a + y * aBytesPerLine, b + y * bBytesPerLine, sums, width);
+	}
+}
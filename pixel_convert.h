@@ -0,0 +1,129 @@
+#ifndef PIXEL_CONVERT_H
+#define PIXEL_CONVERT_H
+
+#include <cstdint>
+
+// Pixel format conversions between capture devices, the SDK and Qt.
+// BGRA is the byte order of QImage::Format_ARGB32 and Format_RGB32 on little
+// endian machines. YUV formats use BT.601 limited range, the same as OpenCV.
+// The 4:2:0 formats (NV12, I420) take the chroma of each 2x2 block, odd sizes
+// are allowed, YUYV requires an even width.
+//
+// The SIMD kernels are chosen once for the CPU at the first conversion, the
+// scalar kernels are the reference the SIMD ones match bit for bit.
+
+enum class PixelConvertIsa
+{
+	scalar,
+	sse41,
+	avx2,
+	avx512,
+	neon
+};
+
+PixelConvertIsa pixelConvertIsa();
+// Forces the kernels of the instruction set, for validation and benchmarks.
+// Returns false if the build or the CPU does not support it.
+bool setPixelConvertIsa(PixelConvertIsa isa);
+const char* pixelConvertIsaName(PixelConvertIsa isa);
+
+void convertBGRToBGRA(
+	const uint8_t* src, int srcBytesPerLine,
+	uint8_t* dst, int dstBytesPerLine,
+	int width, int height
+);
+
+void convertRGBXToBGRA(
+	const uint8_t* src, int srcBytesPerLine,
+	uint8_t* dst, int dstBytesPerLine,
+	int width, int height
+);
+
+// Sets the alpha of RGB32 pixels, src and dst may be the same.
+void convertBGRXToBGRA(
+	const uint8_t* src, int srcBytesPerLine,
+	uint8_t* dst, int dstBytesPerLine,
+	int width, int height
+);
+
+void convertYUYVToBGRA(
+	const uint8_t* src, int srcBytesPerLine,
+	uint8_t* dst, int dstBytesPerLine,
+	int width, int height
+);
+
+void convertYUYVToNV12(
+	const uint8_t* src, int srcBytesPerLine,
+	uint8_t* dstY, int dstYBytesPerLine,
+	uint8_t* dstUV, int dstUVBytesPerLine,
+	int width, int height
+);
+
+void convertNV12ToBGRA(
+	const uint8_t* srcY, int srcYBytesPerLine,
+	const uint8_t* srcUV, int srcUVBytesPerLine,
+	uint8_t* dst, int dstBytesPerLine,
+	int width, int height
+);
+
+void convertBGRAToNV12(
+	const uint8_t* src, int srcBytesPerLine,
+	uint8_t* dstY, int dstYBytesPerLine,
+	uint8_t* dstUV, int dstUVBytesPerLine,
+	int width, int height
+);
+
+void convertBGRAToI420(
+	const uint8_t* src, int srcBytesPerLine,
+	uint8_t* dstY, int dstYBytesPerLine,
+	uint8_t* dstU, int dstUBytesPerLine,
+	uint8_t* dstV, int dstVBytesPerLine,
+	int width, int height
+);
+
+// Copies the alpha channel of BGRA pixels to an 8-bit plane.
+void extractBGRAAlpha(
+	const uint8_t* src, int srcBytesPerLine,
+	uint8_t* dstA, int dstABytesPerLine,
+	int width, int height
+);
+
+// The luma plane of BGRA pixels, the same as the Y plane of convertBGRAToNV12().
+void convertBGRAToY(
+	const uint8_t* src, int srcBytesPerLine,
+	uint8_t* dstY, int dstYBytesPerLine,
+	int width, int height
+);
+
+// Sums the absolute differences of two 8-bit planes over tiles of 8x8 pixels,
+// tileSums receives (width + 7) / 8 by (height + 7) / 8 sums row by row.
+// Tiles at the right and bottom edges may be smaller.
+void sumAbsDifference8x8(
+	const uint8_t* a, int aBytesPerLine,
+	const uint8_t* b, int bBytesPerLine,
+	uint32_t* tileSums,
+	int width, int height
+);
+
+// Compositing of a foreground over opaque backgrounds in two steps, so the
+// foreground is premultiplied once for many backgrounds. The alpha comes
+// from an 8-bit plane, the alpha of src is ignored. The premultiplied pixel
+// is 4 words: color * alpha + 128 for blue, green and red, then 255 - alpha.
+// Blending rounds (color * alpha + background * (255 - alpha)) / 255 to the
+// nearest integer, the result is opaque.
+void premultiplyBGRA(
+	const uint8_t* src, int srcBytesPerLine,
+	const uint8_t* alpha, int alphaBytesPerLine,
+	uint16_t* dst, int dstWordsPerLine,
+	int width, int height
+);
+
+// dst may be the background.
+void blendPremultipliedBGRA(
+	const uint16_t* src, int srcWordsPerLine,
+	const uint8_t* background, int backgroundBytesPerLine,
+	uint8_t* dst, int dstBytesPerLine,
+	int width, int height
+);
+
+#endif
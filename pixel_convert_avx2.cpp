@@ -0,0 +1,123 @@
+#include "pixel_convert_kernels.h"
+
+#if defined(__AVX2__)
+
+#include "pixel_convert_simd.h"
+
+#include <immintrin.h>
+
+namespace {
+
+struct Avx2
+{
+	using Vec = __m256i;
+	static const int lanes = 2;
+
+	static Vec load(const uint8_t* src)
+	{
+		return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src));
+	}
+
+	static void store(uint8_t* dst, Vec value)
+	{
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(dst), value);
+	}
+
+	static Vec loadLanes(const uint8_t* src, int laneStride)
+	{
+		__m128i low = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+		__m128i high = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + laneStride));
+		return _mm256_inserti128_si256(_mm256_castsi128_si256(low), high, 1);
+	}
+
+	// 8 pixels take 6 dwords, the second lane starts at the fourth one.
+	static Vec loadBGRLanes(const uint8_t* src)
+	{
+		return _mm256_permutevar8x32_epi32(load(src), _mm256_setr_epi32(0, 1, 2, 3, 3, 4, 5, 6));
+	}
+
+	static Vec loadWidenU8(const uint8_t* src)
+	{
+		return _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src)));
+	}
+
+	static Vec loadWidenU8To32(const uint8_t* src)
+	{
+		return _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(src)));
+	}
+
+	static void storeLanePairs(uint8_t* dst, Vec low, Vec high)
+	{
+		store(dst, _mm256_permute2x128_si256(low, high, 0x20));
+		store(dst + 32, _mm256_permute2x128_si256(low, high, 0x31));
+	}
+
+	static void storeHalves(uint8_t* lowDst, uint8_t* highDst, Vec value)
+	{
+		Vec ordered = _mm256_permute4x64_epi64(value, _MM_SHUFFLE(3, 1, 2, 0));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(lowDst), _mm256_castsi256_si128(ordered));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(highDst), _mm256_extracti128_si256(ordered, 1));
+	}
+
+	static Vec pattern(const int8_t* bytes)
+	{
+		return _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(bytes)));
+	}
+
+	static Vec set1_16(int16_t value) { return _mm256_set1_epi16(value); }
+	static Vec set1_32(int32_t value) { return _mm256_set1_epi32(value); }
+
+	static Vec and_(Vec a, Vec b) { return _mm256_and_si256(a, b); }
+	static Vec or_(Vec a, Vec b) { return _mm256_or_si256(a, b); }
+	static Vec add16(Vec a, Vec b) { return _mm256_add_epi16(a, b); }
+	static Vec add32(Vec a, Vec b) { return _mm256_add_epi32(a, b); }
+	static Vec adds16(Vec a, Vec b) { return _mm256_adds_epi16(a, b); }
+	static Vec sub16(Vec a, Vec b) { return _mm256_sub_epi16(a, b); }
+	static Vec mullo16(Vec a, Vec b) { return _mm256_mullo_epi16(a, b); }
+	static Vec srai16(Vec a, int shift) { return _mm256_srai_epi16(a, shift); }
+	static Vec srli16(Vec a, int shift) { return _mm256_srli_epi16(a, shift); }
+	static Vec srli32(Vec a, int shift) { return _mm256_srli_epi32(a, shift); }
+	static Vec slli32(Vec a, int shift) { return _mm256_slli_epi32(a, shift); }
+	static Vec avg8(Vec a, Vec b) { return _mm256_avg_epu8(a, b); }
+	static Vec sad8(Vec a, Vec b) { return _mm256_sad_epu8(a, b); }
+	static Vec packus16(Vec a, Vec b) { return _mm256_packus_epi16(a, b); }
+	static Vec packs32(Vec a, Vec b) { return _mm256_packs_epi32(a, b); }
+	static Vec unpacklo8(Vec a, Vec b) { return _mm256_unpacklo_epi8(a, b); }
+	static Vec unpackhi8(Vec a, Vec b) { return _mm256_unpackhi_epi8(a, b); }
+	static Vec unpacklo16(Vec a, Vec b) { return _mm256_unpacklo_epi16(a, b); }
+	static Vec unpackhi16(Vec a, Vec b) { return _mm256_unpackhi_epi16(a, b); }
+	static Vec shuffle8(Vec a, Vec indices) { return _mm256_shuffle_epi8(a, indices); }
+	static Vec maddubs(Vec a, Vec b) { return _mm256_maddubs_epi16(a, b); }
+	static Vec madd16(Vec a, Vec b) { return _mm256_madd_epi16(a, b); }
+
+	static Vec evenPixels(Vec a, Vec b)
+	{
+		return _mm256_castps_si256(_mm256_shuffle_ps(
+			_mm256_castsi256_ps(a), _mm256_castsi256_ps(b), _MM_SHUFFLE(2, 0, 2, 0)
+		));
+	}
+
+	static Vec oddPixels(Vec a, Vec b)
+	{
+		return _mm256_castps_si256(_mm256_shuffle_ps(
+			_mm256_castsi256_ps(a), _mm256_castsi256_ps(b), _MM_SHUFFLE(3, 1, 3, 1)
+		));
+	}
+};
+
+} // namespace
+
+const PixelRowKernels* avx2PixelRowKernels()
+{
+	static const PixelRowKernels kernels = makePixelRowKernels<Avx2>();
+	return &kernels;
+}
+
+#else
+
+const PixelRowKernels* avx2PixelRowKernels()
+{
+	return nullptr;
+}
+
+#endif
@@ -0,0 +1,138 @@
+#include "pixel_convert_kernels.h"
+
+#if defined(__AVX512F__) && defined(__AVX512BW__)
+
+#include "pixel_convert_simd.h"
+
+// The AVX-512 intrinsics of GCC 12 pass undefined vectors to the builtins,
+// which -Wall reports as uninitialized at every use.
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+#include <immintrin.h>
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+namespace {
+
+struct Avx512
+{
+	using Vec = __m512i;
+	static const int lanes = 4;
+
+	static Vec load(const uint8_t* src)
+	{
+		return _mm512_loadu_si512(src);
+	}
+
+	static void store(uint8_t* dst, Vec value)
+	{
+		_mm512_storeu_si512(dst, value);
+	}
+
+	static Vec loadLanes(const uint8_t* src, int laneStride)
+	{
+		Vec value = _mm512_castsi128_si512(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src)));
+		value = _mm512_inserti32x4(value, _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + laneStride)), 1);
+		value = _mm512_inserti32x4(value, _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 2 * laneStride)), 2);
+		return _mm512_inserti32x4(value, _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 3 * laneStride)), 3);
+	}
+
+	// 16 pixels take 12 dwords, the lanes start at every third one.
+	static Vec loadBGRLanes(const uint8_t* src)
+	{
+		const Vec indices = _mm512_setr_epi32(0, 1, 2, 3, 3, 4, 5, 6, 6, 7, 8, 9, 9, 10, 11, 12);
+		return _mm512_permutexvar_epi32(indices, load(src));
+	}
+
+	static Vec loadWidenU8(const uint8_t* src)
+	{
+		return _mm512_cvtepu8_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(src)));
+	}
+
+	static Vec loadWidenU8To32(const uint8_t* src)
+	{
+		return _mm512_cvtepu8_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src)));
+	}
+
+	static void storeLanePairs(uint8_t* dst, Vec low, Vec high)
+	{
+		const Vec first = _mm512_setr_epi64(0, 1, 8, 9, 2, 3, 10, 11);
+		const Vec second = _mm512_setr_epi64(4, 5, 12, 13, 6, 7, 14, 15);
+		store(dst, _mm512_permutex2var_epi64(low, first, high));
+		store(dst + 64, _mm512_permutex2var_epi64(low, second, high));
+	}
+
+	static void storeHalves(uint8_t* lowDst, uint8_t* highDst, Vec value)
+	{
+		const Vec indices = _mm512_setr_epi64(0, 2, 4, 6, 1, 3, 5, 7);
+		Vec ordered = _mm512_permutexvar_epi64(indices, value);
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(lowDst), _mm512_castsi512_si256(ordered));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(highDst), _mm512_extracti64x4_epi64(ordered, 1));
+	}
+
+	static Vec pattern(const int8_t* bytes)
+	{
+		return _mm512_broadcast_i32x4(_mm_loadu_si128(reinterpret_cast<const __m128i*>(bytes)));
+	}
+
+	static Vec set1_16(int16_t value) { return _mm512_set1_epi16(value); }
+	static Vec set1_32(int32_t value) { return _mm512_set1_epi32(value); }
+
+	static Vec and_(Vec a, Vec b) { return _mm512_and_si512(a, b); }
+	static Vec or_(Vec a, Vec b) { return _mm512_or_si512(a, b); }
+	static Vec add16(Vec a, Vec b) { return _mm512_add_epi16(a, b); }
+	static Vec add32(Vec a, Vec b) { return _mm512_add_epi32(a, b); }
+	static Vec adds16(Vec a, Vec b) { return _mm512_adds_epi16(a, b); }
+	static Vec sub16(Vec a, Vec b) { return _mm512_sub_epi16(a, b); }
+	static Vec mullo16(Vec a, Vec b) { return _mm512_mullo_epi16(a, b); }
+	static Vec srai16(Vec a, int shift) { return _mm512_srai_epi16(a, shift); }
+	static Vec srli16(Vec a, int shift) { return _mm512_srli_epi16(a, shift); }
+	static Vec srli32(Vec a, int shift) { return _mm512_srli_epi32(a, shift); }
+	static Vec slli32(Vec a, int shift) { return _mm512_slli_epi32(a, shift); }
+	static Vec avg8(Vec a, Vec b) { return _mm512_avg_epu8(a, b); }
+	static Vec sad8(Vec a, Vec b) { return _mm512_sad_epu8(a, b); }
+	static Vec packus16(Vec a, Vec b) { return _mm512_packus_epi16(a, b); }
+	static Vec packs32(Vec a, Vec b) { return _mm512_packs_epi32(a, b); }
+	static Vec unpacklo8(Vec a, Vec b) { return _mm512_unpacklo_epi8(a, b); }
+	static Vec unpackhi8(Vec a, Vec b) { return _mm512_unpackhi_epi8(a, b); }
+	static Vec unpacklo16(Vec a, Vec b) { return _mm512_unpacklo_epi16(a, b); }
+	static Vec unpackhi16(Vec a, Vec b) { return _mm512_unpackhi_epi16(a, b); }
+	static Vec shuffle8(Vec a, Vec indices) { return _mm512_shuffle_epi8(a, indices); }
+	static Vec maddubs(Vec a, Vec b) { return _mm512_maddubs_epi16(a, b); }
+	static Vec madd16(Vec a, Vec b) { return _mm512_madd_epi16(a, b); }
+
+	static Vec evenPixels(Vec a, Vec b)
+	{
+		return _mm512_castps_si512(_mm512_shuffle_ps(
+			_mm512_castsi512_ps(a), _mm512_castsi512_ps(b), _MM_SHUFFLE(2, 0, 2, 0)
+		));
+	}
+
+	static Vec oddPixels(Vec a, Vec b)
+	{
+		return _mm512_castps_si512(_mm512_shuffle_ps(
+			_mm512_castsi512_ps(a), _mm512_castsi512_ps(b), _MM_SHUFFLE(3, 1, 3, 1)
+		));
+	}
+};
+
+} // namespace
+
+const PixelRowKernels* avx512PixelRowKernels()
+{
+	static const PixelRowKernels kernels = makePixelRowKernels<Avx512>();
+	return &kernels;
+}
+
+#else
+
+const PixelRowKernels* avx512PixelRowKernels()
+{
+	return nullptr;
+}
+
+#endif
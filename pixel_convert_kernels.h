@@ -0,0 +1,65 @@
+#ifndef PIXEL_CONVERT_KERNELS_H
+#define PIXEL_CONVERT_KERNELS_H
+
+#include <cstdint>
+
+// Row kernels behind pixel_convert.h, one table per instruction set.
+struct PixelRowKernels
+{
+	void (*bgrToBgra)(const uint8_t* src, uint8_t* dst, int width);
+	void (*rgbxToBgra)(const uint8_t* src, uint8_t* dst, int width);
+	void (*bgrxToBgra)(const uint8_t* src, uint8_t* dst, int width);
+	void (*yuyvToBgra)(const uint8_t* src, uint8_t* dst, int width);
+	void (*nv12ToBgra)(const uint8_t* srcY, const uint8_t* srcUV, uint8_t* dst, int width);
+	// Converts a pair of rows, the second row may repeat the first one.
+	void (*yuyvToNv12)(
+		const uint8_t* src0, const uint8_t* src1,
+		uint8_t* dstY0, uint8_t* dstY1, uint8_t* dstUV,
+		int width
+	);
+	void (*bgraToY)(const uint8_t* src, uint8_t* dstY, int width);
+	void (*bgraToUV)(const uint8_t* src0, const uint8_t* src1, uint8_t* dstUV, int width);
+	void (*bgraToUVPlanar)(
+		const uint8_t* src0, const uint8_t* src1,
+		uint8_t* dstU, uint8_t* dstV,
+		int width
+	);
+	void (*bgraToAlpha)(const uint8_t* src, uint8_t* dstA, int width);
+	void (*premultiply)(const uint8_t* src, const uint8_t* alpha, uint16_t* dst, int width);
+	void (*blendPremultiplied)(const uint16_t* src, const uint8_t* background, uint8_t* dst, int width);
+	// Adds the absolute differences of each group of 8 pixels to sums[x / 8].
+	void (*sumAbsDiff8)(const uint8_t* a, const uint8_t* b, uint32_t* sums, int width);
+};
+
+// The scalar reference, also used for the tails of rows by the SIMD kernels.
+// Defined in pixel_convert.cpp which is built without extra instruction sets.
+void bgrToBgraRowScalar(const uint8_t* src, uint8_t* dst, int width);
+void rgbxToBgraRowScalar(const uint8_t* src, uint8_t* dst, int width);
+void bgrxToBgraRowScalar(const uint8_t* src, uint8_t* dst, int width);
+void yuyvToBgraRowScalar(const uint8_t* src, uint8_t* dst, int width);
+void nv12ToBgraRowScalar(const uint8_t* srcY, const uint8_t* srcUV, uint8_t* dst, int width);
+void yuyvToNv12RowScalar(
+	const uint8_t* src0, const uint8_t* src1,
+	uint8_t* dstY0, uint8_t* dstY1, uint8_t* dstUV,
+	int width
+);
+void bgraToYRowScalar(const uint8_t* src, uint8_t* dstY, int width);
+void bgraToUVRowScalar(const uint8_t* src0, const uint8_t* src1, uint8_t* dstUV, int width);
+void bgraToUVPlanarRowScalar(
+	const uint8_t* src0, const uint8_t* src1,
+	uint8_t* dstU, uint8_t* dstV,
+	int width
+);
+void bgraToAlphaRowScalar(const uint8_t* src, uint8_t* dstA, int width);
+void premultiplyRowScalar(const uint8_t* src, const uint8_t* alpha, uint16_t* dst, int width);
+void blendPremultipliedRowScalar(const uint16_t* src, const uint8_t* background, uint8_t* dst, int width);
+void sumAbsDiff8RowScalar(const uint8_t* a, const uint8_t* b, uint32_t* sums, int width);
+
+// Return nullptr when the instruction set is not built in.
+const PixelRowKernels* scalarPixelRowKernels();
+const PixelRowKernels* sse41PixelRowKernels();
+const PixelRowKernels* avx2PixelRowKernels();
+const PixelRowKernels* avx512PixelRowKernels();
+const PixelRowKernels* neonPixelRowKernels();
+
+#endif
@@ -0,0 +1,298 @@
+#include "pixel_convert_kernels.h"
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(_M_ARM64)
+
+#include <arm_neon.h>
+
+namespace {
+
+// NEON loads and stores deinterleave the channels, so the kernels work on
+// planes of 8 or 16 values and need no shuffles. The math is the same as in
+// the scalar kernels of pixel_convert.cpp.
+
+void bgrToBgraRow(const uint8_t* src, uint8_t* dst, int width)
+{
+	int x = 0;
+	for (; x + 16 <= width; x += 16) {
+		uint8x16x3_t bgr = vld3q_u8(src + 3 * x);
+		uint8x16x4_t bgra;
+		bgra.val[0] = bgr.val[0];
+		bgra.val[1] = bgr.val[1];
+		bgra.val[2] = bgr.val[2];
+		bgra.val[3] = vdupq_n_u8(255);
+		vst4q_u8(dst + 4 * x, bgra);
+	}
+	bgrToBgraRowScalar(src + 3 * x, dst + 4 * x, width - x);
+}
+
+void rgbxToBgraRow(const uint8_t* src, uint8_t* dst, int width)
+{
+	int x = 0;
+	for (; x + 16 <= width; x += 16) {
+		uint8x16x4_t pixels = vld4q_u8(src + 4 * x);
+		uint8x16_t red = pixels.val[0];
+		pixels.val[0] = pixels.val[2];
+		pixels.val[2] = red;
+		pixels.val[3] = vdupq_n_u8(255);
+		vst4q_u8(dst + 4 * x, pixels);
+	}
+	rgbxToBgraRowScalar(src + 4 * x, dst + 4 * x, width - x);
+}
+
+void bgrxToBgraRow(const uint8_t* src, uint8_t* dst, int width)
+{
+	const uint8x16_t alpha = vreinterpretq_u8_u32(vdupq_n_u32(0xFF000000));
+	int x = 0;
+	for (; x + 4 <= width; x += 4) {
+		vst1q_u8(dst + 4 * x, vorrq_u8(vld1q_u8(src + 4 * x), alpha));
+	}
+	bgrxToBgraRowScalar(src + 4 * x, dst + 4 * x, width - x);
+}
+
+struct Bgr
+{
+	uint8x8_t b;
+	uint8x8_t g;
+	uint8x8_t r;
+};
+
+Bgr yuvToBgr(uint8x8_t y, int16x8_t u, int16x8_t v)
+{
+	const int16x8_t round = vdupq_n_s16(32);
+	uint16x8_t scaled = vshrq_n_u16(vmulq_n_u16(vmovl_u8(y), 149), 1);
+	int16x8_t luma = vsubq_s16(vreinterpretq_s16_u16(scaled), vdupq_n_s16(1192));
+
+	// Only blue can overflow, the saturated sum still clamps to 255.
+	int16x8_t b = vqaddq_s16(vqaddq_s16(luma, vmulq_n_s16(u, 129)), round);
+	int16x8_t g = vmlsq_n_s16(vmlsq_n_s16(luma, u, 25), v, 52);
+	int16x8_t r = vmlaq_n_s16(luma, v, 102);
+
+	Bgr bgr;
+	bgr.b = vqshrun_n_s16(b, 6);
+	bgr.g = vqshrun_n_s16(vaddq_s16(g, round), 6);
+	bgr.r = vqshrun_n_s16(vaddq_s16(r, round), 6);
+	return bgr;
+}
+
+// Converts 16 pixels given as even and odd luma and their 8 chroma pairs.
+void storeYuvAsBgra(uint8_t* dst, uint8x8_t yEven, uint8x8_t yOdd, uint8x8_t u, uint8x8_t v)
+{
+	const int16x8_t chromaOffset = vdupq_n_s16(128);
+	int16x8_t chromaU = vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(u)), chromaOffset);
+	int16x8_t chromaV = vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(v)), chromaOffset);
+
+	Bgr even = yuvToBgr(yEven, chromaU, chromaV);
+	Bgr odd = yuvToBgr(yOdd, chromaU, chromaV);
+	uint8x8x2_t b = vzip_u8(even.b, odd.b);
+	uint8x8x2_t g = vzip_u8(even.g, odd.g);
+	uint8x8x2_t r = vzip_u8(even.r, odd.r);
+
+	uint8x16x4_t bgra;
+	bgra.val[0] = vcombine_u8(b.val[0], b.val[1]);
+	bgra.val[1] = vcombine_u8(g.val[0], g.val[1]);
+	bgra.val[2] = vcombine_u8(r.val[0], r.val[1]);
+	bgra.val[3] = vdupq_n_u8(255);
+	vst4q_u8(dst, bgra);
+}
+
+void yuyvToBgraRow(const uint8_t* src, uint8_t* dst, int width)
+{
+	int x = 0;
+	for (; x + 16 <= width; x += 16) {
+		uint8x8x4_t yuyv = vld4_u8(src + 2 * x);
+		storeYuvAsBgra(dst + 4 * x, yuyv.val[0], yuyv.val[2], yuyv.val[1], yuyv.val[3]);
+	}
+	yuyvToBgraRowScalar(src + 2 * x, dst + 4 * x, width - x);
+}
+
+void nv12ToBgraRow(const uint8_t* srcY, const uint8_t* srcUV, uint8_t* dst, int width)
+{
+	int x = 0;
+	for (; x + 16 <= width; x += 16) {
+		uint8x8x2_t luma = vld2_u8(srcY + x);
+		uint8x8x2_t chroma = vld2_u8(srcUV + x);
+		storeYuvAsBgra(dst + 4 * x, luma.val[0], luma.val[1], chroma.val[0], chroma.val[1]);
+	}
+	nv12ToBgraRowScalar(srcY + x, srcUV + x, dst + 4 * x, width - x);
+}
+
+void yuyvToNv12Row(
+	const uint8_t* src0, const uint8_t* src1,
+	uint8_t* dstY0, uint8_t* dstY1, uint8_t* dstUV,
+	int width
+)
+{
+	int x = 0;
+	for (; x + 16 <= width; x += 16) {
+		uint8x16x2_t row0 = vld2q_u8(src0 + 2 * x);
+		uint8x16x2_t row1 = vld2q_u8(src1 + 2 * x);
+		vst1q_u8(dstY0 + x, row0.val[0]);
+		vst1q_u8(dstY1 + x, row1.val[0]);
+		vst1q_u8(dstUV + x, vrhaddq_u8(row0.val[1], row1.val[1]));
+	}
+	yuyvToNv12RowScalar(src0 + 2 * x, src1 + 2 * x, dstY0 + x, dstY1 + x, dstUV + x, width - x);
+}
+
+uint8x8_t bgrToY(uint8x8_t b, uint8x8_t g, uint8x8_t r)
+{
+	uint16x8_t sum = vmull_u8(b, vdup_n_u8(13));
+	sum = vmlal_u8(sum, g, vdup_n_u8(64));
+	sum = vmlal_u8(sum, r, vdup_n_u8(33));
+	return vadd_u8(vrshrn_n_u16(sum, 7), vdup_n_u8(16));
+}
+
+void bgraToYRow(const uint8_t* src, uint8_t* dstY, int width)
+{
+	int x = 0;
+	for (; x + 16 <= width; x += 16) {
+		uint8x16x4_t pixels = vld4q_u8(src + 4 * x);
+		uint8x8_t low = bgrToY(
+			vget_low_u8(pixels.val[0]),
+			vget_low_u8(pixels.val[1]),
+			vget_low_u8(pixels.val[2])
+		);
+		uint8x8_t high = bgrToY(
+			vget_high_u8(pixels.val[0]),
+			vget_high_u8(pixels.val[1]),
+			vget_high_u8(pixels.val[2])
+		);
+		vst1q_u8(dstY + x, vcombine_u8(low, high));
+	}
+	bgraToYRowScalar(src + 4 * x, dstY + x, width - x);
+}
+
+// Averages a channel of 16 pixels of two rows into 8 values of 2x2 blocks.
+int16x8_t averageBlocks(uint8x16_t row0, uint8x16_t row1)
+{
+	uint8x16_t rows = vrhaddq_u8(row0, row1);
+	uint8x16x2_t pairs = vuzpq_u8(rows, rows);
+	uint8x8_t blocks = vrhadd_u8(vget_low_u8(pairs.val[0]), vget_low_u8(pairs.val[1]));
+	return vreinterpretq_s16_u16(vmovl_u8(blocks));
+}
+
+uint8x8x2_t bgraBlocksToUV(const uint8_t* src0, const uint8_t* src1)
+{
+	uint8x16x4_t row0 = vld4q_u8(src0);
+	uint8x16x4_t row1 = vld4q_u8(src1);
+	int16x8_t b = averageBlocks(row0.val[0], row1.val[0]);
+	int16x8_t g = averageBlocks(row0.val[1], row1.val[1]);
+	int16x8_t r = averageBlocks(row0.val[2], row1.val[2]);
+
+	const int16x8_t offset = vdupq_n_s16(128);
+	int16x8_t u = vmlsq_n_s16(vmlsq_n_s16(vmulq_n_s16(b, 56), g, 37), r, 19);
+	int16x8_t v = vmlsq_n_s16(vmlsq_n_s16(vmulq_n_s16(r, 56), g, 47), b, 9);
+
+	uint8x8x2_t uv;
+	uv.val[0] = vqmovun_s16(vaddq_s16(vrshrq_n_s16(u, 7), offset));
+	uv.val[1] = vqmovun_s16(vaddq_s16(vrshrq_n_s16(v, 7), offset));
+	return uv;
+}
+
+void bgraToUVRow(const uint8_t* src0, const uint8_t* src1, uint8_t* dstUV, int width)
+{
+	int x = 0;
+	for (; x + 16 <= width; x += 16) {
+		vst2_u8(dstUV + x, bgraBlocksToUV(src0 + 4 * x, src1 + 4 * x));
+	}
+	bgraToUVRowScalar(src0 + 4 * x, src1 + 4 * x, dstUV + x, width - x);
+}
+
+void bgraToUVPlanarRow(
+	const uint8_t* src0, const uint8_t* src1,
+	uint8_t* dstU, uint8_t* dstV,
+	int width
+)
+{
+	int x = 0;
+	for (; x + 16 <= width; x += 16) {
+		uint8x8x2_t uv = bgraBlocksToUV(src0 + 4 * x, src1 + 4 * x);
+		vst1_u8(dstU + x / 2, uv.val[0]);
+		vst1_u8(dstV + x / 2, uv.val[1]);
+	}
+	bgraToUVPlanarRowScalar(src0 + 4 * x, src1 + 4 * x, dstU + x / 2, dstV + x / 2, width - x);
+}
+
+void bgraToAlphaRow(const uint8_t* src, uint8_t* dstA, int width)
+{
+	int x = 0;
+	for (; x + 16 <= width; x += 16) {
+		vst1q_u8(dstA + x, vld4q_u8(src + 4 * x).val[3]);
+	}
+	bgraToAlphaRowScalar(src + 4 * x, dstA + x, width - x);
+}
+
+void premultiplyRow(const uint8_t* src, const uint8_t* alpha, uint16_t* dst, int width)
+{
+	const uint16x8_t round = vdupq_n_u16(128);
+	int x = 0;
+	for (; x + 8 <= width; x += 8) {
+		uint8x8x4_t pixels = vld4_u8(src + 4 * x);
+		uint8x8_t pixelAlpha = vld1_u8(alpha + x);
+		uint16x8x4_t words;
+		for (int c = 0; c < 3; ++c) {
+			words.val[c] = vmlal_u8(round, pixels.val[c], pixelAlpha);
+		}
+		words.val[3] = vmovl_u8(vmvn_u8(pixelAlpha));
+		vst4q_u16(dst + 4 * x, words);
+	}
+	premultiplyRowScalar(src + 4 * x, alpha + x, dst + 4 * x, width - x);
+}
+
+void blendPremultipliedRow(const uint16_t* src, const uint8_t* background, uint8_t* dst, int width)
+{
+	int x = 0;
+	for (; x + 8 <= width; x += 8) {
+		uint8x8x4_t pixels = vld4_u8(background + 4 * x);
+		uint16x8x4_t words = vld4q_u16(src + 4 * x);
+		uint8x8_t inverseAlpha = vmovn_u16(words.val[3]);
+		for (int c = 0; c < 3; ++c) {
+			uint16x8_t sum = vmlal_u8(words.val[c], pixels.val[c], inverseAlpha);
+			pixels.val[c] = vshrn_n_u16(vsraq_n_u16(sum, sum, 8), 8);
+		}
+		pixels.val[3] = vdup_n_u8(255);
+		vst4_u8(dst + 4 * x, pixels);
+	}
+	blendPremultipliedRowScalar(src + 4 * x, background + 4 * x, dst + 4 * x, width - x);
+}
+
+void sumAbsDiff8Row(const uint8_t* a, const uint8_t* b, uint32_t* sums, int width)
+{
+	int x = 0;
+	for (; x + 16 <= width; x += 16) {
+		uint8x16_t diff = vabdq_u8(vld1q_u8(a + x), vld1q_u8(b + x));
+		uint64x2_t groups = vpaddlq_u32(vpaddlq_u16(vpaddlq_u8(diff)));
+		vst1_u32(sums + x / 8, vadd_u32(vld1_u32(sums + x / 8), vmovn_u64(groups)));
+	}
+	sumAbsDiff8RowScalar(a + x, b + x, sums + x / 8, width - x);
+}
+
+} // namespace
+
+const PixelRowKernels* neonPixelRowKernels()
+{
+	static const PixelRowKernels kernels = {
+		&bgrToBgraRow,
+		&rgbxToBgraRow,
+		&bgrxToBgraRow,
+		&yuyvToBgraRow,
+		&nv12ToBgraRow,
+		&yuyvToNv12Row,
+		&bgraToYRow,
+		&bgraToUVRow,
+		&bgraToUVPlanarRow,
+		&bgraToAlphaRow,
+		&premultiplyRow,
+		&blendPremultipliedRow,
+		&sumAbsDiff8Row
+	};
+	return &kernels;
+}
+
+#else
+
+const PixelRowKernels* neonPixelRowKernels()
+{
+	return nullptr;
+}
+
+#endif
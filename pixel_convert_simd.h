@@ -0,0 +1,382 @@
+#ifndef PIXEL_CONVERT_SIMD_H
+#define PIXEL_CONVERT_SIMD_H
+
+#include "pixel_convert_kernels.h"
+
+// x86 row kernels written once against a vector traits class V and
+// instantiated by each instruction set source with its own flags. All the
+// shuffles and packs of SSE, AVX2 and AVX-512 work within 128-bit lanes, so
+// the kernels treat a vector as V::lanes independent 128-bit lanes and the
+// traits place the data of consecutive pixel blocks into consecutive lanes.
+//
+// Everything here must depend on V: a non-template inline function would be
+// compiled with AVX flags and could be picked by the linker for every caller.
+//
+// The fixed point math is the same as in the scalar kernels of
+// pixel_convert.cpp, the results match bit for bit.
+
+template<class V>
+void bgrToBgraRow(const uint8_t* src, uint8_t* dst, int width)
+{
+	static const int8_t expand[16] = {
+		0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1
+	};
+	const typename V::Vec shuffle = V::pattern(expand);
+	const typename V::Vec alpha = V::set1_32(int32_t(0xFF000000));
+
+	// A lane takes 12 bytes of 4 pixels but loads 16 of them.
+	int x = 0;
+	for (; 3 * (width - x) >= 16 * V::lanes; x += 4 * V::lanes) {
+		typename V::Vec pixels = V::loadBGRLanes(src + 3 * x);
+		V::store(dst + 4 * x, V::or_(V::shuffle8(pixels, shuffle), alpha));
+	}
+	bgrToBgraRowScalar(src + 3 * x, dst + 4 * x, width - x);
+}
+
+template<class V, bool swapRB>
+void bgrxToBgraRow(const uint8_t* src, uint8_t* dst, int width)
+{
+	static const int8_t swap[16] = {
+		2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15
+	};
+	const typename V::Vec shuffle = V::pattern(swap);
+	const typename V::Vec alpha = V::set1_32(int32_t(0xFF000000));
+
+	int x = 0;
+	for (; x + 4 * V::lanes <= width; x += 4 * V::lanes) {
+		typename V::Vec pixels = V::load(src + 4 * x);
+		if (swapRB) {
+			pixels = V::shuffle8(pixels, shuffle);
+		}
+		V::store(dst + 4 * x, V::or_(pixels, alpha));
+	}
+	if (swapRB) {
+		rgbxToBgraRowScalar(src + 4 * x, dst + 4 * x, width - x);
+	}
+	else {
+		bgrxToBgraRowScalar(src + 4 * x, dst + 4 * x, width - x);
+	}
+}
+
+// Converts 8 pixels per lane: luma as 16-bit words and 4 interleaved 16-bit
+// chroma pairs.
+template<class V>
+void storeYuvAsBgra(uint8_t* dst, typename V::Vec y, typename V::Vec uv)
+{
+	using Vec = typename V::Vec;
+	static const int8_t uWords[16] = {
+		0, 1, 0, 1, 4, 5, 4, 5, 8, 9, 8, 9, 12, 13, 12, 13
+	};
+	static const int8_t vWords[16] = {
+		2, 3, 2, 3, 6, 7, 6, 7, 10, 11, 10, 11, 14, 15, 14, 15
+	};
+
+	const Vec chromaOffset = V::set1_16(128);
+	const Vec round = V::set1_16(32);
+	Vec u = V::sub16(V::shuffle8(uv, V::pattern(uWords)), chromaOffset);
+	Vec v = V::sub16(V::shuffle8(uv, V::pattern(vWords)), chromaOffset);
+	// 1.164 * 64 is 74.5, the unsigned product of 149 fits 16 bits.
+	Vec luma = V::sub16(V::srli16(V::mullo16(y, V::set1_16(149)), 1), V::set1_16(1192));
+
+	// Only blue can overflow, the saturated sum still clamps to 255.
+	Vec b = V::adds16(V::adds16(luma, V::mullo16(u, V::set1_16(129))), round);
+	Vec g = V::sub16(
+		V::sub16(luma, V::mullo16(u, V::set1_16(25))),
+		V::mullo16(v, V::set1_16(52))
+	);
+	g = V::add16(g, round);
+	Vec r = V::add16(V::add16(luma, V::mullo16(v, V::set1_16(102))), round);
+
+	Vec blueRed = V::packus16(V::srai16(b, 6), V::srai16(r, 6));
+	Vec greenAlpha = V::packus16(V::srai16(g, 6), V::set1_16(255));
+	Vec blueGreen = V::unpacklo8(blueRed, greenAlpha);
+	Vec redAlpha = V::unpackhi8(blueRed, greenAlpha);
+	V::storeLanePairs(
+		dst,
+		V::unpacklo16(blueGreen, redAlpha),
+		V::unpackhi16(blueGreen, redAlpha)
+	);
+}
+
+template<class V>
+void yuyvToBgraRow(const uint8_t* src, uint8_t* dst, int width)
+{
+	const typename V::Vec lowBytes = V::set1_16(0x00FF);
+
+	int x = 0;
+	for (; x + 8 * V::lanes <= width; x += 8 * V::lanes) {
+		typename V::Vec pixels = V::load(src + 2 * x);
+		storeYuvAsBgra<V>(dst + 4 * x, V::and_(pixels, lowBytes), V::srli16(pixels, 8));
+	}
+	yuyvToBgraRowScalar(src + 2 * x, dst + 4 * x, width - x);
+}
+
+template<class V>
+void nv12ToBgraRow(const uint8_t* srcY, const uint8_t* srcUV, uint8_t* dst, int width)
+{
+	int x = 0;
+	for (; x + 8 * V::lanes <= width; x += 8 * V::lanes) {
+		storeYuvAsBgra<V>(dst + 4 * x, V::loadWidenU8(srcY + x), V::loadWidenU8(srcUV + x));
+	}
+	nv12ToBgraRowScalar(srcY + x, srcUV + x, dst + 4 * x, width - x);
+}
+
+template<class V>
+void yuyvToNv12Row(
+	const uint8_t* src0, const uint8_t* src1,
+	uint8_t* dstY0, uint8_t* dstY1, uint8_t* dstUV,
+	int width
+)
+{
+	using Vec = typename V::Vec;
+	const Vec lowBytes = V::set1_16(0x00FF);
+
+	int x = 0;
+	for (; x + 16 * V::lanes <= width; x += 16 * V::lanes) {
+		Vec a0 = V::loadLanes(src0 + 2 * x, 32);
+		Vec a1 = V::loadLanes(src0 + 2 * x + 16, 32);
+		Vec b0 = V::loadLanes(src1 + 2 * x, 32);
+		Vec b1 = V::loadLanes(src1 + 2 * x + 16, 32);
+		V::store(dstY0 + x, V::packus16(V::and_(a0, lowBytes), V::and_(a1, lowBytes)));
+		V::store(dstY1 + x, V::packus16(V::and_(b0, lowBytes), V::and_(b1, lowBytes)));
+		V::store(dstUV + x, V::packus16(
+			V::srli16(V::avg8(a0, b0), 8),
+			V::srli16(V::avg8(a1, b1), 8)
+		));
+	}
+	yuyvToNv12RowScalar(src0 + 2 * x, src1 + 2 * x, dstY0 + x, dstY1 + x, dstUV + x, width - x);
+}
+
+template<class V>
+void bgraToYRow(const uint8_t* src, uint8_t* dstY, int width)
+{
+	using Vec = typename V::Vec;
+	static const int8_t coefficients[16] = {
+		13, 64, 33, 0, 13, 64, 33, 0, 13, 64, 33, 0, 13, 64, 33, 0
+	};
+	const Vec coef = V::pattern(coefficients);
+	const Vec ones = V::set1_16(1);
+	const Vec round = V::set1_16(64);
+	const Vec offset = V::set1_16(16);
+
+	int x = 0;
+	for (; x + 16 * V::lanes <= width; x += 16 * V::lanes) {
+		Vec sums[4];
+		for (int k = 0; k < 4; ++k) {
+			Vec pixels = V::loadLanes(src + 4 * x + 16 * k, 64);
+			sums[k] = V::madd16(V::maddubs(pixels, coef), ones);
+		}
+		Vec low = V::packs32(sums[0], sums[1]);
+		Vec high = V::packs32(sums[2], sums[3]);
+		low = V::add16(V::srli16(V::add16(low, round), 7), offset);
+		high = V::add16(V::srli16(V::add16(high, round), 7), offset);
+		V::store(dstY + x, V::packus16(low, high));
+	}
+	bgraToYRowScalar(src + 4 * x, dstY + x, width - x);
+}
+
+// Averages 2x2 blocks of 16 pixels per lane and returns 8 U bytes in the low
+// half of each lane followed by 8 V bytes.
+template<class V>
+typename V::Vec bgraBlocksToUV(const uint8_t* src0, const uint8_t* src1)
+{
+	using Vec = typename V::Vec;
+	static const int8_t uCoefficients[16] = {
+		56, -37, -19, 0, 56, -37, -19, 0, 56, -37, -19, 0, 56, -37, -19, 0
+	};
+	static const int8_t vCoefficients[16] = {
+		-9, -47, 56, 0, -9, -47, 56, 0, -9, -47, 56, 0, -9, -47, 56, 0
+	};
+	const Vec ones = V::set1_16(1);
+	const Vec round = V::set1_16(64);
+	const Vec offset = V::set1_16(128);
+
+	Vec rows[4];
+	for (int k = 0; k < 4; ++k) {
+		rows[k] = V::avg8(V::loadLanes(src0 + 16 * k, 64), V::loadLanes(src1 + 16 * k, 64));
+	}
+	Vec blocks0 = V::avg8(V::evenPixels(rows[0], rows[1]), V::oddPixels(rows[0], rows[1]));
+	Vec blocks1 = V::avg8(V::evenPixels(rows[2], rows[3]), V::oddPixels(rows[2], rows[3]));
+
+	Vec uCoef = V::pattern(uCoefficients);
+	Vec vCoef = V::pattern(vCoefficients);
+	Vec u = V::packs32(
+		V::madd16(V::maddubs(blocks0, uCoef), ones),
+		V::madd16(V::maddubs(blocks1, uCoef), ones)
+	);
+	Vec v = V::packs32(
+		V::madd16(V::maddubs(blocks0, vCoef), ones),
+		V::madd16(V::maddubs(blocks1, vCoef), ones)
+	);
+	u = V::add16(V::srai16(V::add16(u, round), 7), offset);
+	v = V::add16(V::srai16(V::add16(v, round), 7), offset);
+	return V::packus16(u, v);
+}
+
+template<class V>
+void bgraToUVRow(const uint8_t* src0, const uint8_t* src1, uint8_t* dstUV, int width)
+{
+	static const int8_t interleave[16] = {
+		0, 8, 1, 9, 2, 10, 3, 11, 4, 12, 5, 13, 6, 14, 7, 15
+	};
+	const typename V::Vec shuffle = V::pattern(interleave);
+
+	int x = 0;
+	for (; x + 16 * V::lanes <= width; x += 16 * V::lanes) {
+		typename V::Vec uv = bgraBlocksToUV<V>(src0 + 4 * x, src1 + 4 * x);
+		V::store(dstUV + x, V::shuffle8(uv, shuffle));
+	}
+	bgraToUVRowScalar(src0 + 4 * x, src1 + 4 * x, dstUV + x, width - x);
+}
+
+template<class V>
+void bgraToUVPlanarRow(
+	const uint8_t* src0, const uint8_t* src1,
+	uint8_t* dstU, uint8_t* dstV,
+	int width
+)
+{
+	int x = 0;
+	for (; x + 16 * V::lanes <= width; x += 16 * V::lanes) {
+		typename V::Vec uv = bgraBlocksToUV<V>(src0 + 4 * x, src1 + 4 * x);
+		V::storeHalves(dstU + x / 2, dstV + x / 2, uv);
+	}
+	bgraToUVPlanarRowScalar(src0 + 4 * x, src1 + 4 * x, dstU + x / 2, dstV + x / 2, width - x);
+}
+
+template<class V>
+void bgraToAlphaRow(const uint8_t* src, uint8_t* dstA, int width)
+{
+	using Vec = typename V::Vec;
+
+	int x = 0;
+	for (; x + 16 * V::lanes <= width; x += 16 * V::lanes) {
+		Vec alpha[4];
+		for (int k = 0; k < 4; ++k) {
+			alpha[k] = V::srli32(V::loadLanes(src + 4 * x + 16 * k, 64), 24);
+		}
+		V::store(dstA + x, V::packus16(V::packs32(alpha[0], alpha[1]), V::packs32(alpha[2], alpha[3])));
+	}
+	bgraToAlphaRowScalar(src + 4 * x, dstA + x, width - x);
+}
+
+// Words 0 to 2 of each pixel are the premultiplied color, word 3 the inverse alpha.
+template<class V>
+typename V::Vec premultiplyWords(typename V::Vec pixels)
+{
+	using Vec = typename V::Vec;
+	static const int8_t alphaWords[16] = {
+		6, 7, 6, 7, 6, 7, 6, 7, 14, 15, 14, 15, 14, 15, 14, 15
+	};
+	static const int8_t colorWords[16] = {
+		-1, -1, -1, -1, -1, -1, 0, 0, -1, -1, -1, -1, -1, -1, 0, 0
+	};
+	static const int8_t inverseAlphaWords[16] = {
+		0, 0, 0, 0, 0, 0, -1, -1, 0, 0, 0, 0, 0, 0, -1, -1
+	};
+
+	Vec alpha = V::shuffle8(pixels, V::pattern(alphaWords));
+	Vec color = V::add16(V::mullo16(pixels, alpha), V::set1_16(128));
+	Vec inverseAlpha = V::sub16(V::set1_16(255), alpha);
+	return V::or_(
+		V::and_(color, V::pattern(colorWords)),
+		V::and_(inverseAlpha, V::pattern(inverseAlphaWords))
+	);
+}
+
+// The lanes of the premultiplied row are stored in pixel order with
+// storeLanePairs() and loaded back with loadLanes().
+template<class V>
+void premultiplyRow(const uint8_t* src, const uint8_t* alpha, uint16_t* dst, int width)
+{
+	using Vec = typename V::Vec;
+	const Vec zero = V::set1_16(0);
+	const Vec colorBytes = V::set1_32(0x00FFFFFF);
+	uint8_t* words = reinterpret_cast<uint8_t*>(dst);
+
+	int x = 0;
+	for (; x + 4 * V::lanes <= width; x += 4 * V::lanes) {
+		Vec pixels = V::or_(
+			V::and_(V::load(src + 4 * x), colorBytes),
+			V::slli32(V::loadWidenU8To32(alpha + x), 24)
+		);
+		V::storeLanePairs(
+			words + 8 * x,
+			premultiplyWords<V>(V::unpacklo8(pixels, zero)),
+			premultiplyWords<V>(V::unpackhi8(pixels, zero))
+		);
+	}
+	premultiplyRowScalar(src + 4 * x, alpha + x, dst + 4 * x, width - x);
+}
+
+template<class V>
+typename V::Vec blendWords(typename V::Vec premultiplied, typename V::Vec background)
+{
+	using Vec = typename V::Vec;
+	static const int8_t inverseAlphaWords[16] = {
+		6, 7, 6, 7, 6, 7, 6, 7, 14, 15, 14, 15, 14, 15, 14, 15
+	};
+
+	// The sum fits 16 bits, the alpha word is replaced by the caller.
+	Vec inverseAlpha = V::shuffle8(premultiplied, V::pattern(inverseAlphaWords));
+	Vec sum = V::add16(premultiplied, V::mullo16(background, inverseAlpha));
+	return V::srli16(V::add16(sum, V::srli16(sum, 8)), 8);
+}
+
+template<class V>
+void blendPremultipliedRow(const uint16_t* src, const uint8_t* background, uint8_t* dst, int width)
+{
+	using Vec = typename V::Vec;
+	const Vec zero = V::set1_16(0);
+	const Vec alpha = V::set1_32(int32_t(0xFF000000));
+	const uint8_t* words = reinterpret_cast<const uint8_t*>(src);
+
+	int x = 0;
+	for (; x + 4 * V::lanes <= width; x += 4 * V::lanes) {
+		Vec pixels = V::load(background + 4 * x);
+		Vec low = blendWords<V>(V::loadLanes(words + 8 * x, 32), V::unpacklo8(pixels, zero));
+		Vec high = blendWords<V>(V::loadLanes(words + 8 * x + 16, 32), V::unpackhi8(pixels, zero));
+		V::store(dst + 4 * x, V::or_(V::packus16(low, high), alpha));
+	}
+	blendPremultipliedRowScalar(src + 4 * x, background + 4 * x, dst + 4 * x, width - x);
+}
+
+// Each lane takes 32 pixels, the sums of its four groups of 8 are the even
+// 32-bit words of the two SAD results.
+template<class V>
+void sumAbsDiff8Row(const uint8_t* a, const uint8_t* b, uint32_t* sums, int width)
+{
+	using Vec = typename V::Vec;
+	uint8_t* sumBytes = reinterpret_cast<uint8_t*>(sums);
+
+	int x = 0;
+	for (; x + 32 * V::lanes <= width; x += 32 * V::lanes) {
+		Vec low = V::sad8(V::loadLanes(a + x, 32), V::loadLanes(b + x, 32));
+		Vec high = V::sad8(V::loadLanes(a + x + 16, 32), V::loadLanes(b + x + 16, 32));
+		uint8_t* dst = sumBytes + x / 2;
+		V::store(dst, V::add32(V::load(dst), V::evenPixels(low, high)));
+	}
+	sumAbsDiff8RowScalar(a + x, b + x, sums + x / 8, width - x);
+}
+
+template<class V>
+PixelRowKernels makePixelRowKernels()
+{
+	PixelRowKernels kernels;
+	kernels.bgrToBgra = &bgrToBgraRow<V>;
+	kernels.rgbxToBgra = &bgrxToBgraRow<V, true>;
+	kernels.bgrxToBgra = &bgrxToBgraRow<V, false>;
+	kernels.yuyvToBgra = &yuyvToBgraRow<V>;
+	kernels.nv12ToBgra = &nv12ToBgraRow<V>;
+	kernels.yuyvToNv12 = &yuyvToNv12Row<V>;
+	kernels.bgraToY = &bgraToYRow<V>;
+	kernels.bgraToUV = &bgraToUVRow<V>;
+	kernels.bgraToUVPlanar = &bgraToUVPlanarRow<V>;
+	kernels.bgraToAlpha = &bgraToAlphaRow<V>;
+	kernels.premultiply = &premultiplyRow<V>;
+	kernels.blendPremultiplied = &blendPremultipliedRow<V>;
+	kernels.sumAbsDiff8 = &sumAbsDiff8Row<V>;
+	return kernels;
+}
+
+#endif
@@ -0,0 +1,123 @@
+#include "pixel_convert_kernels.h"
+
+#if defined(__SSE4_1__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+
+#include "pixel_convert_simd.h"
+
+#include <smmintrin.h>
+
+#include <cstring>
+
+namespace {
+
+struct Sse41
+{
+	using Vec = __m128i;
+	static const int lanes = 1;
+
+	static Vec load(const uint8_t* src)
+	{
+		return _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+	}
+
+	static void store(uint8_t* dst, Vec value)
+	{
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dst), value);
+	}
+
+	static Vec loadLanes(const uint8_t* src, int)
+	{
+		return load(src);
+	}
+
+	static Vec loadBGRLanes(const uint8_t* src)
+	{
+		return load(src);
+	}
+
+	static Vec loadWidenU8(const uint8_t* src)
+	{
+		return _mm_cvtepu8_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(src)));
+	}
+
+	static Vec loadWidenU8To32(const uint8_t* src)
+	{
+		int32_t bytes;
+		std::memcpy(&bytes, src, sizeof(bytes));
+		return _mm_cvtepu8_epi32(_mm_cvtsi32_si128(bytes));
+	}
+
+	static void storeLanePairs(uint8_t* dst, Vec low, Vec high)
+	{
+		store(dst, low);
+		store(dst + 16, high);
+	}
+
+	static void storeHalves(uint8_t* lowDst, uint8_t* highDst, Vec value)
+	{
+		_mm_storel_epi64(reinterpret_cast<__m128i*>(lowDst), value);
+		_mm_storel_epi64(reinterpret_cast<__m128i*>(highDst), _mm_unpackhi_epi64(value, value));
+	}
+
+	static Vec pattern(const int8_t* bytes)
+	{
+		return load(reinterpret_cast<const uint8_t*>(bytes));
+	}
+
+	static Vec set1_16(int16_t value) { return _mm_set1_epi16(value); }
+	static Vec set1_32(int32_t value) { return _mm_set1_epi32(value); }
+
+	static Vec and_(Vec a, Vec b) { return _mm_and_si128(a, b); }
+	static Vec or_(Vec a, Vec b) { return _mm_or_si128(a, b); }
+	static Vec add16(Vec a, Vec b) { return _mm_add_epi16(a, b); }
+	static Vec add32(Vec a, Vec b) { return _mm_add_epi32(a, b); }
+	static Vec adds16(Vec a, Vec b) { return _mm_adds_epi16(a, b); }
+	static Vec sub16(Vec a, Vec b) { return _mm_sub_epi16(a, b); }
+	static Vec mullo16(Vec a, Vec b) { return _mm_mullo_epi16(a, b); }
+	static Vec srai16(Vec a, int shift) { return _mm_srai_epi16(a, shift); }
+	static Vec srli16(Vec a, int shift) { return _mm_srli_epi16(a, shift); }
+	static Vec srli32(Vec a, int shift) { return _mm_srli_epi32(a, shift); }
+	static Vec slli32(Vec a, int shift) { return _mm_slli_epi32(a, shift); }
+	static Vec avg8(Vec a, Vec b) { return _mm_avg_epu8(a, b); }
+	static Vec sad8(Vec a, Vec b) { return _mm_sad_epu8(a, b); }
+	static Vec packus16(Vec a, Vec b) { return _mm_packus_epi16(a, b); }
+	static Vec packs32(Vec a, Vec b) { return _mm_packs_epi32(a, b); }
+	static Vec unpacklo8(Vec a, Vec b) { return _mm_unpacklo_epi8(a, b); }
+	static Vec unpackhi8(Vec a, Vec b) { return _mm_unpackhi_epi8(a, b); }
+	static Vec unpacklo16(Vec a, Vec b) { return _mm_unpacklo_epi16(a, b); }
+	static Vec unpackhi16(Vec a, Vec b) { return _mm_unpackhi_epi16(a, b); }
+	static Vec shuffle8(Vec a, Vec indices) { return _mm_shuffle_epi8(a, indices); }
+	static Vec maddubs(Vec a, Vec b) { return _mm_maddubs_epi16(a, b); }
+	static Vec madd16(Vec a, Vec b) { return _mm_madd_epi16(a, b); }
+
+	static Vec evenPixels(Vec a, Vec b)
+	{
+		return _mm_castps_si128(_mm_shuffle_ps(
+			_mm_castsi128_ps(a), _mm_castsi128_ps(b), _MM_SHUFFLE(2, 0, 2, 0)
+		));
+	}
+
+	static Vec oddPixels(Vec a, Vec b)
+	{
+		return _mm_castps_si128(_mm_shuffle_ps(
+			_mm_castsi128_ps(a), _mm_castsi128_ps(b), _MM_SHUFFLE(3, 1, 3, 1)
+		));
+	}
+};
+
+} // namespace
+
+const PixelRowKernels* sse41PixelRowKernels()
+{
+	static const PixelRowKernels kernels = makePixelRowKernels<Sse41>();
+	return &kernels;
+}
+
+#else
+
+const PixelRowKernels* sse41PixelRowKernels()
+{
+	return nullptr;
+}
+
+#endif
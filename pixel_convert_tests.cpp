@@ -0,0 +1,305 @@
+#include "pixel_convert.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <random>
+#include <string>
+#include <vector>
+
+// Checks the SIMD kernels of every instruction set the build and the CPU
+// support against the scalar ones. The conversions run on random pixels over
+// odd sizes and padded rows, the whole destination buffers, padding included,
+// have to match bit for bit.
+
+static const PixelConvertIsa simdIsas[] = {
+	PixelConvertIsa::sse41,
+	PixelConvertIsa::avx2,
+	PixelConvertIsa::avx512,
+	PixelConvertIsa::neon
+};
+
+// Around the vector widths of all instruction sets, and their tails.
+static const int widths[] = { 1, 2, 3, 5, 7, 8, 15, 16, 17, 31, 32, 33, 63, 64, 65, 127, 129, 255, 257 };
+static const int heights[] = { 1, 2, 3, 9 };
+// Extra bytes at the end of every row.
+static const int paddings[] = { 0, 3, 68 };
+
+static const uint8_t untouchedByte = 0xcd;
+
+struct Plane
+{
+	int bytesPerLine = 0;
+	std::vector<uint8_t> bytes;
+
+	uint8_t* data() { return bytes.data(); }
+	uint16_t* words() { return reinterpret_cast<uint16_t*>(bytes.data()); }
+	int wordsPerLine() const { return bytesPerLine / 2; }
+};
+
+static Plane randomPlane(int rowBytes, int rows, int padding, std::mt19937& random)
+{
+	Plane plane;
+	plane.bytesPerLine = rowBytes + padding;
+	plane.bytes.resize(size_t(plane.bytesPerLine) * size_t(rows));
+	for (auto& byte : plane.bytes) {
+		byte = static_cast<uint8_t>(random());
+	}
+	return plane;
+}
+
+static Plane outputPlane(int rowBytes, int rows, int padding)
+{
+	Plane plane;
+	plane.bytesPerLine = rowBytes + padding;
+	plane.bytes.assign(size_t(plane.bytesPerLine) * size_t(rows), untouchedByte);
+	return plane;
+}
+
+// Premultiplied pixels as premultiplyBGRA() writes them, padded with words.
+static Plane premultipliedPlane(int width, int rows, int padding, std::mt19937& random)
+{
+	Plane plane = outputPlane(8 * width, rows, 2 * padding);
+	for (int y = 0; y < rows; ++y) {
+		uint16_t* row = plane.words() + y * plane.wordsPerLine();
+		for (int x = 0; x < width; ++x) {
+			const int alpha = random() % 256;
+			for (int c = 0; c < 3; ++c) {
+				row[4 * x + c] = static_cast<uint16_t>(int(random() % 256) * alpha + 128);
+			}
+			row[4 * x + 3] = static_cast<uint16_t>(255 - alpha);
+		}
+	}
+	return plane;
+}
+
+static int half(int size)
+{
+	return (size + 1) / 2;
+}
+
+struct ConversionTest
+{
+	const char* name;
+	// YUYV holds two pixels in four bytes.
+	bool evenWidth;
+	// Converts random input of the size and returns the destination planes.
+	std::function<std::vector<Plane>(int width, int height, int padding, std::mt19937& random)> run;
+};
+
+static const ConversionTest conversionTests[] = {
+	{ "BGR to BGRA", false, [](int width, int height, int padding, std::mt19937& random) {
+		Plane src = randomPlane(3 * width, height, padding, random);
+		Plane dst = outputPlane(4 * width, height, padding);
+		convertBGRToBGRA(src.data(), src.bytesPerLine, dst.data(), dst.bytesPerLine, width, height);
+		return std::vector<Plane>{ dst };
+	} },
+	{ "RGBX to BGRA", false, [](int width, int height, int padding, std::mt19937& random) {
+		Plane src = randomPlane(4 * width, height, padding, random);
+		Plane dst = outputPlane(4 * width, height, padding);
+		convertRGBXToBGRA(src.data(), src.bytesPerLine, dst.data(), dst.bytesPerLine, width, height);
+		return std::vector<Plane>{ dst };
+	} },
+	{ "BGRX to BGRA", false, [](int width, int height, int padding, std::mt19937& random) {
+		Plane src = randomPlane(4 * width, height, padding, random);
+		Plane dst = outputPlane(4 * width, height, padding);
+		convertBGRXToBGRA(src.data(), src.bytesPerLine, dst.data(), dst.bytesPerLine, width, height);
+		return std::vector<Plane>{ dst };
+	} },
+	{ "BGRX to BGRA in place", false, [](int width, int height, int padding, std::mt19937& random) {
+		Plane pixels = randomPlane(4 * width, height, padding, random);
+		convertBGRXToBGRA(pixels.data(), pixels.bytesPerLine, pixels.data(), pixels.bytesPerLine, width, height);
+		return std::vector<Plane>{ pixels };
+	} },
+	{ "YUYV to BGRA", true, [](int width, int height, int padding, std::mt19937& random) {
+		Plane src = randomPlane(2 * width, height, padding, random);
+		Plane dst = outputPlane(4 * width, height, padding);
+		convertYUYVToBGRA(src.data(), src.bytesPerLine, dst.data(), dst.bytesPerLine, width, height);
+		return std::vector<Plane>{ dst };
+	} },
+	{ "YUYV to NV12", true, [](int width, int height, int padding, std::mt19937& random) {
+		Plane src = randomPlane(2 * width, height, padding, random);
+		Plane dstY = outputPlane(width, height, padding);
+		Plane dstUV = outputPlane(2 * half(width), half(height), padding);
+		convertYUYVToNV12(
+			src.data(), src.bytesPerLine,
+			dstY.data(), dstY.bytesPerLine,
+			dstUV.data(), dstUV.bytesPerLine,
+			width, height
+		);
+		return std::vector<Plane>{ dstY, dstUV };
+	} },
+	{ "NV12 to BGRA", false, [](int width, int height, int padding, std::mt19937& random) {
+		Plane srcY = randomPlane(width, height, padding, random);
+		Plane srcUV = randomPlane(2 * half(width), half(height), padding, random);
+		Plane dst = outputPlane(4 * width, height, padding);
+		convertNV12ToBGRA(
+			srcY.data(), srcY.bytesPerLine,
+			srcUV.data(), srcUV.bytesPerLine,
+			dst.data(), dst.bytesPerLine,
+			width, height
+		);
+		return std::vector<Plane>{ dst };
+	} },
+	{ "BGRA to NV12", false, [](int width, int height, int padding, std::mt19937& random) {
+		Plane src = randomPlane(4 * width, height, padding, random);
+		Plane dstY = outputPlane(width, height, padding);
+		Plane dstUV = outputPlane(2 * half(width), half(height), padding);
+		convertBGRAToNV12(
+			src.data(), src.bytesPerLine,
+			dstY.data(), dstY.bytesPerLine,
+			dstUV.data(), dstUV.bytesPerLine,
+			width, height
+		);
+		return std::vector<Plane>{ dstY, dstUV };
+	} },
+	{ "BGRA to I420", false, [](int width, int height, int padding, std::mt19937& random) {
+		Plane src = randomPlane(4 * width, height, padding, random);
+		Plane dstY = outputPlane(width, height, padding);
+		Plane dstU = outputPlane(half(width), half(height), padding);
+		Plane dstV = outputPlane(half(width), half(height), padding);
+		convertBGRAToI420(
+			src.data(), src.bytesPerLine,
+			dstY.data(), dstY.bytesPerLine,
+			dstU.data(), dstU.bytesPerLine,
+			dstV.data(), dstV.bytesPerLine,
+			width, height
+		);
+		return std::vector<Plane>{ dstY, dstU, dstV };
+	} },
+	{ "BGRA to Y", false, [](int width, int height, int padding, std::mt19937& random) {
+		Plane src = randomPlane(4 * width, height, padding, random);
+		Plane dstY = outputPlane(width, height, padding);
+		convertBGRAToY(src.data(), src.bytesPerLine, dstY.data(), dstY.bytesPerLine, width, height);
+		return std::vector<Plane>{ dstY };
+	} },
+	{ "BGRA alpha", false, [](int width, int height, int padding, std::mt19937& random) {
+		Plane src = randomPlane(4 * width, height, padding, random);
+		Plane dstA = outputPlane(width, height, padding);
+		extractBGRAAlpha(src.data(), src.bytesPerLine, dstA.data(), dstA.bytesPerLine, width, height);
+		return std::vector<Plane>{ dstA };
+	} },
+	{ "8x8 absolute differences", false, [](int width, int height, int padding, std::mt19937& random) {
+		Plane a = randomPlane(width, height, padding, random);
+		Plane b = randomPlane(width, height, padding, random);
+		const int tileCount = ((width + 7) / 8) * ((height + 7) / 8);
+		Plane sums = outputPlane(4 * tileCount, 1, 0);
+		sumAbsDifference8x8(
+			a.data(), a.bytesPerLine,
+			b.data(), b.bytesPerLine,
+			reinterpret_cast<uint32_t*>(sums.data()),
+			width, height
+		);
+		return std::vector<Plane>{ sums };
+	} },
+	{ "premultiply BGRA", false, [](int width, int height, int padding, std::mt19937& random) {
+		Plane src = randomPlane(4 * width, height, padding, random);
+		Plane alpha = randomPlane(width, height, padding, random);
+		Plane dst = outputPlane(8 * width, height, 2 * padding);
+		premultiplyBGRA(
+			src.data(), src.bytesPerLine,
+			alpha.data(), alpha.bytesPerLine,
+			dst.words(), dst.wordsPerLine(),
+			width, height
+		);
+		return std::vector<Plane>{ dst };
+	} },
+	{ "blend premultiplied BGRA", false, [](int width, int height, int padding, std::mt19937& random) {
+		Plane src = premultipliedPlane(width, height, padding, random);
+		Plane background = randomPlane(4 * width, height, padding, random);
+		Plane dst = outputPlane(4 * width, height, padding);
+		blendPremultipliedBGRA(
+			src.words(), src.wordsPerLine(),
+			background.data(), background.bytesPerLine,
+			dst.data(), dst.bytesPerLine,
+			width, height
+		);
+		return std::vector<Plane>{ dst };
+	} },
+};
+
+static std::vector<Plane> runConversion(
+	const ConversionTest& test,
+	PixelConvertIsa isa,
+	int width,
+	int height,
+	int padding
+)
+{
+	setPixelConvertIsa(isa);
+	// The same input for every instruction set.
+	std::mt19937 random(uint32_t(width * 1000003 + height * 1009 + padding));
+	return test.run(width, height, padding, random);
+}
+
+// Returns the offset of the first differing byte, -1 if the planes match.
+static long firstDifference(const Plane& expected, const Plane& actual)
+{
+	for (size_t i = 0; i < expected.bytes.size(); ++i) {
+		if (expected.bytes[i] != actual.bytes[i]) {
+			return long(i);
+		}
+	}
+	return -1;
+}
+
+static int checkIsa(PixelConvertIsa isa)
+{
+	int failureCount = 0;
+	for (const ConversionTest& test : conversionTests) {
+		for (int width : widths) {
+			if (test.evenWidth) {
+				width += width % 2;
+			}
+			for (int height : heights) {
+				for (int padding : paddings) {
+					std::vector<Plane> expected = runConversion(test, PixelConvertIsa::scalar, width, height, padding);
+					std::vector<Plane> actual = runConversion(test, isa, width, height, padding);
+					for (size_t plane = 0; plane < expected.size(); ++plane) {
+						long offset = firstDifference(expected[plane], actual[plane]);
+						if (offset < 0) {
+							continue;
+						}
+						const int bytesPerLine = expected[plane].bytesPerLine;
+						std::printf(
+							"FAIL %s %s %dx%d, padding %d: plane %d differs at row %ld, byte %ld (%d, scalar %d)\n",
+							pixelConvertIsaName(isa),
+							test.name,
+							width,
+							height,
+							padding,
+							int(plane),
+							offset / bytesPerLine,
+							offset % bytesPerLine,
+							actual[plane].bytes[offset],
+							expected[plane].bytes[offset]
+						);
+						++failureCount;
+					}
+				}
+			}
+		}
+	}
+	return failureCount;
+}
+
+int main()
+{
+	int failureCount = 0;
+	int checkedIsaCount = 0;
+	for (PixelConvertIsa isa : simdIsas) {
+		if (!setPixelConvertIsa(isa)) {
+			std::printf("%s: not supported here, skipped\n", pixelConvertIsaName(isa));
+			continue;
+		}
+		int isaFailureCount = checkIsa(isa);
+		std::printf("%s: %s\n", pixelConvertIsaName(isa), (0 == isaFailureCount) ? "ok" : "FAILED");
+		failureCount += isaFailureCount;
+		++checkedIsaCount;
+	}
+	if (0 == checkedIsaCount) {
+		std::printf("No SIMD kernels in this build or on this CPU\n");
+	}
+	return (0 == failureCount) ? 0 : 1;
+}
@@ -0,0 +1,371 @@
+#include "raw_recording.h"
+
+#include <QFileInfo>
+
+#include <algorithm>
+#include <cstring>
+
+static const char fileMagic[8] = { 'T', 'S', 'V', 'B', 'R', 'A', 'W', '1' };
+static const char indexMagic[8] = { 'T', 'S', 'V', 'B', 'I', 'D', 'X', '1' };
+static const uint32_t formatVersion = 1;
+static const uint64_t frameAlignment = 64;
+static const char rawRecordingSuffix[] = "tsvbraw";
+
+struct RawFileHeader
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t reserved;
+};
+
+struct RawFileTrailer
+{
+	uint64_t indexOffset;
+	uint64_t frameCount;
+	char magic[8];
+};
+
+static bool pixelFormatFromType(int type, RawPixelFormat& format)
+{
+	switch (type) {
+	case CV_8UC3:
+		format = RawPixelFormat::bgr24;
+		return true;
+	case CV_8UC4:
+		format = RawPixelFormat::bgra32;
+		return true;
+	case CV_8UC1:
+		format = RawPixelFormat::gray8;
+		return true;
+	default:
+		return false;
+	}
+}
+
+static int typeFromPixelFormat(uint32_t format)
+{
+	switch (static_cast<RawPixelFormat>(format)) {
+	case RawPixelFormat::bgr24:
+		return CV_8UC3;
+	case RawPixelFormat::bgra32:
+		return CV_8UC4;
+	case RawPixelFormat::gray8:
+		return CV_8UC1;
+	default:
+		return -1;
+	}
+}
+
+RawRecorder::RawRecorder(const QString& filePath, int queueSize, Metrics* metrics)
+	: _metrics(metrics)
+	, _file(filePath)
+{
+	if (!_file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+		_failed = true;
+		return;
+	}
+
+	RawFileHeader header = {};
+	std::memcpy(header.magic, fileMagic, sizeof(fileMagic));
+	header.version = formatVersion;
+	const auto headerData = reinterpret_cast<const char*>(&header);
+	if (_file.write(headerData, sizeof(header)) != qint64(sizeof(header))) {
+		_failed = true;
+		_file.close();
+		return;
+	}
+
+	_pool.resize(std::max(queueSize, 1));
+	for (int i = 0; i < int(_pool.size()); ++i) {
+		_freeFrames.push_back(i);
+	}
+	_writeThread = std::thread([this] { writeLoop(); });
+}
+
+RawRecorder::~RawRecorder()
+{
+	finish();
+	if (_writeThread.joinable()) {
+		_writeThread.join();
+	}
+}
+
+bool RawRecorder::isValid() const
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	return !_failed;
+}
+
+bool RawRecorder::writeFrame(const cv::Mat& frame, MetricsClock::duration timestamp)
+{
+	RawPixelFormat format;
+	if (frame.empty() || !pixelFormatFromType(frame.type(), format)) {
+		return false;
+	}
+
+	int index = -1;
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		if (_failed || _stopRequested) {
+			return false;
+		}
+		if (!_freeFrames.empty()) {
+			index = _freeFrames.back();
+			_freeFrames.pop_back();
+		}
+	}
+	if (-1 == index) {
+		if (nullptr != _metrics) {
+			_metrics->onRawRecordingFrameDropped();
+		}
+		return false;
+	}
+
+	// The pool frames keep their buffers while the size stays the same.
+	QueuedFrame& queuedFrame = _pool[index];
+	frame.copyTo(queuedFrame.frame);
+	queuedFrame.timestamp = timestamp;
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_queuedFrames.push_back(index);
+	}
+	_condition.notify_one();
+	return true;
+}
+
+void RawRecorder::finish(std::function<void(bool)> finished)
+{
+	bool ok = false;
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		if (_stopRequested) {
+			return;
+		}
+		_stopRequested = true;
+		if (_writeThread.joinable()) {
+			_finished = std::move(finished);
+			finished = nullptr;
+		}
+		ok = !_failed;
+	}
+	_condition.notify_all();
+	// Nothing was started when the file could not be opened.
+	if (nullptr != finished) {
+		finished(ok);
+	}
+}
+
+void RawRecorder::writeLoop()
+{
+	bool ok = true;
+	while (true) {
+		int index = -1;
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+			_condition.wait(lock, [this] { return _stopRequested || !_queuedFrames.empty(); });
+			if (_queuedFrames.empty()) {
+				// Stopped with everything queued written.
+				break;
+			}
+			index = _queuedFrames.front();
+			_queuedFrames.pop_front();
+		}
+
+		ok = writeQueuedFrame(_pool[index].frame, _pool[index].timestamp);
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_freeFrames.push_back(index);
+			if (!ok) {
+				_failed = true;
+				_queuedFrames.clear();
+			}
+		}
+		if (!ok) {
+			break;
+		}
+	}
+
+	std::function<void(bool)> finished;
+	{
+		// A failed write stops the thread before it is asked to.
+		std::unique_lock<std::mutex> lock(_mutex);
+		_condition.wait(lock, [this] { return _stopRequested; });
+		finished = std::move(_finished);
+	}
+	ok = ok && writeIndex();
+	_file.close();
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_failed = !ok;
+	}
+	if (nullptr != finished) {
+		finished(ok);
+	}
+}
+
+bool RawRecorder::writeQueuedFrame(const cv::Mat& frame, MetricsClock::duration timestamp)
+{
+	RawPixelFormat format;
+	pixelFormatFromType(frame.type(), format);
+	if (!writePadding()) {
+		return false;
+	}
+
+	RawFrameIndexEntry entry = {};
+	entry.offset = static_cast<uint64_t>(_file.pos());
+	entry.timestampNs = std::chrono::duration_cast<std::chrono::nanoseconds>(timestamp).count();
+	entry.width = static_cast<uint32_t>(frame.cols);
+	entry.height = static_cast<uint32_t>(frame.rows);
+	entry.bytesPerLine = static_cast<uint32_t>(frame.cols * frame.elemSize());
+	entry.pixelFormat = static_cast<uint32_t>(format);
+
+	// The copied frames are continuous.
+	const qint64 frameSize = qint64(entry.bytesPerLine) * frame.rows;
+	const auto data = reinterpret_cast<const char*>(frame.data);
+	if (_file.write(data, frameSize) != frameSize) {
+		return false;
+	}
+	_index.push_back(entry);
+	return true;
+}
+
+bool RawRecorder::writeIndex()
+{
+	if (!writePadding()) {
+		return false;
+	}
+
+	RawFileTrailer trailer = {};
+	trailer.indexOffset = static_cast<uint64_t>(_file.pos());
+	trailer.frameCount = _index.size();
+	std::memcpy(trailer.magic, indexMagic, sizeof(indexMagic));
+
+	const qint64 indexSize = qint64(_index.size() * sizeof(RawFrameIndexEntry));
+	const auto indexData = reinterpret_cast<const char*>(_index.data());
+	const auto trailerData = reinterpret_cast<const char*>(&trailer);
+	return (_file.write(indexData, indexSize) == indexSize) &&
+		(_file.write(trailerData, sizeof(trailer)) == qint64(sizeof(trailer)));
+}
+
+bool RawRecorder::writePadding()
+{
+	static const char padding[frameAlignment] = {};
+	uint64_t offset = static_cast<uint64_t>(_file.pos());
+	qint64 paddingSize = qint64((frameAlignment - offset % frameAlignment) % frameAlignment);
+	return (_file.write(padding, paddingSize) == paddingSize);
+}
+
+bool RawReplay::isRawRecording(const std::string& filePath)
+{
+	return (0 == QFileInfo(QString::fromStdString(filePath)).suffix().compare(
+		rawRecordingSuffix,
+		Qt::CaseInsensitive
+	));
+}
+
+RawReplay::RawReplay(const std::string& filePath)
+	: _file(QString::fromStdString(filePath))
+	, _loopDuration(MetricsClock::duration::zero())
+	, _loopOffset(MetricsClock::duration::zero())
+{
+	if (!_file.open(QIODevice::ReadOnly)) {
+		return;
+	}
+	const uint64_t fileSize = static_cast<uint64_t>(_file.size());
+	if (fileSize < sizeof(RawFileHeader) + sizeof(RawFileTrailer)) {
+		return;
+	}
+	const uchar* data = _file.map(0, _file.size());
+	if (nullptr == data) {
+		return;
+	}
+
+	RawFileHeader header;
+	std::memcpy(&header, data, sizeof(header));
+	RawFileTrailer trailer;
+	std::memcpy(&trailer, data + fileSize - sizeof(trailer), sizeof(trailer));
+	const uint64_t indexEnd = fileSize - sizeof(trailer);
+	bool valid =
+		(0 == std::memcmp(header.magic, fileMagic, sizeof(fileMagic))) &&
+		(formatVersion == header.version) &&
+		(0 == std::memcmp(trailer.magic, indexMagic, sizeof(indexMagic))) &&
+		(trailer.frameCount > 0) &&
+		(trailer.indexOffset <= indexEnd) &&
+		(trailer.frameCount <= (indexEnd - trailer.indexOffset) / sizeof(RawFrameIndexEntry)) &&
+		(0 == trailer.indexOffset % alignof(RawFrameIndexEntry));
+	if (!valid) {
+		return;
+	}
+
+	auto index = reinterpret_cast<const RawFrameIndexEntry*>(data + trailer.indexOffset);
+	for (uint64_t i = 0; i < trailer.frameCount; ++i) {
+		const RawFrameIndexEntry& entry = index[i];
+		int type = typeFromPixelFormat(entry.pixelFormat);
+		uint64_t frameSize = uint64_t(entry.bytesPerLine) * entry.height;
+		bool entryValid =
+			(type >= 0) &&
+			(entry.width > 0) && (entry.height > 0) &&
+			(uint64_t(entry.width) * CV_ELEM_SIZE(type) <= entry.bytesPerLine) &&
+			(entry.offset <= trailer.indexOffset) &&
+			(frameSize <= trailer.indexOffset - entry.offset);
+		if (!entryValid) {
+			return;
+		}
+	}
+
+	_data = data;
+	_index = index;
+	_frameCount = trailer.frameCount;
+
+	auto firstTimestamp = std::chrono::nanoseconds(_index[0].timestampNs);
+	auto lastTimestamp = std::chrono::nanoseconds(_index[_frameCount - 1].timestampNs);
+	auto recordedDuration = std::chrono::duration<double>(lastTimestamp - firstTimestamp);
+	if ((_frameCount > 1) && (recordedDuration.count() > 0)) {
+		_frameRate = (_frameCount - 1) / recordedDuration.count();
+		_loopDuration = std::chrono::duration_cast<MetricsClock::duration>(
+			recordedDuration + recordedDuration / double(_frameCount - 1)
+		);
+	}
+}
+
+RawReplay::~RawReplay()
+{
+	if (nullptr != _data) {
+		_file.unmap(const_cast<uchar*>(_data));
+	}
+}
+
+bool RawReplay::isValid() const
+{
+	return (nullptr != _data);
+}
+
+double RawReplay::frameRate() const
+{
+	return _frameRate;
+}
+
+bool RawReplay::read(cv::Mat& frame, MetricsClock::duration& position)
+{
+	if (nullptr == _data) {
+		return false;
+	}
+
+	if (_nextFrame == _frameCount) {
+		_nextFrame = 0;
+		_loopOffset += _loopDuration;
+	}
+	const RawFrameIndexEntry& entry = _index[_nextFrame++];
+
+	frame = cv::Mat(
+		static_cast<int>(entry.height),
+		static_cast<int>(entry.width),
+		typeFromPixelFormat(entry.pixelFormat),
+		const_cast<uchar*>(_data + entry.offset),
+		entry.bytesPerLine
+	);
+	position = _loopOffset + std::chrono::duration_cast<MetricsClock::duration>(
+		std::chrono::nanoseconds(entry.timestampNs - _index[0].timestampNs)
+	);
+	return true;
+}
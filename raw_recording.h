@@ -0,0 +1,119 @@
+#ifndef RAW_RECORDING_H
+#define RAW_RECORDING_H
+
+#include "frame_source.h"
+
+#include <QFile>
+#include <QString>
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Raw recording file: a header, the frames as tightly packed rows each
+// starting at a 64 byte aligned offset, then an index of the frames and a
+// trailer pointing to the index. Integers are stored in the byte order of
+// the machine. The index is written when the recording finishes.
+
+enum class RawPixelFormat : uint32_t
+{
+	bgr24 = 1,
+	bgra32 = 2,
+	gray8 = 3
+};
+
+struct RawFrameIndexEntry
+{
+	uint64_t offset;
+	int64_t timestampNs;
+	uint32_t width;
+	uint32_t height;
+	uint32_t bytesPerLine;
+	uint32_t pixelFormat;
+};
+
+// Writes the frames exactly as captured on its own thread. writeFrame() only
+// copies the frame into a free buffer of a fixed pool, a frame which finds
+// none is dropped and counted in the metrics, so a slow disk does not stall
+// the capture.
+class RawRecorder
+{
+public:
+	RawRecorder(const QString& filePath, int queueSize, Metrics* metrics);
+	// Finishes the recording and waits for the writer thread.
+	~RawRecorder();
+
+	// False once the file could not be opened or written.
+	bool isValid() const;
+
+	// Accepts 8 bit BGR, BGRA and gray frames. Returns false if the frame
+	// was dropped.
+	bool writeFrame(const cv::Mat& frame, MetricsClock::duration timestamp);
+	// Returns at once, no frames are accepted afterwards. The writer thread
+	// writes the queued frames and the index, then calls finished with the
+	// result.
+	void finish(std::function<void(bool)> finished = nullptr);
+
+private:
+	void writeLoop();
+	bool writeQueuedFrame(const cv::Mat& frame, MetricsClock::duration timestamp);
+	bool writeIndex();
+	// Aligns the next write to the frame alignment.
+	bool writePadding();
+
+private:
+	struct QueuedFrame
+	{
+		cv::Mat frame;
+		MetricsClock::duration timestamp;
+	};
+
+	Metrics* const _metrics;
+	std::vector<QueuedFrame> _pool;
+	std::vector<int> _freeFrames;
+	std::deque<int> _queuedFrames;
+
+	mutable std::mutex _mutex;
+	std::condition_variable _condition;
+	bool _stopRequested = false;
+	bool _failed = false;
+	std::function<void(bool)> _finished;
+	std::thread _writeThread;
+
+	// Used by the writer thread once it runs.
+	QFile _file;
+	std::vector<RawFrameIndexEntry> _index;
+};
+
+// Replays a raw recording from the mapped file without copying or decoding.
+// The replay loops, positions keep growing across the loops.
+class RawReplay : public FrameSource
+{
+public:
+	static bool isRawRecording(const std::string& filePath);
+
+	explicit RawReplay(const std::string& filePath);
+	~RawReplay() override;
+
+	bool isValid() const override;
+	double frameRate() const override;
+
+	bool read(cv::Mat& frame, MetricsClock::duration& position) override;
+
+private:
+	QFile _file;
+	const uchar* _data = nullptr;
+	const RawFrameIndexEntry* _index = nullptr;
+	uint64_t _frameCount = 0;
+	uint64_t _nextFrame = 0;
+	double _frameRate = 0;
+	MetricsClock::duration _loopDuration;
+	MetricsClock::duration _loopOffset;
+};
+
+#endif
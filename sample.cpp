@@ -1,8 +1,13 @@
 #include "sample.h"
 
+#include "encoder_sink.h"
 #include "media_utils.h"
 #include "pipeline.h"
 #include "sample_ui.h"
+#include "settings_writer.h"
+#include "shared_memory_sink.h"
+
+#include <algorithm>
 
 #ifdef Q_OS_MACOS
 #include "camera_access_authorization.h"
@@ -10,6 +15,17 @@
 
 const char CAMERA_NAME[] = "camera_name";
 const char CAMERA_SCALE[] = "camera_scale";
+const char FRAME_RATE_CAP[] = "frame_rate_cap";
+const char STATIC_SCENE_THRESHOLD[] = "static_scene_threshold";
+
+// The shared memory ring holds frames up to the largest processing scale.
+static const char sharedMemoryName[] = "/tsvb_frames";
+static const int sharedMemoryMaxWidth = 3840;
+static const int sharedMemoryMaxHeight = 2160;
+static const int sharedMemorySlotCount = 3;
+
+static const int encoderQueueSize = 8;
+static const double defaultRecordingFps = 30;
 const char BLUR_ENABLED[] = "blur_enabled";
 const char REPLACE_ENABLED[] = "replace_enabled";
 const char BEAUTIFICATION_ENABLED[] = "beautification_enabled";
@@ -99,11 +115,18 @@ static QString dialogImageFilter()
 	return "Image (*.png *.jpg *.jpeg *.jpe *.tiff *.tif)";
 }
 
+static QString dialogBackgroundFilter()
+{
+	return "Background (*.png *.jpg *.jpeg *.jpe *.tiff *.tif *.gif *.mp4 *.m4v *.mov *.avi *.mkv *.webm);;"
+		"Image (*.png *.jpg *.jpeg *.jpe *.tiff *.tif);;"
+		"Animation (*.gif *.mp4 *.m4v *.mov *.avi *.mkv *.webm)";
+}
+
 Sample::Sample()
 	: m_ui(new SampleUI(this))
 	, m_pipeline(new Pipeline)
 {
-	m_settings.reset(new QSettings(settingsFilePath(), QSettings::Format::IniFormat));
+	m_settings.reset(new SettingsWriter(settingsFilePath()));
 	if (!m_settings->isWritable()) {
 		QMessageBox::warning(
 			this,
@@ -125,6 +148,31 @@ Sample::Sample()
 		m_pipeline.get(), &Pipeline::frameAvailable,
 		this, &Sample::processFrame
 	);
+	connect(
+		m_pipeline.get(), &Pipeline::recordingFinished,
+		this, &Sample::onRawRecordingFinished
+	);
+	m_ui->frameView->setMetrics(m_pipeline->metrics());
+	connect(
+		m_ui->frameView, &FrameView::displaySizeChanged,
+		m_pipeline.get(), &Pipeline::setDisplaySize
+	);
+	m_pipeline->setDisplaySize(m_ui->frameView->displaySize());
+	connect(
+		m_ui->frameView, &FrameView::visibilityChanged,
+		m_pipeline.get(), &Pipeline::setViewVisible
+	);
+	qRegisterMetaType<Effect>("Effect");
+	connect(
+		m_pipeline->videoFilter(), &VideoFilter::effectReady,
+		this, &Sample::onEffectReady,
+		Qt::QueuedConnection
+	);
+	connect(
+		m_pipeline->videoFilter(), &VideoFilter::effectFailed,
+		this, &Sample::onEffectFailed,
+		Qt::QueuedConnection
+	);
 #ifdef Q_OS_MACOS
 	auto accessStatus = videoCaptureAuthorizationStatus();
 	if (CaptureAuthorizationStatus::authorized == accessStatus) {
@@ -284,7 +332,25 @@ bool Sample::restoreUIAndPipelineFromSettings()
 	int cameraScaleIndex = m_ui->cameraScaleComoBox->findData(cameraScale);
 	m_ui->cameraScaleComoBox->setCurrentIndex(cameraScaleIndex);
 
-	m_pipeline->trySetFrameSize(cameraScale.width(), cameraScale.height());
+	m_pipeline->setProcessingSize(cameraScale.width(), cameraScale.height());
+
+	double frameRateCap = m_settings->value(FRAME_RATE_CAP, 0.0).toDouble();
+	int frameRateCapIndex = m_ui->frameRateCapComboBox->findData(frameRateCap);
+	if (-1 == frameRateCapIndex) {
+		frameRateCap = 0;
+		frameRateCapIndex = 0;
+	}
+	m_ui->frameRateCapComboBox->setCurrentIndex(frameRateCapIndex);
+	m_pipeline->setTargetFps(frameRateCap);
+
+	double staticSceneThreshold = m_settings->value(STATIC_SCENE_THRESHOLD, 0.0).toDouble();
+	int staticSceneIndex = m_ui->staticSceneComboBox->findData(staticSceneThreshold);
+	if (-1 == staticSceneIndex) {
+		staticSceneThreshold = 0;
+		staticSceneIndex = 0;
+	}
+	m_ui->staticSceneComboBox->setCurrentIndex(staticSceneIndex);
+	m_pipeline->setStaticSceneThreshold(staticSceneThreshold);
 
 	bool isBlurEnabled = m_settings->value(BLUR_ENABLED, false).toBool();
 	if (isBlurEnabled) {
@@ -499,6 +565,7 @@ bool Sample::setCameraByName(const QString& name)
 	if (-1 == deviceIndex) {
 		return false;
 	}
+	m_pipeline->setMediaPath(std::string());
 	m_pipeline->setDeviceIndex(deviceIndex);
 #endif
 
@@ -538,12 +605,24 @@ void Sample::onCameraPicked(const QString& cameraName)
 	}
 }
 
-void Sample::setCameraScale(const QSize& scale)
+void Sample::setProcessingScale(const QSize& scale)
 {
-	m_pipeline->trySetFrameSize(scale.width(), scale.height());
+	m_pipeline->setProcessingSize(scale.width(), scale.height());
 	m_settings->setValue(CAMERA_SCALE, scale);
 }
 
+void Sample::setFrameRateCap(double fps)
+{
+	m_pipeline->setTargetFps(fps);
+	m_settings->setValue(FRAME_RATE_CAP, fps);
+}
+
+void Sample::setStaticSceneThreshold(double threshold)
+{
+	m_pipeline->setStaticSceneThreshold(threshold);
+	m_settings->setValue(STATIC_SCENE_THRESHOLD, threshold);
+}
+
 void Sample::toggleBlurEnabled()
 {
 	bool enabled = m_pipeline->videoFilter()->isBlurEnabled();
@@ -612,14 +691,8 @@ void Sample::toggleReplaceEnabled()
 		m_settings->setValue(REPLACE_ENABLED, false);
 		return;
 	}
-	bool result = m_pipeline->videoFilter()->enableReplacement();
-	if (result) {
-		m_settings->setValue(REPLACE_ENABLED, true);
-		return;
-	}
-
-	m_ui->replaceCheckBox->setChecked(false);
-	QMessageBox::warning(this, "Error", "Failure to enable Replace");
+	m_ui->replaceCheckBox->setEnabled(false);
+	m_pipeline->videoFilter()->enableReplacementAsync();
 }
 
 void Sample::toggleBeautificateEnabled()
@@ -633,22 +706,8 @@ void Sample::toggleBeautificateEnabled()
 		checkCPUPipelineAvailable();
 		return;
 	}
-	bool result = m_pipeline->videoFilter()->enableBeautification();
-	m_ui->beautificationLevelSlider->setEnabled(result);
-	if (!result) {
-		m_ui->beautificateCheckBox->setChecked(false);
-		QMessageBox::warning(this, "Error", "Failure to enable Beautificate");
-		return;
-	}
-
-	float level = m_pipeline->videoFilter()->beautificationLevel();
-	int sliderValue = 
-		static_cast<int>(level * m_ui->beautificationLevelSlider->maximum());
-	m_ui->beautificationLevelSlider->setValue(sliderValue);
-	m_ui->beautificationLevelLabel->setText(stringFromNumber(level));
-	checkCPUPipelineAvailable();
-	m_settings->setValue(BEAUTIFICATION_ENABLED, true);
-	m_settings->setValue(BEAUTIFICATION_LEVEL, level);
+	m_ui->beautificateCheckBox->setEnabled(false);
+	m_pipeline->videoFilter()->enableBeautificationAsync();
 }
 
 void Sample::toggleCorrectColorsEnabled()
@@ -666,17 +725,8 @@ void Sample::toggleCorrectColorsEnabled()
 		m_settings->remove(ENABLED_COLOR_CORRECTION_MODE);
 		return;
 	}
-	bool result = m_pipeline->videoFilter()->enableColorCorrection();
-	if (!result) {
-		m_ui->correctColorsCheckbox->setChecked(false);
-		m_ui->colorIntensitySlider->setEnabled(false);
-		QMessageBox::warning(this, "Error", "Failure to enable Color Correction");
-		return;
-	}
-
-	m_ui->colorIntensitySlider->setEnabled(true);
-	onColorIntensitySliderMoved();
-	m_settings->setValue(ENABLED_COLOR_CORRECTION_MODE, COLOR_CORRECTION_MODE_AUTO);
+	m_ui->colorBox->setEnabled(false);
+	m_pipeline->videoFilter()->enableColorCorrectionAsync();
 }
 
 void Sample::toggleSmartZoomEnabled()
@@ -721,16 +771,8 @@ void Sample::toggleColorGradingEnabled()
 		}
 	}
 
-	bool result = m_pipeline->videoFilter()->enableColorGrading(m_colorGradingRefPath);
-	if (!result) {
-		m_ui->colorGradingCheckbox->setChecked(false);
-		m_ui->colorIntensitySlider->setEnabled(false);
-		QMessageBox::warning(this, "Error", "Failure to enable Color Grading");
-		return;
-	}
-	m_settings->setValue(ENABLED_COLOR_CORRECTION_MODE, COLOR_CORRECTION_MODE_GRADING);
-	m_ui->colorIntensitySlider->setEnabled(true);
-	onColorIntensitySliderMoved();
+	m_ui->colorBox->setEnabled(false);
+	m_pipeline->videoFilter()->enableColorGradingAsync(m_colorGradingRefPath);
 }
 
 void Sample::toggleColorFilterEnabled()
@@ -864,13 +906,83 @@ void Sample::onSharpeningPowerSliderMoved()
 	m_settings->setValue(SHARPENING_POWER, value);
 }
 
+void Sample::onEffectReady(Effect effect)
+{
+	switch (effect) {
+	case Effect::replacement:
+		m_ui->replaceCheckBox->setEnabled(true);
+		m_ui->replaceCheckBox->setChecked(true);
+		m_settings->setValue(REPLACE_ENABLED, true);
+		break;
+	case Effect::beautification: {
+		m_ui->beautificateCheckBox->setEnabled(true);
+		m_ui->beautificateCheckBox->setChecked(true);
+		m_ui->beautificationLevelSlider->setEnabled(true);
+		float level = m_pipeline->videoFilter()->beautificationLevel();
+		int sliderValue =
+			static_cast<int>(level * m_ui->beautificationLevelSlider->maximum());
+		m_ui->beautificationLevelSlider->setValue(sliderValue);
+		m_ui->beautificationLevelLabel->setText(stringFromNumber(level));
+		checkCPUPipelineAvailable();
+		checkGPUOnlyFeaturesEnabled();
+		m_settings->setValue(BEAUTIFICATION_ENABLED, true);
+		m_settings->setValue(BEAUTIFICATION_LEVEL, level);
+		break;
+	}
+	case Effect::colorCorrection:
+		m_ui->colorBox->setEnabled(true);
+		m_ui->correctColorsCheckbox->setChecked(true);
+		m_ui->colorIntensitySlider->setEnabled(true);
+		onColorIntensitySliderMoved();
+		m_settings->setValue(ENABLED_COLOR_CORRECTION_MODE, COLOR_CORRECTION_MODE_AUTO);
+		break;
+	case Effect::colorGrading:
+		m_ui->colorBox->setEnabled(true);
+		m_ui->colorGradingCheckbox->setChecked(true);
+		m_ui->colorIntensitySlider->setEnabled(true);
+		onColorIntensitySliderMoved();
+		m_settings->setValue(ENABLED_COLOR_CORRECTION_MODE, COLOR_CORRECTION_MODE_GRADING);
+		break;
+	}
+}
+
+void Sample::onEffectFailed(Effect effect)
+{
+	switch (effect) {
+	case Effect::replacement:
+		m_ui->replaceCheckBox->setEnabled(true);
+		m_ui->replaceCheckBox->setChecked(false);
+		QMessageBox::warning(this, "Error", "Failure to enable Replace");
+		break;
+	case Effect::beautification:
+		m_ui->beautificateCheckBox->setEnabled(true);
+		m_ui->beautificateCheckBox->setChecked(false);
+		m_ui->beautificationLevelSlider->setEnabled(false);
+		checkGPUOnlyFeaturesEnabled();
+		QMessageBox::warning(this, "Error", "Failure to enable Beautificate");
+		break;
+	case Effect::colorCorrection:
+		m_ui->colorBox->setEnabled(true);
+		m_ui->correctColorsCheckbox->setChecked(false);
+		m_ui->colorIntensitySlider->setEnabled(false);
+		QMessageBox::warning(this, "Error", "Failure to enable Color Correction");
+		break;
+	case Effect::colorGrading:
+		m_ui->colorBox->setEnabled(true);
+		m_ui->colorGradingCheckbox->setChecked(false);
+		m_ui->colorIntensitySlider->setEnabled(false);
+		QMessageBox::warning(this, "Error", "Failure to enable Color Grading");
+		break;
+	}
+}
+
 void Sample::openBackground()
 {
 	QString filepath = QFileDialog::getOpenFileName(
 			this,
 			"Background",
 			QString(),
-			dialogImageFilter()
+			dialogBackgroundFilter()
 	);
 	if (!filepath.isEmpty()) {
 		m_pipeline->videoFilter()->setBackground(filepath);
@@ -878,6 +990,146 @@ void Sample::openBackground()
 	}
 }
 
+void Sample::toggleRawRecording(bool checked)
+{
+	if (!checked) {
+		// The writer thread finishes the file, see onRawRecordingFinished().
+		m_pipeline->stopRecording();
+		return;
+	}
+
+	QString filePath = QFileDialog::getSaveFileName(
+		this,
+		"Raw Recording",
+		QString(),
+		"Raw recordings (*.tsvbraw)"
+	);
+	if (filePath.isEmpty()) {
+		m_ui->recordRawButton->setChecked(false);
+		return;
+	}
+	if (!filePath.endsWith(".tsvbraw", Qt::CaseInsensitive)) {
+		filePath += ".tsvbraw";
+	}
+	if (!m_pipeline->startRecording(filePath)) {
+		m_ui->recordRawButton->setChecked(false);
+		QMessageBox::warning(this, "Error", "Failure to create the raw recording");
+	}
+}
+
+void Sample::onRawRecordingFinished(bool written)
+{
+	if (!written) {
+		QMessageBox::warning(this, "Error", "Failure to write the raw recording");
+	}
+}
+
+void Sample::openRawRecording()
+{
+	QString filePath = QFileDialog::getOpenFileName(
+		this,
+		"Raw Recording",
+		QString(),
+		"Raw recordings (*.tsvbraw)"
+	);
+	if (!filePath.isEmpty()) {
+		// Picking a camera switches back to it.
+		m_pipeline->setMediaPath(filePath.toStdString());
+	}
+}
+
+void Sample::toggleSharedMemoryOutput(bool checked)
+{
+	if (nullptr != m_sharedMemorySink) {
+		m_pipeline->removeSink(m_sharedMemorySink);
+		m_sharedMemorySink.reset();
+		m_pipeline->metrics()->onSharedFramePublished(0, 0);
+	}
+	if (!checked) {
+		return;
+	}
+
+	auto sink = std::make_shared<SharedMemorySink>(
+		sharedMemoryName,
+		sharedMemoryMaxWidth,
+		sharedMemoryMaxHeight,
+		sharedMemorySlotCount,
+		m_pipeline->metrics()
+	);
+	if (!sink->isValid()) {
+		m_ui->sharedMemoryCheckBox->setChecked(false);
+		QString message = "Failure to create the shared memory output";
+		if (sink->isNameInUse()) {
+			message = QString(
+				"The shared memory %1 is used by another instance. "
+				"If none is running, remove the one a crashed instance left behind."
+			).arg(sharedMemoryName);
+		}
+		QMessageBox::warning(this, "Error", message);
+		return;
+	}
+	m_sharedMemorySink = sink;
+	m_pipeline->addSink(m_sharedMemorySink);
+}
+
+void Sample::toggleOutputRecording(bool checked)
+{
+	if (!checked) {
+		if (nullptr != m_encoderSink) {
+			m_pipeline->removeSink(m_encoderSink);
+			m_pipeline->metrics()->resetEncoderStats();
+			EncoderSink* finishing = m_encoderSink.get();
+			m_finishingEncoderSinks.push_back(std::move(m_encoderSink));
+			// The encode thread writes the queued frames and closes the file.
+			finishing->finish([this, finishing](bool written) {
+				QMetaObject::invokeMethod(this, [this, finishing, written]() {
+					m_finishingEncoderSinks.erase(
+						std::remove_if(
+							m_finishingEncoderSinks.begin(),
+							m_finishingEncoderSinks.end(),
+							[finishing](const std::shared_ptr<EncoderSink>& sink) {
+								return sink.get() == finishing;
+							}
+						),
+						m_finishingEncoderSinks.end()
+					);
+					if (!written) {
+						QMessageBox::warning(this, "Error", "Failure to write the recording");
+					}
+				}, Qt::QueuedConnection);
+			});
+		}
+		return;
+	}
+
+	QString filePath = QFileDialog::getSaveFileName(
+		this,
+		"Output Recording",
+		QString(),
+		"Video (*.mp4 *.avi)"
+	);
+	if (filePath.isEmpty()) {
+		m_ui->recordOutputButton->setChecked(false);
+		return;
+	}
+	if (QFileInfo(filePath).suffix().isEmpty()) {
+		filePath += ".mp4";
+	}
+
+	double fps = m_pipeline->metrics()->frameRateCap();
+	m_pipeline->metrics()->resetEncoderStats();
+	m_pipeline->metrics()->setEncoderQueueDepth(0, encoderQueueSize);
+	m_encoderSink = std::make_shared<EncoderSink>(
+		filePath.toStdString(),
+		(fps > 0) ? fps : defaultRecordingFps,
+		encoderQueueSize,
+		EncoderDropPolicy::dropNewest,
+		EncoderTiming::timestamps,
+		m_pipeline->metrics()
+	);
+	m_pipeline->addSink(m_encoderSink);
+}
+
 void Sample::openColorGradingReference()
 {
 	auto colorGradingRefPath = QFileDialog::getOpenFileName(
@@ -980,13 +1232,58 @@ void Sample::onPresetPicked(Preset preset)
 void Sample::updateMetrics()
 {
 	auto metrics = m_pipeline->metrics();
+	metrics->sampleCpuUsage();
 	if (metrics->isCameraSwitch()) {
 		m_ui->metricsView->setCameraSwitch();
 	}
 	else if (metrics->hasCameraError()) {
 		m_ui->metricsView->setCameraError();
 	}
+	else if (metrics->isBypassActive()) {
+		m_ui->metricsView->setBypass(metrics->avgBypassTime(), metrics->bypassedFrameCount());
+	}
 	else {
 		m_ui->metricsView->update(metrics->avgTimePerFrame(), metrics->lastFrameSize());
+		m_ui->metricsView->updateBackgroundDecode(
+			metrics->avgBackgroundDecodeTime(),
+			metrics->backgroundDecodeLoad()
+		);
 	}
+	m_ui->metricsView->updateMediaDecode(
+		metrics->avgMediaDecodeTime(),
+		metrics->mediaReadStallCount()
+	);
+	m_ui->metricsView->updateSharedMemory(
+		metrics->sharedFramePublishedCount(),
+		metrics->sharedFrameConsumedCount()
+	);
+	m_ui->metricsView->updateEncoder(
+		metrics->avgEncodeTime(),
+		metrics->encoderQueueDepth(),
+		metrics->encoderQueueCapacity(),
+		metrics->encoderDroppedFrameCount()
+	);
+	m_ui->metricsView->updateRawRecording(
+		m_ui->recordRawButton->isChecked(),
+		metrics->rawRecordingDroppedFrameCount()
+	);
+	m_ui->metricsView->updatePresent(metrics->avgDisplayScaleTime(), metrics->avgPaintTime());
+	m_ui->metricsView->updatePresentPacing(
+		metrics->avgPresentLatency(),
+		metrics->presentJitter(),
+		metrics->missedRefreshCount(),
+		metrics->skippedFrameCount()
+	);
+	m_ui->metricsView->updateFrameRate(
+		metrics->frameRateCap(),
+		metrics->achievedFps(),
+		metrics->overCapFrameCount(),
+		metrics->lateFrameCount()
+	);
+	m_ui->metricsView->updateStaticScene(
+		metrics->staticFrameRatio(),
+		metrics->staticSceneCpuSaved(),
+		metrics->staticFrameCount()
+	);
+	m_ui->metricsView->updateCpuUsage(metrics->cpuUsage(false), metrics->cpuUsage(true));
 }
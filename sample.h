@@ -8,9 +8,13 @@
 #include <QtWidgets>
 
 #include <memory>
+#include <vector>
 
 class Pipeline;
 class SampleUI;
+class EncoderSink;
+class SettingsWriter;
+class SharedMemorySink;
 
 class Sample : public QWidget
 {
@@ -22,7 +26,14 @@ public:
 
 public slots:
 	void onCameraPicked(const QString& cameraName);
-	void setCameraScale(const QSize& scale);
+	void setProcessingScale(const QSize& scale);
+	void setFrameRateCap(double fps);
+	void setStaticSceneThreshold(double threshold);
+	void toggleRawRecording(bool checked);
+	void onRawRecordingFinished(bool written);
+	void openRawRecording();
+	void toggleSharedMemoryOutput(bool checked);
+	void toggleOutputRecording(bool checked);
 	void toggleBlurEnabled();
 	void toggleDenoiseEnabled();
 	void toggleDenoiseWithFaceClicked();
@@ -50,6 +61,8 @@ public slots:
 	void onColorLUTFileNotFoundError(const QString& fileName);
 	void onLowLightAdjustmentPowerSliderMoved();
 	void onSharpeningPowerSliderMoved();
+	void onEffectReady(Effect effect);
+	void onEffectFailed(Effect effect);
 
 private:
 	void updateUIState();
@@ -69,7 +82,11 @@ private:
 private:
 	SampleUI* const m_ui;
 	std::shared_ptr<Pipeline> m_pipeline;
-	std::unique_ptr<QSettings> m_settings;
+	std::unique_ptr<SettingsWriter> m_settings;
+	std::shared_ptr<SharedMemorySink> m_sharedMemorySink;
+	std::shared_ptr<EncoderSink> m_encoderSink;
+	// Stopped recordings until their encode thread closed the file.
+	std::vector<std::shared_ptr<EncoderSink>> m_finishingEncoderSinks;
 
 	QTimer m_updateMetricsTimer;
 
@@ -97,7 +97,7 @@ void SampleUI::createUI()
 #endif
 
 	auto cameraScaleLabel = new QHBoxLayout;
-	cameraScaleLabel->addWidget(new QLabel("Camera scale"));
+	cameraScaleLabel->addWidget(new QLabel("Processing scale"));
 	cameraScaleComoBox = new QComboBox(m_sample);
 	cameraScaleLabel->addWidget(cameraScaleComoBox, 1);
 	cameraScaleComoBox->addItem("2160p", QSize(3840, 2160));
@@ -111,10 +111,73 @@ void SampleUI::createUI()
 		cameraScaleComoBox, QOverload<int>::of(&QComboBox::activated),
 		this, [this](int index) {
 			QSize size = cameraScaleComoBox->itemData(index).toSize();
-			m_sample->setCameraScale(size);
+			m_sample->setProcessingScale(size);
 	});
 	controlsLayout->addLayout(cameraScaleLabel);
 
+	auto frameRateCapLabel = new QHBoxLayout;
+	frameRateCapLabel->addWidget(new QLabel("Frame rate cap"));
+	frameRateCapComboBox = new QComboBox(m_sample);
+	frameRateCapLabel->addWidget(frameRateCapComboBox, 1);
+	frameRateCapComboBox->addItem("Off", 0.0);
+	frameRateCapComboBox->addItem("60 fps", 60.0);
+	frameRateCapComboBox->addItem("30 fps", 30.0);
+	frameRateCapComboBox->addItem("24 fps", 24.0);
+	frameRateCapComboBox->addItem("15 fps", 15.0);
+	connect(
+		frameRateCapComboBox, QOverload<int>::of(&QComboBox::activated),
+		this, [this](int index) {
+			m_sample->setFrameRateCap(frameRateCapComboBox->itemData(index).toDouble());
+	});
+	controlsLayout->addLayout(frameRateCapLabel);
+
+	auto staticSceneLabel = new QHBoxLayout;
+	staticSceneLabel->addWidget(new QLabel("Static scene reuse"));
+	staticSceneComboBox = new QComboBox(m_sample);
+	staticSceneLabel->addWidget(staticSceneComboBox, 1);
+	staticSceneComboBox->addItem("Off", 0.0);
+	staticSceneComboBox->addItem("Strict", 2.0);
+	staticSceneComboBox->addItem("Balanced", 4.0);
+	staticSceneComboBox->addItem("Aggressive", 8.0);
+	connect(
+		staticSceneComboBox, QOverload<int>::of(&QComboBox::activated),
+		this, [this](int index) {
+			m_sample->setStaticSceneThreshold(staticSceneComboBox->itemData(index).toDouble());
+	});
+	controlsLayout->addLayout(staticSceneLabel);
+
+	auto rawRecordingLayout = new QHBoxLayout;
+	recordRawButton = new QPushButton("Record Raw", m_sample);
+	recordRawButton->setCheckable(true);
+	connect(
+		recordRawButton, &QPushButton::clicked,
+		m_sample, &Sample::toggleRawRecording
+	);
+	rawRecordingLayout->addWidget(recordRawButton);
+	replayRawButton = new QPushButton("Replay Raw", m_sample);
+	connect(
+		replayRawButton, &QPushButton::clicked,
+		m_sample, &Sample::openRawRecording
+	);
+	rawRecordingLayout->addWidget(replayRawButton);
+	recordOutputButton = new QPushButton("Record Output", m_sample);
+	recordOutputButton->setCheckable(true);
+	connect(
+		recordOutputButton, &QPushButton::clicked,
+		m_sample, &Sample::toggleOutputRecording
+	);
+	rawRecordingLayout->addWidget(recordOutputButton);
+	controlsLayout->addLayout(rawRecordingLayout);
+
+#ifndef Q_OS_WINDOWS
+	sharedMemoryCheckBox = new QCheckBox("Shared Memory Output", m_sample);
+	connect(
+		sharedMemoryCheckBox, &QCheckBox::clicked,
+		m_sample, &Sample::toggleSharedMemoryOutput
+	);
+	controlsLayout->addWidget(sharedMemoryCheckBox);
+#endif
+
 	virtualBackgroundBox = new QGroupBox("Virtual Background", m_sample);
 	controlsLayout->addWidget(virtualBackgroundBox);
 	auto vbLayout = new QVBoxLayout(virtualBackgroundBox);
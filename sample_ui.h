@@ -26,6 +26,12 @@ public:
 
 	QComboBox* cameraScaleComoBox = nullptr;
 	QComboBox* cameraComoBox = nullptr;
+	QComboBox* frameRateCapComboBox = nullptr;
+	QComboBox* staticSceneComboBox = nullptr;
+	QPushButton* recordRawButton = nullptr;
+	QPushButton* replayRawButton = nullptr;
+	QPushButton* recordOutputButton = nullptr;
+	QCheckBox* sharedMemoryCheckBox = nullptr;
 
 	QGroupBox* virtualBackgroundBox = nullptr;
 	QCheckBox* blurCheckBox = nullptr;
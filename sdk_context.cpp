@@ -0,0 +1,53 @@
+#include "sdk_context.h"
+
+std::shared_ptr<SdkContext> SdkContext::shared()
+{
+	static std::mutex mutex;
+	static std::weak_ptr<SdkContext> instance;
+
+	std::lock_guard<std::mutex> lock(mutex);
+	std::shared_ptr<SdkContext> context = instance.lock();
+	if (nullptr != context) {
+		return context;
+	}
+	// A failure is not remembered, the next call tries again.
+	context.reset(new SdkContext());
+	if (!context->initialize()) {
+		return nullptr;
+	}
+	instance = context;
+	return context;
+}
+
+SdkContext::SdkContext() = default;
+
+// The factory is released before the library is unloaded.
+SdkContext::~SdkContext() = default;
+
+bool SdkContext::initialize()
+{
+	if (!_handler.isValid()) {
+		return false;
+	}
+
+	_factory.reset(_handler.createSDKFactory());
+	if (nullptr == _factory) {
+		return false;
+	}
+
+	std::unique_ptr<tsvb::IAuthResult, Releaser> authResult;
+	authResult.reset(_factory->auth("CUSTOMER_ID", nullptr, nullptr));
+	return (nullptr != authResult) && (tsvb::AuthStatus::active == authResult->status());
+}
+
+tsvb::IPipeline* SdkContext::createPipeline()
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	return _factory->createPipeline();
+}
+
+tsvb::IFrameFactory* SdkContext::createFrameFactory()
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	return _factory->createFrameFactory();
+}
@@ -0,0 +1,36 @@
+#ifndef SDK_CONTEXT_H
+#define SDK_CONTEXT_H
+
+#include "sdk_library_handler.h"
+#include "sdk_releaser.h"
+
+#include <memory>
+#include <mutex>
+
+// The loaded SDK library and its authorized factory, shared by every
+// VideoFilter of the process, so several pipelines, e.g. the workers of the
+// batch mode, load and authorize the SDK once.
+class SdkContext
+{
+public:
+	// Returns the context of the process, or nullptr when the library fails
+	// to load or to authorize. The context lives while anyone holds it.
+	static std::shared_ptr<SdkContext> shared();
+
+	~SdkContext();
+
+	// Each pipeline is independent and is used by one thread at a time.
+	tsvb::IPipeline* createPipeline();
+	tsvb::IFrameFactory* createFrameFactory();
+
+private:
+	SdkContext();
+	bool initialize();
+
+private:
+	std::mutex _mutex;
+	BGLibraryHandler _handler;
+	std::unique_ptr<tsvb::ISDKFactory, Releaser> _factory;
+};
+
+#endif
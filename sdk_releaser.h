@@ -0,0 +1,16 @@
+#ifndef SDK_RELEASER_H
+#define SDK_RELEASER_H
+
+#include <vb_sdk/sdk_factory.h>
+
+// Deleter for smart pointers holding objects created by the SDK.
+class Releaser
+{
+public:
+	void operator()(tsvb::IRelease* object)
+	{
+		object->release();
+	}
+};
+
+#endif
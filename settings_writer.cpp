@@ -0,0 +1,105 @@
+#include "settings_writer.h"
+
+static const int flushDelayMs = 500;
+
+SettingsWriter::SettingsWriter(const QString& filePath)
+	: m_filePath(filePath)
+{
+	{
+		// QSettings syncs on the thread which created it, so the one which
+		// writes is created by the writer thread.
+		QSettings settings(m_filePath, QSettings::Format::IniFormat);
+		m_writable = settings.isWritable();
+		for (const auto& key : settings.allKeys()) {
+			m_values.insert(key, settings.value(key));
+		}
+	}
+
+	m_flushTimer.setSingleShot(true);
+	m_flushTimer.setInterval(flushDelayMs);
+	QObject::connect(&m_flushTimer, &QTimer::timeout, [this] { flush(); });
+
+	m_writerThread = std::thread([this] { writeLoop(); });
+}
+
+SettingsWriter::~SettingsWriter()
+{
+	m_flushTimer.stop();
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_flushRequested = true;
+		m_stopRequested = true;
+	}
+	m_condition.notify_one();
+	if (m_writerThread.joinable()) {
+		m_writerThread.join();
+	}
+}
+
+bool SettingsWriter::isWritable() const
+{
+	return m_writable;
+}
+
+QVariant SettingsWriter::value(const QString& key, const QVariant& defaultValue) const
+{
+	return m_values.value(key, defaultValue);
+}
+
+void SettingsWriter::setValue(const QString& key, const QVariant& value)
+{
+	m_values.insert(key, value);
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_pendingChanges.insert(key, value);
+	}
+	m_flushTimer.start();
+}
+
+void SettingsWriter::remove(const QString& key)
+{
+	m_values.remove(key);
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_pendingChanges.insert(key, QVariant());
+	}
+	m_flushTimer.start();
+}
+
+void SettingsWriter::flush()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_flushRequested = true;
+	}
+	m_condition.notify_one();
+}
+
+void SettingsWriter::writeLoop()
+{
+	QSettings settings(m_filePath, QSettings::Format::IniFormat);
+	bool stop = false;
+	while (!stop) {
+		QVariantMap changes;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_condition.wait(lock, [this] { return m_flushRequested; });
+			m_flushRequested = false;
+			stop = m_stopRequested;
+			std::swap(changes, m_pendingChanges);
+		}
+		if (changes.isEmpty()) {
+			continue;
+		}
+
+		for (auto it = changes.cbegin(); it != changes.cend(); ++it) {
+			if (it.value().isValid()) {
+				settings.setValue(it.key(), it.value());
+			}
+			else {
+				settings.remove(it.key());
+			}
+		}
+		settings.sync();
+	}
+}
@@ -0,0 +1,49 @@
+#ifndef SETTINGS_WRITER_H
+#define SETTINGS_WRITER_H
+
+#include <QSettings>
+#include <QTimer>
+#include <QVariantMap>
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+// Keeps the settings in memory and writes changes to the INI file on a
+// background thread once the changes stop coming for a while, and on exit.
+// The GUI thread never touches the file after construction, the QSettings
+// which writes it belongs to the writer thread.
+class SettingsWriter
+{
+public:
+	explicit SettingsWriter(const QString& filePath);
+	~SettingsWriter();
+
+	bool isWritable() const;
+
+	QVariant value(const QString& key, const QVariant& defaultValue = QVariant()) const;
+	void setValue(const QString& key, const QVariant& value);
+	void remove(const QString& key);
+
+	void flush();
+
+private:
+	void writeLoop();
+
+private:
+	const QString m_filePath;
+	QVariantMap m_values;
+	QTimer m_flushTimer;
+	bool m_writable = false;
+
+	std::mutex m_mutex;
+	std::condition_variable m_condition;
+	// An invalid value marks a removed key.
+	QVariantMap m_pendingChanges;
+	bool m_flushRequested = false;
+	bool m_stopRequested = false;
+
+	std::thread m_writerThread;
+};
+
+#endif
@@ -0,0 +1,158 @@
+#include "shared_memory_sink.h"
+
+#include <QtGlobal>
+
+#include <cerrno>
+#include <cstring>
+#include <new>
+
+#if defined(Q_OS_LINUX) || defined(Q_OS_MACOS)
+#define SHARED_MEMORY_SINK_SUPPORTED
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#ifdef Q_OS_LINUX
+#include <climits>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2, "Shared atomics must be lock free");
+static_assert(ATOMIC_INT_LOCK_FREE == 2, "Shared atomics must be lock free");
+
+static const uint64_t pixelsAlignment = 64;
+
+static uint64_t alignUp(uint64_t value, uint64_t alignment)
+{
+	return (value + alignment - 1) / alignment * alignment;
+}
+
+SharedMemorySink::SharedMemorySink(
+	const std::string& name,
+	int maxWidth,
+	int maxHeight,
+	int slotCount,
+	Metrics* metrics
+)
+	: _name(name)
+	, _metrics(metrics)
+{
+#ifdef SHARED_MEMORY_SINK_SUPPORTED
+	if ((maxWidth <= 0) || (maxHeight <= 0) || (slotCount < 2)) {
+		return;
+	}
+
+	const uint64_t pixelsOffset = alignUp(sizeof(SharedFrameSlotHeader), pixelsAlignment);
+	const uint64_t slotSize = alignUp(pixelsOffset + uint64_t(maxWidth) * 4 * maxHeight, pixelsAlignment);
+	const uint64_t slotsOffset = alignUp(sizeof(SharedFrameRingHeader), pixelsAlignment);
+	_memorySize = static_cast<size_t>(slotsOffset + slotSize * slotCount);
+
+	int fd = shm_open(_name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+	if (-1 == fd) {
+		_nameInUse = (EEXIST == errno);
+		return;
+	}
+	bool resized = (0 == ftruncate(fd, static_cast<off_t>(_memorySize)));
+	void* memory = resized
+		? mmap(nullptr, _memorySize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)
+		: MAP_FAILED;
+	close(fd);
+	if (MAP_FAILED == memory) {
+		shm_unlink(_name.c_str());
+		return;
+	}
+	_memory = memory;
+
+	auto bytes = static_cast<uint8_t*>(_memory);
+	_header = new (bytes) SharedFrameRingHeader();
+	_header->version = SHARED_FRAME_RING_VERSION;
+	_header->slotCount = static_cast<uint32_t>(slotCount);
+	_header->slotSize = slotSize;
+	_header->slotsOffset = slotsOffset;
+	_header->maxWidth = static_cast<uint32_t>(maxWidth);
+	_header->maxHeight = static_cast<uint32_t>(maxHeight);
+	_header->frameCounter = 0;
+	_header->writeSequence = 0;
+	_header->readSequence = 0;
+	for (int i = 0; i < slotCount; ++i) {
+		auto slot = new (bytes + slotsOffset + slotSize * i) SharedFrameSlotHeader();
+		slot->sequence = 0;
+		slot->pixelsOffset = pixelsOffset;
+	}
+	// The magic goes last, consumers wait for it before reading the header.
+	std::atomic_thread_fence(std::memory_order_release);
+	std::memcpy(_header->magic, SHARED_FRAME_RING_MAGIC, sizeof(SHARED_FRAME_RING_MAGIC));
+#else
+	Q_UNUSED(maxWidth);
+	Q_UNUSED(maxHeight);
+	Q_UNUSED(slotCount);
+#endif
+}
+
+SharedMemorySink::~SharedMemorySink()
+{
+#ifdef SHARED_MEMORY_SINK_SUPPORTED
+	if (nullptr != _memory) {
+		munmap(_memory, _memorySize);
+		// Consumers keep their mappings until they close them.
+		shm_unlink(_name.c_str());
+	}
+#endif
+}
+
+bool SharedMemorySink::isValid() const
+{
+	return (nullptr != _header);
+}
+
+bool SharedMemorySink::isNameInUse() const
+{
+	return _nameInUse;
+}
+
+void SharedMemorySink::consume(const QImage& frame, MetricsClock::time_point timestamp)
+{
+	if ((nullptr == _header) || (32 != frame.depth()) ||
+		(frame.width() > int(_header->maxWidth)) ||
+		(frame.height() > int(_header->maxHeight))) {
+		return;
+	}
+
+	auto bytes = static_cast<uint8_t*>(_memory);
+	const uint64_t slotIndex = _frameNumber % _header->slotCount;
+	auto slotBytes = bytes + _header->slotsOffset + _header->slotSize * slotIndex;
+	auto slot = reinterpret_cast<SharedFrameSlotHeader*>(slotBytes);
+
+	slot->sequence.store(2 * _frameNumber + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+
+	const int rowSize = frame.width() * 4;
+	slot->timestampNs =
+		std::chrono::duration_cast<std::chrono::nanoseconds>(timestamp.time_since_epoch()).count();
+	slot->width = static_cast<uint32_t>(frame.width());
+	slot->height = static_cast<uint32_t>(frame.height());
+	slot->bytesPerLine = static_cast<uint32_t>(rowSize);
+	slot->format = frame.hasAlphaChannel() ? SHARED_FRAME_FORMAT_BGRA : SHARED_FRAME_FORMAT_BGRX;
+	uint8_t* pixels = slotBytes + slot->pixelsOffset;
+	for (int y = 0; y < frame.height(); ++y) {
+		std::memcpy(pixels + size_t(y) * rowSize, frame.constScanLine(y), rowSize);
+	}
+
+	slot->sequence.store(2 * _frameNumber + 2, std::memory_order_release);
+	++_frameNumber;
+	_header->writeSequence.store(_frameNumber, std::memory_order_release);
+
+#ifdef Q_OS_LINUX
+	_header->frameCounter.fetch_add(1, std::memory_order_release);
+	syscall(SYS_futex, &_header->frameCounter, FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+#endif
+
+	if (nullptr != _metrics) {
+		_metrics->onSharedFramePublished(
+			_frameNumber,
+			_header->readSequence.load(std::memory_order_acquire)
+		);
+	}
+}
@@ -0,0 +1,92 @@
+#ifndef SHARED_MEMORY_SINK_H
+#define SHARED_MEMORY_SINK_H
+
+#include "frame_sink.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Layout of the shared memory object, consumers include this header too.
+// The object starts with SharedFrameRingHeader, followed by slotCount slots
+// of slotSize bytes each at slotsOffset. A slot is a SharedFrameSlotHeader
+// followed by the pixels at a 64 byte aligned offset.
+//
+// The producer writes the slots in turn. The sequence of a slot is odd while
+// it is being written and 2 * (frame number + 1) once the frame is
+// complete. Consumers read the pixels in place and check that the sequence
+// did not change afterwards, the ring gives them slotCount - 1 frame
+// intervals before the slot is reused. On Linux frameCounter is a futex
+// woken on every frame, elsewhere consumers poll writeSequence.
+// Consumers store the number of the last frame they read to readSequence,
+// the producer reports the difference as the consumer lag.
+
+static const char SHARED_FRAME_RING_MAGIC[8] = { 'T', 'S', 'V', 'B', 'S', 'H', 'M', '1' };
+static const uint32_t SHARED_FRAME_RING_VERSION = 1;
+// 'BGRA' and 'BGRX' little endian fourcc codes.
+static const uint32_t SHARED_FRAME_FORMAT_BGRA = 0x41524742;
+static const uint32_t SHARED_FRAME_FORMAT_BGRX = 0x58524742;
+
+struct SharedFrameRingHeader
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t slotCount;
+	uint64_t slotSize;
+	uint64_t slotsOffset;
+	uint32_t maxWidth;
+	uint32_t maxHeight;
+	std::atomic<uint32_t> frameCounter;
+	uint32_t reserved;
+	// Number of frames published.
+	std::atomic<uint64_t> writeSequence;
+	// Number of the last frame a consumer read.
+	std::atomic<uint64_t> readSequence;
+};
+
+struct SharedFrameSlotHeader
+{
+	std::atomic<uint64_t> sequence;
+	int64_t timestampNs;
+	uint32_t width;
+	uint32_t height;
+	uint32_t bytesPerLine;
+	uint32_t format;
+	uint64_t pixelsOffset;
+};
+
+// Publishes the processed frames to a POSIX shared memory ring, not
+// available on Windows. Frames larger than the size given at creation are
+// skipped. The object is created exclusively and removed again by the
+// destructor, so two producers never share a ring.
+class SharedMemorySink : public FrameSink
+{
+public:
+	SharedMemorySink(
+		const std::string& name,
+		int maxWidth,
+		int maxHeight,
+		int slotCount,
+		Metrics* metrics
+	);
+	~SharedMemorySink() override;
+
+	bool isValid() const;
+	// The object exists already, another producer uses the name or one which
+	// crashed left it behind.
+	bool isNameInUse() const;
+
+	void consume(const QImage& frame, MetricsClock::time_point timestamp) override;
+
+private:
+	const std::string _name;
+	Metrics* const _metrics;
+	void* _memory = nullptr;
+	size_t _memorySize = 0;
+	SharedFrameRingHeader* _header = nullptr;
+	uint64_t _frameNumber = 0;
+	bool _nameInUse = false;
+};
+
+#endif
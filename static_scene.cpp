@@ -0,0 +1,109 @@
+#include "static_scene.h"
+
+#include "allocation_tracker.h"
+#include "pixel_convert.h"
+
+#include <algorithm>
+
+// Wide enough to see a hand move, small enough to cost little next to the SDK.
+static const int analysisWidth = 160;
+static const int tileSize = 8;
+
+void StaticSceneDetector::setThreshold(double threshold)
+{
+	if (!(threshold > 0)) {
+		reset();
+	}
+	_threshold = threshold;
+}
+
+void StaticSceneDetector::setMaxReuseInterval(MetricsClock::duration interval)
+{
+	_maxReuseInterval = interval;
+}
+
+void StaticSceneDetector::reset()
+{
+	_hasLuma = false;
+	_hasReference = false;
+}
+
+bool StaticSceneDetector::isStatic(const QImage& frame, MetricsClock::time_point timestamp)
+{
+	_hasLuma = false;
+	if (!(_threshold > 0) || frame.isNull()) {
+		return false;
+	}
+
+	// A whole multiple of the factor keeps OpenCV on its integer area path.
+	int factor = std::max(1, frame.width() / analysisWidth);
+	cv::Size size(frame.width() / factor, frame.height() / factor);
+	const cv::Mat frameMat(
+		frame.height(),
+		frame.width(),
+		CV_8UC4,
+		const_cast<uchar*>(frame.constBits()),
+		frame.bytesPerLine()
+	);
+	{
+		// Its temporary buffers are allocated inside OpenCV.
+		ExternalAllocationScope externalAllocations;
+		cv::resize(
+			frameMat(cv::Rect(0, 0, size.width * factor, size.height * factor)),
+			_scaled,
+			size,
+			0,
+			0,
+			cv::INTER_AREA
+		);
+	}
+	_luma.create(size, CV_8UC1);
+	convertBGRAToY(
+		_scaled.data,
+		static_cast<int>(_scaled.step),
+		_luma.data,
+		static_cast<int>(_luma.step),
+		size.width,
+		size.height
+	);
+	_hasLuma = true;
+
+	if (!_hasReference || (_referenceLuma.size() != size) ||
+		((timestamp - _referenceTime) > _maxReuseInterval)) {
+		return false;
+	}
+
+	int tileColumns = (size.width + tileSize - 1) / tileSize;
+	int tileRows = (size.height + tileSize - 1) / tileSize;
+	_tileSums.resize(static_cast<size_t>(tileColumns) * tileRows);
+	sumAbsDifference8x8(
+		_luma.data,
+		static_cast<int>(_luma.step),
+		_referenceLuma.data,
+		static_cast<int>(_referenceLuma.step),
+		_tileSums.data(),
+		size.width,
+		size.height
+	);
+	for (int row = 0; row < tileRows; ++row) {
+		int tileHeight = std::min(tileSize, size.height - row * tileSize);
+		for (int column = 0; column < tileColumns; ++column) {
+			int tileWidth = std::min(tileSize, size.width - column * tileSize);
+			if (_tileSums[row * tileColumns + column] > _threshold * tileWidth * tileHeight) {
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+void StaticSceneDetector::acceptFrame(MetricsClock::time_point timestamp)
+{
+	if (!_hasLuma) {
+		return;
+	}
+	cv::swap(_luma, _referenceLuma);
+	_hasLuma = false;
+	_hasReference = true;
+	_referenceTime = timestamp;
+}
@@ -0,0 +1,46 @@
+#ifndef STATIC_SCENE_H
+#define STATIC_SCENE_H
+
+#include "metrics.h"
+
+#include <QImage>
+
+#include <opencv2/opencv.hpp>
+
+#include <vector>
+
+// Tells whether a frame is close enough to the last processed one for its
+// output to be reused. Frames are compared as luma about 160 pixels wide,
+// tile by tile, so a small moving part of a still frame is not averaged
+// away. Not thread safe, used by the pipeline loop.
+class StaticSceneDetector
+{
+public:
+	// The largest mean absolute luma difference of an 8x8 tile for which the
+	// frame is static, zero disables the detection.
+	void setThreshold(double threshold);
+	// The output is not reused for longer than this, so changes below the
+	// threshold which add up over time still get processed.
+	void setMaxReuseInterval(MetricsClock::duration interval);
+	// Forgets the reference, the next frame is processed.
+	void reset();
+
+	// Takes ARGB32 or RGB32 frames.
+	bool isStatic(const QImage& frame, MetricsClock::time_point timestamp);
+	// The frame last passed to isStatic() becomes the reference, called once
+	// its output is there to be reused.
+	void acceptFrame(MetricsClock::time_point timestamp);
+
+private:
+	double _threshold = 0;
+	MetricsClock::duration _maxReuseInterval = std::chrono::milliseconds(500);
+	cv::Mat _scaled;
+	cv::Mat _luma;
+	cv::Mat _referenceLuma;
+	std::vector<uint32_t> _tileSums;
+	bool _hasLuma = false;
+	bool _hasReference = false;
+	MetricsClock::time_point _referenceTime;
+};
+
+#endif
@@ -0,0 +1,175 @@
+#include "image_pool.h"
+#include "metrics.h"
+
+#include <QImage>
+
+#include <algorithm>
+#include <cstdio>
+#include <set>
+#include <vector>
+
+// Checks that the buffers of the frame path are reused at a steady frame
+// rate: the image pools and the frame time histories of the metrics.
+
+static int failureCount = 0;
+
+static void check(bool condition, const char* test, const char* description)
+{
+	if (!condition) {
+		std::printf("FAIL %s: %s\n", test, description);
+		++failureCount;
+	}
+}
+
+static const QSize frameSize(64, 48);
+
+static void fill(const QImage& image, uchar value)
+{
+	for (int y = 0; y < image.height(); ++y) {
+		uchar* row = ImagePool::pixels(image) + y * image.bytesPerLine();
+		std::fill(row, row + image.width() * 4, value);
+	}
+}
+
+// The cache key changes with every new image data, unlike its address which
+// the allocator may hand out again.
+static void testReuseOfDroppedImage()
+{
+	const char* test = "image pool reuses a dropped image";
+	ImagePool pool;
+	qint64 firstKey = 0;
+	{
+		QImage image = pool.acquire(frameSize, QImage::Format_ARGB32);
+		firstKey = image.cacheKey();
+		fill(image, 0x11);
+	}
+	QImage image = pool.acquire(frameSize, QImage::Format_ARGB32);
+	check(image.cacheKey() == firstKey, test, "a new image instead of the dropped one");
+	check(image.size() == frameSize, test, "wrong size");
+	check(QImage::Format_ARGB32 == image.format(), test, "wrong format");
+}
+
+static void testHeldImageIsKept()
+{
+	const char* test = "image pool keeps an image still held";
+	ImagePool pool;
+	QImage held = pool.acquire(frameSize, QImage::Format_ARGB32);
+	fill(held, 0x11);
+	// A copy, e.g. by the view, holds it as well.
+	QImage shown = held;
+	held = QImage();
+
+	QImage next = pool.acquire(frameSize, QImage::Format_ARGB32);
+	check(next.cacheKey() != shown.cacheKey(), test, "the held image was handed out again");
+	fill(next, 0x22);
+	check(0x11 == shown.constBits()[0], test, "the held image was overwritten");
+}
+
+static void testFormatChange()
+{
+	const char* test = "image pool follows a size or format change";
+	ImagePool pool;
+	pool.acquire(frameSize, QImage::Format_ARGB32);
+	QImage image = pool.acquire(QSize(32, 24), QImage::Format_ARGB32);
+	check(QSize(32, 24) == image.size(), test, "wrong size");
+	image = pool.acquire(QSize(32, 24), QImage::Format_Grayscale8);
+	check(QImage::Format_Grayscale8 == image.format(), test, "wrong format");
+}
+
+// Every frame is acquired and written, the view keeps the last one until the
+// next frame replaces it.
+static void testSteadyImageRate()
+{
+	const char* test = "image pool at a steady rate";
+	ImagePool pool;
+	QImage shown;
+	std::set<qint64> keys;
+	bool shownKept = true;
+	for (int frame = 0; frame < 100; ++frame) {
+		QImage image = pool.acquire(frameSize, QImage::Format_ARGB32);
+		shownKept = shownKept && (image.cacheKey() != shown.cacheKey());
+		fill(image, uchar(frame));
+		keys.insert(image.cacheKey());
+		shown = image;
+	}
+	check(shownKept, test, "the shown image was handed out again");
+	check(2 == keys.size(), test, "more buffers than the frame and the shown one");
+}
+
+static void testImagePoolCapacity()
+{
+	const char* test = "image pool beyond its capacity";
+	const size_t capacity = 4;
+	ImagePool pool(capacity);
+	std::vector<QImage> held;
+	std::set<qint64> keys;
+	for (size_t i = 0; i < capacity + 2; ++i) {
+		held.push_back(pool.acquire(frameSize, QImage::Format_ARGB32));
+		keys.insert(held.back().cacheKey());
+	}
+	check(capacity + 2 == keys.size(), test, "an image still held was handed out again");
+
+	std::set<qint64> pooledKeys(keys);
+	held.clear();
+	for (size_t i = 0; i < capacity; ++i) {
+		held.push_back(pool.acquire(frameSize, QImage::Format_ARGB32));
+		pooledKeys.insert(held.back().cacheKey());
+	}
+	check(keys.size() == pooledKeys.size(), test, "the pooled images were not reused");
+}
+
+static FrameTimeInfo frameAt(MetricsClock::time_point timestamp)
+{
+	FrameTimeInfo info;
+	info.timestamp = timestamp;
+	info.duration = std::chrono::milliseconds(5);
+	info.size = QSize(1280, 720);
+	return info;
+}
+
+static void testSteadyHistoryRate()
+{
+	const char* test = "frame time history at a steady rate";
+	const auto maxAge = std::chrono::seconds(1);
+	const auto frameInterval = std::chrono::microseconds(1000000 / 60);
+	FrameTimeHistory history;
+	MetricsClock::time_point timestamp;
+	size_t warmCapacity = 0;
+	for (int frame = 0; frame < 600; ++frame) {
+		timestamp += frameInterval;
+		history.append(frameAt(timestamp), maxAge);
+		if (120 == frame) {
+			warmCapacity = history.capacity();
+		}
+	}
+	check(history.capacity() == warmCapacity, test, "grew after the first seconds");
+	check((history.size() >= 60) && (history.size() <= 61), test, "not a second of frames");
+	check(history.back().timestamp == timestamp, test, "the last frame is not at the back");
+	check((timestamp - history.front().timestamp) <= maxAge, test, "kept an expired frame");
+
+	bool ordered = true;
+	MetricsClock::time_point previous;
+	for (const FrameTimeInfo& info : history) {
+		ordered = ordered && (info.timestamp > previous);
+		previous = info.timestamp;
+	}
+	check(ordered, test, "not oldest first");
+
+	history.clear();
+	check(history.empty(), test, "not empty after clear()");
+	check(history.capacity() == warmCapacity, test, "clear() dropped the capacity");
+}
+
+int main()
+{
+	testReuseOfDroppedImage();
+	testHeldImageIsKept();
+	testFormatChange();
+	testSteadyImageRate();
+	testImagePoolCapacity();
+	testSteadyHistoryRate();
+	if (0 == failureCount) {
+		std::printf("ok\n");
+	}
+	return (0 == failureCount) ? 0 : 1;
+}
@@ -0,0 +1,506 @@
+#include "stream_io.h"
+
+#include "pixel_convert.h"
+
+#include <QByteArray>
+#include <QList>
+#include <QString>
+
+#include <cstring>
+
+#ifdef Q_OS_WINDOWS
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+static const size_t sourceRingSize = 3;
+static const auto pollInterval = std::chrono::milliseconds(10);
+// Longer lines are not Y4M headers.
+static const size_t maxY4mLineLength = 1024;
+
+static std::FILE* openStream(const std::string& path, const char* mode, std::FILE* standardStream, bool& owned)
+{
+	owned = false;
+	if ("-" == path) {
+#ifdef Q_OS_WINDOWS
+		_setmode(_fileno(standardStream), _O_BINARY);
+#endif
+		return standardStream;
+	}
+
+	std::FILE* file = std::fopen(path.c_str(), mode);
+	owned = (nullptr != file);
+	return file;
+}
+
+// Reads up to the end of line, without it.
+static bool readLine(std::FILE* file, QByteArray& line)
+{
+	line.clear();
+	for (int c = std::fgetc(file); EOF != c; c = std::fgetc(file)) {
+		if ('\n' == c) {
+			return true;
+		}
+		if (line.size() >= int(maxY4mLineLength)) {
+			return false;
+		}
+		line.append(char(c));
+	}
+	return false;
+}
+
+static bool readFully(std::FILE* file, uint8_t* data, size_t size)
+{
+	return (std::fread(data, 1, size, file) == size);
+}
+
+static size_t frameDataSize(StreamFormat format, const QSize& size)
+{
+	const size_t pixelCount = size_t(size.width()) * size.height();
+	const size_t chromaCount = size_t((size.width() + 1) / 2) * ((size.height() + 1) / 2);
+	switch (format) {
+	case StreamFormat::bgra:
+		return pixelCount * 4;
+	case StreamFormat::gray:
+		return pixelCount;
+	case StreamFormat::y4m:
+	case StreamFormat::nv12:
+		return pixelCount + chromaCount * 2;
+	}
+	return 0;
+}
+
+bool streamFormatFromName(const QString& name, StreamFormat& format)
+{
+	if ("y4m" == name) {
+		format = StreamFormat::y4m;
+	}
+	else if ("bgra" == name) {
+		format = StreamFormat::bgra;
+	}
+	else if ("nv12" == name) {
+		format = StreamFormat::nv12;
+	}
+	else if ("gray" == name) {
+		format = StreamFormat::gray;
+	}
+	else {
+		return false;
+	}
+	return true;
+}
+
+double StreamFrameRate::fps() const
+{
+	return (denominator > 0) ? double(numerator) / denominator : 0;
+}
+
+StreamSource::StreamSource(
+	const std::string& path,
+	StreamFormat format,
+	const QSize& rawSize,
+	const StreamFrameRate& rawFrameRate
+)
+	: _format(format)
+	, _size(rawSize)
+	, _frameRate(rawFrameRate)
+	, _writeCount(0)
+	, _readCount(0)
+	, _finished(false)
+	, _stopRequested(false)
+{
+	_file = openStream(path, "rb", stdin, _ownsFile);
+	if (nullptr == _file) {
+		return;
+	}
+	// Frames are read whole straight into the buffers.
+	std::setvbuf(_file, nullptr, _IONBF, 0);
+
+	if ((StreamFormat::y4m == _format) && !readY4mHeader()) {
+		return;
+	}
+	if (_size.isEmpty() || (_frameRate.fps() <= 0)) {
+		return;
+	}
+
+	_input.resize(frameDataSize(_format, _size));
+	_slots.resize(sourceRingSize);
+	for (auto& slot : _slots) {
+		slot.frame.create(_size.height(), _size.width(), CV_8UC4);
+	}
+	_valid = true;
+	_readThread = std::thread([this] { readLoop(); });
+}
+
+StreamSource::~StreamSource()
+{
+	_stopRequested = true;
+	_condition.notify_all();
+	if (_readThread.joinable()) {
+		_readThread.join();
+	}
+	if (_ownsFile) {
+		std::fclose(_file);
+	}
+}
+
+bool StreamSource::isValid() const
+{
+	return _valid;
+}
+
+double StreamSource::frameRate() const
+{
+	return _frameRate.fps();
+}
+
+bool StreamSource::atEnd() const
+{
+	return _finished && (_writeCount.load(std::memory_order_acquire) <= _readCount.load());
+}
+
+QSize StreamSource::frameSize() const
+{
+	return _size;
+}
+
+StreamFrameRate StreamSource::streamFrameRate() const
+{
+	return _frameRate;
+}
+
+bool StreamSource::readY4mHeader()
+{
+	QByteArray line;
+	if (!readLine(_file, line)) {
+		return false;
+	}
+	QList<QByteArray> fields = line.split(' ');
+	if (fields.isEmpty() || ("YUV4MPEG2" != fields.first())) {
+		return false;
+	}
+
+	for (const auto& field : fields) {
+		if (field.isEmpty()) {
+			continue;
+		}
+		QByteArray value = field.mid(1);
+		switch (field[0]) {
+		case 'W':
+			_size.setWidth(value.toInt());
+			break;
+		case 'H':
+			_size.setHeight(value.toInt());
+			break;
+		case 'F': {
+			QList<QByteArray> parts = value.split(':');
+			if (2 == parts.size()) {
+				_frameRate.numerator = parts[0].toInt();
+				_frameRate.denominator = parts[1].toInt();
+			}
+			break;
+		}
+		case 'C':
+			// The 8 bit 4:2:0 variants have the same planes, only the chroma siting differs.
+			if (("420" != value) && ("420jpeg" != value) && ("420mpeg2" != value) && ("420paldv" != value)) {
+				return false;
+			}
+			break;
+		case 'I':
+			if (("p" != value) && ("?" != value)) {
+				return false;
+			}
+			break;
+		default:
+			break;
+		}
+	}
+	return true;
+}
+
+bool StreamSource::readFrame(Slot& slot)
+{
+	if (StreamFormat::y4m == _format) {
+		QByteArray line;
+		if (!readLine(_file, line) || !line.startsWith("FRAME")) {
+			return false;
+		}
+	}
+	if (!readFully(_file, _input.data(), _input.size())) {
+		return false;
+	}
+
+	const int width = _size.width();
+	const int height = _size.height();
+	const int chromaWidth = (width + 1) / 2;
+	const int chromaHeight = (height + 1) / 2;
+	uint8_t* dst = slot.frame.data;
+	const int dstBytesPerLine = static_cast<int>(slot.frame.step);
+	switch (_format) {
+	case StreamFormat::bgra:
+		convertBGRXToBGRA(_input.data(), width * 4, dst, dstBytesPerLine, width, height);
+		break;
+	case StreamFormat::nv12:
+		convertNV12ToBGRA(
+			_input.data(), width,
+			_input.data() + size_t(width) * height, chromaWidth * 2,
+			dst, dstBytesPerLine,
+			width, height
+		);
+		break;
+	case StreamFormat::gray: {
+		const cv::Mat gray(height, width, CV_8UC1, _input.data());
+		cv::cvtColor(gray, slot.frame, cv::COLOR_GRAY2BGRA);
+		break;
+	}
+	case StreamFormat::y4m: {
+		// I420 planes, the chroma is interleaved to use the NV12 conversion.
+		const size_t chromaCount = size_t(chromaWidth) * chromaHeight;
+		const uint8_t* u = _input.data() + size_t(width) * height;
+		const uint8_t* v = u + chromaCount;
+		_interleavedUV.resize(chromaCount * 2);
+		for (size_t i = 0; i < chromaCount; ++i) {
+			_interleavedUV[2 * i] = u[i];
+			_interleavedUV[2 * i + 1] = v[i];
+		}
+		convertNV12ToBGRA(
+			_input.data(), width,
+			_interleavedUV.data(), chromaWidth * 2,
+			dst, dstBytesPerLine,
+			width, height
+		);
+		break;
+	}
+	}
+
+	slot.position = std::chrono::duration_cast<MetricsClock::duration>(
+		std::chrono::duration<double>(_frameNumber / _frameRate.fps())
+	);
+	++_frameNumber;
+	return true;
+}
+
+void StreamSource::readLoop()
+{
+	// The slot of the frame the pipeline holds is only released by its next read.
+	const uint64_t capacity = _slots.size();
+	while (!_stopRequested) {
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+			_condition.wait_for(lock, pollInterval, [this, capacity] {
+				return _stopRequested || (_writeCount - _readCount < capacity);
+			});
+		}
+		uint64_t writeCount = _writeCount.load(std::memory_order_relaxed);
+		if (_stopRequested || (writeCount - _readCount.load(std::memory_order_acquire) >= capacity)) {
+			continue;
+		}
+
+		if (!readFrame(_slots[writeCount % _slots.size()])) {
+			_finished = true;
+			_condition.notify_all();
+			return;
+		}
+		_writeCount.store(writeCount + 1, std::memory_order_release);
+		_condition.notify_all();
+	}
+}
+
+bool StreamSource::read(cv::Mat& frame, MetricsClock::duration& position)
+{
+	if (!_valid) {
+		return false;
+	}
+
+	uint64_t readCount = _readCount.load(std::memory_order_relaxed);
+	if (_holdsFrame) {
+		_holdsFrame = false;
+		++readCount;
+		_readCount.store(readCount, std::memory_order_release);
+		_condition.notify_all();
+	}
+
+	std::unique_lock<std::mutex> lock(_mutex);
+	while ((_writeCount.load(std::memory_order_acquire) <= readCount) && !_finished) {
+		_condition.wait_for(lock, pollInterval);
+	}
+	if (_writeCount.load(std::memory_order_acquire) <= readCount) {
+		return false;
+	}
+
+	const Slot& slot = _slots[readCount % _slots.size()];
+	frame = slot.frame;
+	position = slot.position;
+	_holdsFrame = true;
+	return true;
+}
+
+StreamSink::StreamSink(const std::string& path, StreamFormat format, const StreamFrameRate& frameRate)
+	: _format(format)
+	, _frameRate(frameRate)
+{
+	_file = openStream(path, "wb", stdout, _ownsFile);
+	if (nullptr == _file) {
+		_failed = true;
+		return;
+	}
+	std::setvbuf(_file, nullptr, _IONBF, 0);
+	_writeThread = std::thread([this] { writeLoop(); });
+}
+
+StreamSink::~StreamSink()
+{
+	finish();
+}
+
+bool StreamSink::isValid() const
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	return !_failed;
+}
+
+bool StreamSink::finish()
+{
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_stopRequested = true;
+	}
+	_condition.notify_all();
+	if (_writeThread.joinable()) {
+		_writeThread.join();
+	}
+
+	if (nullptr != _file) {
+		bool flushed = (0 == (_ownsFile ? std::fclose(_file) : std::fflush(_file)));
+		_file = nullptr;
+		std::lock_guard<std::mutex> lock(_mutex);
+		_failed = _failed || !flushed;
+	}
+	return isValid();
+}
+
+void StreamSink::consume(const QImage& frame, MetricsClock::time_point timestamp)
+{
+	Q_UNUSED(timestamp);
+	const bool mono = (QImage::Format_Grayscale8 == frame.format());
+	const bool supported = mono
+		? ((StreamFormat::y4m == _format) || (StreamFormat::gray == _format))
+		: ((32 == frame.depth()) && (StreamFormat::gray != _format));
+	if (!supported) {
+		return;
+	}
+
+	const int index = _nextBuffer;
+	{
+		std::unique_lock<std::mutex> lock(_mutex);
+		_condition.wait(lock, [this, index] { return _failed || _stopRequested || !_bufferQueued[index]; });
+		if (_failed || _stopRequested) {
+			return;
+		}
+	}
+
+	std::vector<uint8_t>& buffer = _buffers[index];
+	size_t headerSize = 0;
+	if (_size.isEmpty()) {
+		_size = frame.size();
+		_mono = mono;
+		if (StreamFormat::y4m == _format) {
+			QByteArray streamHeader = QString("YUV4MPEG2 W%1 H%2 F%3:%4 Ip A1:1 %5\n")
+				.arg(_size.width())
+				.arg(_size.height())
+				.arg(_frameRate.numerator)
+				.arg(_frameRate.denominator)
+				.arg(QLatin1String(_mono ? "Cmono" : "C420jpeg"))
+				.toLatin1();
+			headerSize = size_t(streamHeader.size());
+			buffer.resize(headerSize);
+			std::memcpy(buffer.data(), streamHeader.constData(), headerSize);
+		}
+	}
+	if ((frame.size() != _size) || (mono != _mono)) {
+		return;
+	}
+
+	static const char frameHeader[] = "FRAME\n";
+	if (StreamFormat::y4m == _format) {
+		buffer.resize(headerSize + sizeof(frameHeader) - 1);
+		std::memcpy(buffer.data() + headerSize, frameHeader, sizeof(frameHeader) - 1);
+		headerSize = buffer.size();
+	}
+	buffer.resize(headerSize + frameDataSize(_mono ? StreamFormat::gray : _format, _size));
+
+	const int width = _size.width();
+	const int height = _size.height();
+	const int chromaWidth = (width + 1) / 2;
+	const int chromaHeight = (height + 1) / 2;
+	uint8_t* data = buffer.data() + headerSize;
+	switch (_mono ? StreamFormat::gray : _format) {
+	case StreamFormat::gray:
+	case StreamFormat::bgra: {
+		const size_t rowSize = size_t(width) * (_mono ? 1 : 4);
+		for (int y = 0; y < height; ++y) {
+			std::memcpy(data + y * rowSize, frame.constScanLine(y), rowSize);
+		}
+		break;
+	}
+	case StreamFormat::nv12:
+		convertBGRAToNV12(
+			frame.constBits(), frame.bytesPerLine(),
+			data, width,
+			data + size_t(width) * height, chromaWidth * 2,
+			width, height
+		);
+		break;
+	case StreamFormat::y4m: {
+		uint8_t* u = data + size_t(width) * height;
+		uint8_t* v = u + size_t(chromaWidth) * chromaHeight;
+		convertBGRAToI420(
+			frame.constBits(), frame.bytesPerLine(),
+			data, width,
+			u, chromaWidth,
+			v, chromaWidth,
+			width, height
+		);
+		break;
+	}
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_bufferSizes[index] = buffer.size();
+		_bufferQueued[index] = true;
+	}
+	_condition.notify_all();
+	_nextBuffer = 1 - index;
+}
+
+void StreamSink::writeLoop()
+{
+	int index = 0;
+	while (true) {
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+			_condition.wait(lock, [this, index] { return _stopRequested || _bufferQueued[index]; });
+			if (!_bufferQueued[index]) {
+				break;
+			}
+		}
+
+		// The buffer belongs to this thread until it is released.
+		const size_t size = _bufferSizes[index];
+		bool written = (std::fwrite(_buffers[index].data(), 1, size, _file) == size);
+
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_bufferQueued[index] = false;
+			if (!written) {
+				_failed = true;
+			}
+		}
+		_condition.notify_all();
+		if (!written) {
+			break;
+		}
+		index = 1 - index;
+	}
+}
@@ -0,0 +1,138 @@
+#ifndef STREAM_IO_H
+#define STREAM_IO_H
+
+#include "frame_sink.h"
+#include "frame_source.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Uncompressed video streams for piping through ffmpeg: YUV4MPEG2 with
+// 4:2:0 chroma, or headerless BGRA, NV12 or 8-bit gray frames of a known
+// size. Mattes are written as gray or as Y4M without chroma (Cmono).
+enum class StreamFormat
+{
+	y4m,
+	bgra,
+	nv12,
+	gray
+};
+
+bool streamFormatFromName(const QString& name, StreamFormat& format);
+
+struct StreamFrameRate
+{
+	int numerator = 30;
+	int denominator = 1;
+
+	double fps() const;
+};
+
+// Reads frames from stdin ("-") or a file or FIFO on its own thread, whole
+// frames per read into a ring of reused buffers, and converts them to BGRA
+// there, so reading overlaps the processing of the previous frame.
+class StreamSource : public FrameSource
+{
+public:
+	// The size and frame rate are taken from the header for Y4M.
+	StreamSource(
+		const std::string& path,
+		StreamFormat format,
+		const QSize& rawSize,
+		const StreamFrameRate& rawFrameRate
+	);
+	~StreamSource() override;
+
+	bool isValid() const override;
+	double frameRate() const override;
+	bool atEnd() const override;
+	QSize frameSize() const;
+	StreamFrameRate streamFrameRate() const;
+
+	bool read(cv::Mat& frame, MetricsClock::duration& position) override;
+
+private:
+	struct Slot
+	{
+		cv::Mat frame;
+		MetricsClock::duration position;
+	};
+
+	bool readY4mHeader();
+	bool readFrame(Slot& slot);
+	void readLoop();
+
+private:
+	const StreamFormat _format;
+	std::FILE* _file = nullptr;
+	bool _ownsFile = false;
+	bool _valid = false;
+	QSize _size;
+	StreamFrameRate _frameRate;
+
+	std::vector<Slot> _slots;
+	std::atomic<uint64_t> _writeCount;
+	std::atomic<uint64_t> _readCount;
+	bool _holdsFrame = false;
+
+	std::mutex _mutex;
+	std::condition_variable _condition;
+	std::atomic<bool> _finished;
+	std::atomic<bool> _stopRequested;
+	std::thread _readThread;
+
+	// Used by the read thread only.
+	std::vector<uint8_t> _input;
+	std::vector<uint8_t> _interleavedUV;
+	uint64_t _frameNumber = 0;
+};
+
+// Writes the processed frames to stdout ("-") or a file or FIFO. Frames are
+// converted into one of two output buffers on the pipeline thread and
+// written whole by a writer thread, the pipeline waits when both buffers
+// are still being written. The first frame sets the size and whether the
+// stream carries Grayscale8 mattes, other frames are skipped.
+class StreamSink : public FrameSink
+{
+public:
+	StreamSink(const std::string& path, StreamFormat format, const StreamFrameRate& frameRate);
+	~StreamSink() override;
+
+	// False once opening or writing failed.
+	bool isValid() const;
+	// Writes the frames still buffered, returns false if writing failed.
+	// No frames are accepted afterwards.
+	bool finish();
+
+	void consume(const QImage& frame, MetricsClock::time_point timestamp) override;
+
+private:
+	void writeLoop();
+
+private:
+	const StreamFormat _format;
+	const StreamFrameRate _frameRate;
+	std::FILE* _file = nullptr;
+	bool _ownsFile = false;
+	QSize _size;
+	bool _mono = false;
+
+	std::vector<uint8_t> _buffers[2];
+	size_t _bufferSizes[2] = { 0, 0 };
+	bool _bufferQueued[2] = { false, false };
+	int _nextBuffer = 0;
+
+	mutable std::mutex _mutex;
+	std::condition_variable _condition;
+	bool _stopRequested = false;
+	bool _failed = false;
+	std::thread _writeThread;
+};
+
+#endif
@@ -0,0 +1,292 @@
+#include "stream_mode.h"
+
+#include "allocation_tracker.h"
+#include "effect_options.h"
+#include "matte_compositor.h"
+#include "pipeline.h"
+#include "stream_io.h"
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QTimer>
+
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+
+static const char* streamModeArgument = "--stream";
+// How often a failed output is checked, e.g. a closed pipe.
+static const int sinkCheckIntervalMs = 200;
+static const int defaultCompositeBlurRadius = 16;
+
+static bool parseSize(const QString& value, QSize& size)
+{
+	QStringList parts = value.split('x');
+	if (2 != parts.size()) {
+		return false;
+	}
+	bool widthOk = false;
+	bool heightOk = false;
+	size = QSize(parts[0].toInt(&widthOk), parts[1].toInt(&heightOk));
+	return widthOk && heightOk && !size.isEmpty();
+}
+
+// Takes "30", "29.97" or "30000/1001".
+static bool parseFrameRate(const QString& value, StreamFrameRate& frameRate)
+{
+	QStringList parts = value.split('/');
+	bool ok = false;
+	if (2 == parts.size()) {
+		bool denominatorOk = false;
+		frameRate.numerator = parts[0].toInt(&ok);
+		frameRate.denominator = parts[1].toInt(&denominatorOk);
+		ok = ok && denominatorOk;
+	}
+	else {
+		double fps = value.toDouble(&ok);
+		frameRate.numerator = qRound(fps * 1000);
+		frameRate.denominator = 1000;
+	}
+	return ok && (frameRate.fps() > 0);
+}
+
+// Takes an image path, "blur" or "blur:<radius>" for the blurred camera frame.
+static CompositeOutput parseCompositeBackground(const QString& value)
+{
+	CompositeOutput output;
+	if (("blur" == value) || value.startsWith("blur:")) {
+		output.blurRadius = (value.size() > 5) ? value.mid(5).toInt() : defaultCompositeBlurRadius;
+	}
+	else {
+		output.background = QImage(value);
+	}
+	return output;
+}
+
+static void printError(const QString& message)
+{
+	std::fprintf(stderr, "%s\n", qPrintable(message));
+}
+
+bool isStreamModeRequested(int argc, char* argv[])
+{
+	for (int i = 1; i < argc; ++i) {
+		if (0 == std::strcmp(argv[i], streamModeArgument)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+int runStreamMode(int argc, char* argv[])
+{
+	QCoreApplication app(argc, argv);
+	app.setOrganizationName(TSVB_COMPANY);
+	app.setApplicationName(TSVB_APP_BIN_NAME);
+	app.setApplicationVersion(TSVB_VERSION_STRING);
+
+	QCommandLineParser parser;
+	parser.setApplicationDescription("Applies the effects to an uncompressed video stream.");
+	parser.addHelpOption();
+	parser.addOptions({
+		{ "stream", "Runs without the window." },
+		{ "input", "Input file or FIFO, stdin by default.", "path", "-" },
+		{ "output", "Output file or FIFO, stdout by default.", "path", "-" },
+		{ "input-format", "y4m, bgra, nv12 or gray.", "format", "y4m" },
+		{ "output-format", "y4m, bgra or nv12.", "format", "y4m" },
+		{ "matte-output", "Writes the segmentation matte to the file or FIFO. "
+			"Cannot be combined with --blur or --replace.", "path" },
+		{ "matte-format", "y4m or gray.", "format", "y4m" },
+		{ "composite", "Composites the person over the image, or the blurred camera frame "
+			"with blur[:radius]. Repeated for several composites, each to its --composite-output. "
+			"Cannot be combined with --blur or --replace.", "background" },
+		{ "composite-output", "Output of a composite, in the output format.", "path" },
+		{ "size", "Frame size of bgra and nv12 input.", "WxH" },
+		{ "fps", "Frame rate of bgra and nv12 input, e.g. 30000/1001.", "rate", "30" },
+		{ "allocation-report", "Prints the allocations per frame of each pipeline stage at the end. "
+			"Needs a build with ENABLE_ALLOCATION_TRACKING." },
+		{ "allocation-check", "Fails if the pipeline allocated after the warm-up, "
+			"other than inside the SDK, OpenCV or Qt." },
+	});
+	addEffectOptions(parser);
+	parser.process(app);
+
+	StreamFormat inputFormat;
+	StreamFormat outputFormat;
+	StreamFormat matteFormat;
+	if (!streamFormatFromName(parser.value("input-format"), inputFormat) ||
+		!streamFormatFromName(parser.value("output-format"), outputFormat) ||
+		!streamFormatFromName(parser.value("matte-format"), matteFormat) ||
+		(StreamFormat::gray == outputFormat) ||
+		((StreamFormat::y4m != matteFormat) && (StreamFormat::gray != matteFormat))) {
+		printError("Unknown stream format");
+		return 1;
+	}
+
+	const bool allocationReport = parser.isSet("allocation-report");
+	const bool allocationCheck = parser.isSet("allocation-check");
+	if ((allocationReport || allocationCheck) && !isAllocationTrackingEnabled()) {
+		printError("Allocation tracking is not built in, see ENABLE_ALLOCATION_TRACKING");
+		return 1;
+	}
+
+	// The SDK leaves the background transparent while it exports the matte,
+	// the main output would be neither blurred nor replaced.
+	const bool matteExport = parser.isSet("matte-output") || parser.isSet("composite");
+	if (matteExport && (parser.isSet("blur") || parser.isSet("replace"))) {
+		printError("--matte-output and --composite cannot be combined with --blur or --replace, "
+			"use --composite for the blurred or replaced output");
+		return 1;
+	}
+
+	QSize rawSize;
+	StreamFrameRate rawFrameRate;
+	if (StreamFormat::y4m != inputFormat) {
+		if (!parseSize(parser.value("size"), rawSize)) {
+			printError("--size WxH is required for raw input");
+			return 1;
+		}
+		if (!parseFrameRate(parser.value("fps"), rawFrameRate)) {
+			printError(QString("Invalid frame rate: %1").arg(parser.value("fps")));
+			return 1;
+		}
+	}
+
+#ifndef Q_OS_WINDOWS
+	// A closed output pipe fails the writes instead of killing the process.
+	std::signal(SIGPIPE, SIG_IGN);
+#endif
+
+	std::unique_ptr<StreamSource> source(new StreamSource(
+		parser.value("input").toStdString(),
+		inputFormat,
+		rawSize,
+		rawFrameRate
+	));
+	if (!source->isValid()) {
+		printError("Failed to open the input stream");
+		return 1;
+	}
+	const QSize frameSize = source->frameSize();
+
+	auto sink = std::make_shared<StreamSink>(
+		parser.value("output").toStdString(),
+		outputFormat,
+		source->streamFrameRate()
+	);
+	if (!sink->isValid()) {
+		printError("Failed to open the output stream");
+		return 1;
+	}
+
+	// The main output first, every sink is checked and flushed.
+	std::vector<std::shared_ptr<StreamSink>> sinks = { sink };
+	std::shared_ptr<StreamSink> matteSink;
+	if (parser.isSet("matte-output")) {
+		matteSink = std::make_shared<StreamSink>(
+			parser.value("matte-output").toStdString(),
+			matteFormat,
+			source->streamFrameRate()
+		);
+		if (!matteSink->isValid()) {
+			printError("Failed to open the matte stream");
+			return 1;
+		}
+		sinks.push_back(matteSink);
+	}
+
+	QStringList compositeBackgrounds = parser.values("composite");
+	QStringList compositePaths = parser.values("composite-output");
+	if (compositeBackgrounds.size() != compositePaths.size()) {
+		printError("Every --composite needs its --composite-output");
+		return 1;
+	}
+	std::vector<CompositeOutput> compositeOutputs;
+	for (int i = 0; i < compositeBackgrounds.size(); ++i) {
+		CompositeOutput output = parseCompositeBackground(compositeBackgrounds[i]);
+		if (output.background.isNull() && (output.blurRadius <= 0)) {
+			printError(QString("Invalid composite background: %1").arg(compositeBackgrounds[i]));
+			return 1;
+		}
+		auto compositeSink = std::make_shared<StreamSink>(
+			compositePaths[i].toStdString(),
+			outputFormat,
+			source->streamFrameRate()
+		);
+		if (!compositeSink->isValid()) {
+			printError(QString("Failed to open the composite output: %1").arg(compositePaths[i]));
+			return 1;
+		}
+		output.sink = compositeSink;
+		compositeOutputs.push_back(output);
+		sinks.push_back(compositeSink);
+	}
+
+	std::unique_ptr<Pipeline> pipeline(new Pipeline());
+	if (!pipeline->videoFilter()->isValid()) {
+		printError("Failed to load the SDK");
+		return 1;
+	}
+	if (!applyEffectOptions(parser, pipeline->videoFilter())) {
+		return 1;
+	}
+	if (matteExport) {
+		if (!pipeline->videoFilter()->setMatteExportEnabled(true)) {
+			printError("Failed to enable the matte export");
+			return 1;
+		}
+	}
+	if (nullptr != matteSink) {
+		pipeline->addMatteSink(matteSink);
+	}
+	if (!compositeOutputs.empty()) {
+		pipeline->setMatteCompositor(std::make_shared<MatteCompositor>(std::move(compositeOutputs)));
+	}
+
+	// Every frame is processed at the input size as fast as the output takes it.
+	pipeline->setProcessingSize(frameSize.width(), frameSize.height());
+	pipeline->setViewVisible(false);
+	pipeline->setBenchmarkMode(true);
+	pipeline->addSink(sink);
+	pipeline->setFrameSource(std::move(source));
+	QObject::connect(
+		pipeline.get(), &Pipeline::sourceFinished,
+		&app, &QCoreApplication::quit,
+		Qt::QueuedConnection
+	);
+
+	QTimer sinkCheckTimer;
+	QObject::connect(&sinkCheckTimer, &QTimer::timeout, &app, [&sinks] {
+		for (const auto& streamSink : sinks) {
+			if (!streamSink->isValid()) {
+				QCoreApplication::quit();
+			}
+		}
+	});
+	sinkCheckTimer.start(sinkCheckIntervalMs);
+
+	pipeline->start();
+	app.exec();
+
+	if (allocationReport) {
+		std::fputs(pipeline->allocationReport()->summary().c_str(), stderr);
+	}
+	const uint64_t allocatingFrameCount = pipeline->allocationReport()->steadyStateAllocatingFrameCount();
+
+	// Stops the pipeline thread before the last frames are flushed.
+	pipeline.reset();
+	bool ok = true;
+	for (const auto& streamSink : sinks) {
+		ok = streamSink->finish() && ok;
+	}
+	if (!ok) {
+		printError("Failed to write the output streams");
+		return 1;
+	}
+	if (allocationCheck && (allocatingFrameCount > 0)) {
+		printError(QString("%1 frames allocated after the warm-up").arg(allocatingFrameCount));
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,12 @@
+#ifndef STREAM_MODE_H
+#define STREAM_MODE_H
+
+// Headless filtering of an uncompressed stream, for use in ffmpeg pipes:
+//   ffmpeg -i in.mp4 -f yuv4mpegpipe - | Sample --stream --blur | ffmpeg -i - out.mp4
+// Frames are read from stdin and written to stdout unless --input or
+// --output are given, see --stream --help for the options.
+bool isStreamModeRequested(int argc, char* argv[]);
+// Runs before any QApplication exists, returns the exit code.
+int runStreamMode(int argc, char* argv[]);
+
+#endif
@@ -0,0 +1,149 @@
+#include "system_usage.h"
+
+#include <algorithm>
+#include <thread>
+
+#ifdef Q_OS_WINDOWS
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/resource.h>
+#endif
+
+#ifdef Q_OS_LINUX
+#include <QFile>
+#include <QStringList>
+#endif
+
+#ifdef Q_OS_MACOS
+#include <mach/mach.h>
+#endif
+
+#ifdef Q_OS_WINDOWS
+static uint64_t fileTimeTicks(const FILETIME& time)
+{
+	return (static_cast<uint64_t>(time.dwHighDateTime) << 32) | time.dwLowDateTime;
+}
+#endif
+
+MetricsClock::duration processCpuTime()
+{
+#ifdef Q_OS_WINDOWS
+	FILETIME creationTime, exitTime, kernelTime, userTime;
+	if (!GetProcessTimes(GetCurrentProcess(), &creationTime, &exitTime, &kernelTime, &userTime)) {
+		return MetricsClock::duration::zero();
+	}
+	using FileTimeDuration = std::chrono::duration<uint64_t, std::ratio<1, 10000000>>;
+	return std::chrono::duration_cast<MetricsClock::duration>(
+		FileTimeDuration(fileTimeTicks(kernelTime) + fileTimeTicks(userTime))
+	);
+#else
+	rusage usage = {};
+	if (0 != getrusage(RUSAGE_SELF, &usage)) {
+		return MetricsClock::duration::zero();
+	}
+	auto time = std::chrono::seconds(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) +
+		std::chrono::microseconds(usage.ru_utime.tv_usec + usage.ru_stime.tv_usec);
+	return std::chrono::duration_cast<MetricsClock::duration>(time);
+#endif
+}
+
+bool systemCpuTimes(uint64_t& busy, uint64_t& total)
+{
+#if defined(Q_OS_WINDOWS)
+	FILETIME idleTime, kernelTime, userTime;
+	if (!GetSystemTimes(&idleTime, &kernelTime, &userTime)) {
+		return false;
+	}
+	// The kernel time includes the idle time.
+	total = fileTimeTicks(kernelTime) + fileTimeTicks(userTime);
+	busy = total - fileTimeTicks(idleTime);
+	return true;
+#elif defined(Q_OS_LINUX)
+	// "cpu user nice system idle iowait irq softirq steal ..." in clock ticks.
+	QFile file("/proc/stat");
+	if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+		return false;
+	}
+	QStringList fields = QString::fromLatin1(file.readLine()).simplified().split(' ');
+	if ((fields.size() < 5) || ("cpu" != fields[0])) {
+		return false;
+	}
+	total = 0;
+	uint64_t idle = 0;
+	for (int i = 1; i < std::min(int(fields.size()), 9); ++i) {
+		uint64_t value = fields[i].toULongLong();
+		total += value;
+		if ((4 == i) || (5 == i)) {
+			idle += value;
+		}
+	}
+	busy = total - idle;
+	return true;
+#elif defined(Q_OS_MACOS)
+	host_cpu_load_info_data_t info;
+	mach_msg_type_number_t count = HOST_CPU_LOAD_INFO_COUNT;
+	if (KERN_SUCCESS != host_statistics(
+		mach_host_self(),
+		HOST_CPU_LOAD_INFO,
+		reinterpret_cast<host_info_t>(&info),
+		&count
+	)) {
+		return false;
+	}
+	busy = uint64_t(info.cpu_ticks[CPU_STATE_USER]) +
+		info.cpu_ticks[CPU_STATE_SYSTEM] +
+		info.cpu_ticks[CPU_STATE_NICE];
+	total = busy + info.cpu_ticks[CPU_STATE_IDLE];
+	return true;
+#else
+	Q_UNUSED(busy);
+	Q_UNUSED(total);
+	return false;
+#endif
+}
+
+uint64_t availableMemoryBytes()
+{
+#if defined(Q_OS_WINDOWS)
+	MEMORYSTATUSEX status = {};
+	status.dwLength = sizeof(status);
+	if (!GlobalMemoryStatusEx(&status)) {
+		return 0;
+	}
+	return status.ullAvailPhys;
+#elif defined(Q_OS_LINUX)
+	QFile file("/proc/meminfo");
+	if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+		return 0;
+	}
+	// "MemAvailable:   12345678 kB"
+	while (!file.atEnd()) {
+		QStringList fields = QString::fromLatin1(file.readLine()).simplified().split(' ');
+		if ((fields.size() >= 2) && ("MemAvailable:" == fields[0])) {
+			return fields[1].toULongLong() * 1024;
+		}
+	}
+	return 0;
+#elif defined(Q_OS_MACOS)
+	vm_statistics64_data_t stats;
+	mach_msg_type_number_t count = HOST_VM_INFO64_COUNT;
+	if (KERN_SUCCESS != host_statistics64(
+		mach_host_self(),
+		HOST_VM_INFO64,
+		reinterpret_cast<host_info64_t>(&stats),
+		&count
+	)) {
+		return 0;
+	}
+	uint64_t pages = uint64_t(stats.free_count) + stats.inactive_count + stats.purgeable_count;
+	return pages * vm_kernel_page_size;
+#else
+	return 0;
+#endif
+}
+
+int logicalCoreCount()
+{
+	return std::max(1, int(std::thread::hardware_concurrency()));
+}
@@ -0,0 +1,21 @@
+#ifndef SYSTEM_USAGE_H
+#define SYSTEM_USAGE_H
+
+#include "metrics.h"
+
+#include <cstdint>
+
+// CPU time used by all threads of the process so far.
+MetricsClock::duration processCpuTime();
+
+// Busy and total CPU time of the whole machine summed over all cores since
+// boot, in the units of the platform. Only the ratio of two deltas is
+// meaningful. Returns false when the platform does not report it.
+bool systemCpuTimes(uint64_t& busy, uint64_t& total);
+
+// Memory available to new processes without swapping, 0 when unknown.
+uint64_t availableMemoryBytes();
+
+int logicalCoreCount();
+
+#endif
@@ -0,0 +1,83 @@
+#include "video_chunks.h"
+
+#include <opencv2/opencv.hpp>
+
+#include <algorithm>
+
+// Raw packets and their keyframe flag are available since OpenCV 4.6.
+#if (CV_VERSION_MAJOR > 4) || ((CV_VERSION_MAJOR == 4) && (CV_VERSION_MINOR >= 6))
+#define VIDEO_CHUNKS_KEYFRAMES
+#endif
+
+bool indexVideo(const std::string& filePath, VideoIndex& index)
+{
+	index = VideoIndex();
+	{
+		cv::VideoCapture capture(filePath);
+		if (!capture.isOpened()) {
+			return false;
+		}
+		index.fps = capture.get(cv::CAP_PROP_FPS);
+		index.frameCount = std::max<int64_t>(0, int64_t(capture.get(cv::CAP_PROP_FRAME_COUNT)));
+	}
+
+#ifdef VIDEO_CHUNKS_KEYFRAMES
+	cv::VideoCapture capture(filePath, cv::CAP_FFMPEG);
+	// Every grab() reads one packet of the video stream then.
+	if (!capture.isOpened() || !capture.set(cv::CAP_PROP_FORMAT, -1)) {
+		return true;
+	}
+	int64_t packetCount = 0;
+	std::vector<int64_t> keyframes;
+	while (capture.grab()) {
+		if (0 != capture.get(cv::CAP_PROP_LRF_HAS_KEY_FRAME)) {
+			keyframes.push_back(packetCount);
+		}
+		++packetCount;
+	}
+	if (packetCount > 0) {
+		index.frameCount = packetCount;
+		index.keyframes = std::move(keyframes);
+	}
+#endif
+	return true;
+}
+
+std::vector<VideoChunk> planVideoChunks(
+	const VideoIndex& index,
+	int chunkCount,
+	int64_t minChunkFrames,
+	int64_t overlapFrames
+)
+{
+	std::vector<VideoChunk> chunks;
+	if (index.frameCount <= 0) {
+		// Unknown length, the whole file in one chunk.
+		chunks.push_back(VideoChunk());
+		return chunks;
+	}
+
+	int64_t chunkFrames = (index.frameCount + std::max(chunkCount, 1) - 1) / std::max(chunkCount, 1);
+	chunkFrames = std::max(chunkFrames, std::max<int64_t>(minChunkFrames, 1));
+	int64_t begin = 0;
+	while (begin < index.frameCount) {
+		int64_t end = begin + chunkFrames;
+		auto keyframe = std::lower_bound(index.keyframes.begin(), index.keyframes.end(), end);
+		// Long GOPs keep the even split instead of unbalancing the chunks.
+		if ((index.keyframes.end() != keyframe) && (*keyframe - end < chunkFrames / 2)) {
+			end = *keyframe;
+		}
+		// A short remainder joins the last chunk.
+		if (index.frameCount - end < chunkFrames / 2) {
+			end = index.frameCount;
+		}
+
+		VideoChunk chunk;
+		chunk.warmupFrame = std::max<int64_t>(0, begin - overlapFrames);
+		chunk.beginFrame = begin;
+		chunk.endFrame = (end >= index.frameCount) ? -1 : end;
+		chunks.push_back(chunk);
+		begin = end;
+	}
+	return chunks;
+}
@@ -0,0 +1,44 @@
+#ifndef VIDEO_CHUNKS_H
+#define VIDEO_CHUNKS_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Splitting of one long video into chunks processed on independent pipelines.
+struct VideoChunk
+{
+	// Decoding starts at warmupFrame, the frames before beginFrame only let
+	// the temporal effects settle and are not written.
+	int64_t warmupFrame = 0;
+	int64_t beginFrame = 0;
+	// -1 reads to the end of the file, the frame count of the container is
+	// an estimate.
+	int64_t endFrame = -1;
+};
+
+struct VideoIndex
+{
+	// Counted from the packets when the keyframes are indexed, otherwise the
+	// estimate of the container. 0 when unknown.
+	int64_t frameCount = 0;
+	double fps = 0;
+	// Sorted frame numbers of the keyframes, empty when the OpenCV build
+	// cannot report them. With B-frames the numbers are in decoding order
+	// and may be a few frames off.
+	std::vector<int64_t> keyframes;
+};
+
+// Reads the packets without decoding them.
+bool indexVideo(const std::string& filePath, VideoIndex& index);
+
+// About chunkCount chunks whose boundaries are moved forward to the next
+// keyframe when one is close, so a chunk starts decoding near its keyframe.
+std::vector<VideoChunk> planVideoChunks(
+	const VideoIndex& index,
+	int chunkCount,
+	int64_t minChunkFrames,
+	int64_t overlapFrames
+);
+
+#endif
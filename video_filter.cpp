@@ -2,23 +2,64 @@
 
 #include "vb_sdk/sdk_factory.h"
 
-#include "sdk_library_handler.h"
+#include "allocation_tracker.h"
+#include "animated_background.h"
+#include "background_cache.h"
+#include "image_blur.h"
+#include "image_pool.h"
+#include "pixel_convert.h"
+#include "sdk_context.h"
+#include "sdk_releaser.h"
 
 #include <QtGui/QtGui>
 
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <functional>
 #include <mutex>
+#include <thread>
 
-namespace {
+static const size_t backgroundCacheBudget = 256 * 1024 * 1024;
+static const float defaultBlurPower = 0.5f;
 
-class Releaser
+static int effectBit(Effect effect)
 {
-public:
-	void operator()(tsvb::IRelease* object)
-	{
-		object->release();
+	return 1 << static_cast<int>(effect);
+}
+
+// Decodes the image already downscaled to cover the size (JPEG uses DCT
+// scaling for that) and crops the center to the aspect ratio of the size.
+static QImage readScaledImage(const QString& filePath, const QSize& size)
+{
+	QImageReader reader(filePath);
+	QSize sourceSize = reader.size();
+	if (size.isValid() && sourceSize.isValid()) {
+		QSize scaledSize = sourceSize.scaled(size, Qt::KeepAspectRatioByExpanding);
+		QRect clipRect(
+			(scaledSize.width() - size.width()) / 2,
+			(scaledSize.height() - size.height()) / 2,
+			size.width(),
+			size.height()
+		);
+		reader.setScaledSize(scaledSize);
+		reader.setScaledClipRect(clipRect);
 	}
-};
 
+	QImage image = reader.read();
+	if (image.isNull()) {
+		return QImage();
+	}
+	return image.convertToFormat(QImage::Format_ARGB32);
+}
+
+// Approximates the strength of the SDK blur for the power in range [0, 1].
+static int blurRadius(float power, const QSize& size)
+{
+	float radius = power * 0.03f * float(std::max(size.width(), size.height()));
+	return std::max(1, qRound(radius));
 }
 
 static std::map<Preset, tsvb::SegmentationPreset> makePresetMap()
@@ -31,14 +72,53 @@ static std::map<Preset, tsvb::SegmentationPreset> makePresetMap()
 	};
 }
 
+// Counts a change of the settings once the call made it, so a frame
+// processed meanwhile is not taken for the output of the new settings.
+class SettingsChange
+{
+public:
+	explicit SettingsChange(std::atomic<uint64_t>& generation)
+		: _generation(generation)
+	{ }
+
+	~SettingsChange()
+	{
+		++_generation;
+	}
+
+private:
+	std::atomic<uint64_t>& _generation;
+};
+
 class VideoFilter::Impl
 {
 	mutable std::mutex _mutex;
 	
-	BGLibraryHandler _handler;
+	// Declared first, so the SDK objects below are released before it.
+	std::shared_ptr<SdkContext> _sdkContext;
+	// IFrameFactory is not declared thread-safe. The pipeline thread has a
+	// factory of its own, the other threads share the loader one under its mutex.
 	std::unique_ptr<tsvb::IFrameFactory, Releaser> _frameFactory;
-	std::unique_ptr<tsvb::IFrame, Releaser> _background;
+	std::mutex _loaderFrameFactoryMutex;
+	std::unique_ptr<tsvb::IFrameFactory, Releaser> _loaderFrameFactory;
+	BackgroundCache::FramePtr _background;
+	std::unique_ptr<BackgroundCache> _backgroundCache;
+	QString _backgroundPath;
+	QSize _frameSize;
+	int _backgroundGeneration = 0;
+	std::unique_ptr<AnimatedBackground> _animatedBackground;
+	tsvb::IFrame* _appliedAnimatedFrame = nullptr;
+	Metrics* _metrics = nullptr;
+
+	bool _blurEnabled = false;
+	// When blur and replacement are both enabled the background is blurred once
+	// here and the SDK runs replacement only.
+	bool _staticBlurEnabled = true;
+	BackgroundCache::FramePtr _blurredBackground;
+	std::weak_ptr<tsvb::IFrame> _blurredSource;
 	std::unique_ptr<tsvb::IReplacementController, Releaser> _replacementController;
+	bool _replacementRequested = false;
+	bool _matteExportEnabled = false;
 	std::unique_ptr<tsvb::IPipeline, Releaser> _pipeline;
 
 	bool _beautificationEnabled = false;
@@ -49,37 +129,68 @@ class VideoFilter::Impl
 	bool _lowLightEnabled = false;
 	bool _sharpeningEnabled = false;
 
+	std::function<void(Effect, bool)> _preparedCallback;
+	std::thread _preparationThread;
+	std::mutex _preparationMutex;
+	std::condition_variable _preparationCondition;
+	std::deque<std::function<void()>> _preparationQueue;
+	bool _preparationStopRequested = false;
+	std::atomic<int> _pendingEffects;
+	std::atomic<bool> _effectsEnabled;
+	std::atomic<bool> _backgroundAnimated;
+
+	// Accessed only from the thread which calls replaceBG.
+	QImage _lastOutput;
+	QImage _matte;
+	QImage _convertedInput;
+	ImagePool _outputPool;
+	ImagePool _mattePool;
+
 public:
-	Impl()
+	explicit Impl(std::function<void(Effect, bool)> preparedCallback)
+		: _preparedCallback(std::move(preparedCallback))
+		, _pendingEffects(0)
+		, _effectsEnabled(false)
+		, _backgroundAnimated(false)
 	{ }
 
-	bool initialize()
+	~Impl()
 	{
-		if (!_handler.isValid()) {
-			return false;
+		{
+			std::lock_guard<std::mutex> lock(_preparationMutex);
+			_preparationStopRequested = true;
+			_preparationQueue.clear();
 		}
-
-		std::unique_ptr<tsvb::ISDKFactory, Releaser> factory;
-		factory.reset(_handler.createSDKFactory());
-		if (nullptr == factory) {
-			return false;
+		_preparationCondition.notify_all();
+		if (_preparationThread.joinable()) {
+			_preparationThread.join();
 		}
-		
-		std::unique_ptr<tsvb::IAuthResult, Releaser> authResult;
-		authResult.reset(factory->auth("CUSTOMER_ID", nullptr, nullptr));
-		if (tsvb::AuthStatus::active != authResult->status()) {
+	}
+
+	bool initialize()
+	{
+		_sdkContext = SdkContext::shared();
+		if (nullptr == _sdkContext) {
 			return false;
 		}
-		
-		_frameFactory.reset(factory->createFrameFactory());
-		if (nullptr == _frameFactory) {
+
+		_frameFactory.reset(_sdkContext->createFrameFactory());
+		_loaderFrameFactory.reset(_sdkContext->createFrameFactory());
+		if ((nullptr == _frameFactory) || (nullptr == _loaderFrameFactory)) {
 			return false;
 		}
-		_pipeline.reset(factory->createPipeline());
+		_pipeline.reset(_sdkContext->createPipeline());
 		if (nullptr == _pipeline) {
 			return false;
 		}
 
+		_backgroundCache.reset(new BackgroundCache(
+			[this](const QString& filePath, const QSize& size) {
+				return decodeBackground(filePath, size);
+			},
+			backgroundCacheBudget
+		));
+
 		return true;
 	}
 
@@ -133,73 +244,360 @@ public:
 		return Preset::quality;
 	}
 	
-	QImage replaceBG(const QImage& img)
+	QImage replaceBG(const QImage& inputImage)
 	{
-		if (QImage::Format_ARGB32 != img.format()) {
+		QImage img = inputImage;
+		switch (img.format()) {
+		case QImage::Format_ARGB32:
+		case QImage::Format_RGB32:
+			// RGB32 has the same BGRA bytes with opaque alpha.
+			break;
+		case QImage::Format_RGBX8888:
+			if (_convertedInput.size() != img.size()) {
+				_convertedInput = QImage(img.size(), QImage::Format_ARGB32);
+			}
+			convertRGBXToBGRA(
+				img.constBits(),
+				img.bytesPerLine(),
+				_convertedInput.bits(),
+				_convertedInput.bytesPerLine(),
+				img.width(),
+				img.height()
+			);
+			img = _convertedInput;
+			break;
+		default:
 			return QImage();
 		}
 
 		std::unique_ptr<tsvb::IFrame, Releaser> input;
-		input.reset(
-			_frameFactory->createBGRA(
-				const_cast<uchar*>(img.constBits()),
-				img.bytesPerLine(),
-				img.width(),
-				img.height(),
-				false
-			)
-		);
+		{
+			// The SDK allocates its frames and processing buffers on every frame.
+			ExternalAllocationScope externalAllocations;
+			input.reset(
+				_frameFactory->createBGRA(
+					const_cast<uchar*>(img.constBits()),
+					img.bytesPerLine(),
+					img.width(),
+					img.height(),
+					false
+				)
+			);
+		}
 
 		std::unique_ptr<tsvb::IFrame, Releaser> output;
 		int error = 0;
+		bool exportMatte = false;
 		{
-			std::lock_guard<std::mutex> lockGuard(_mutex);
+			std::unique_lock<std::mutex> lock(_mutex, std::defer_lock);
+			if (0 != _pendingEffects) {
+				// The worker thread holds the pipeline while an effect is prepared.
+				// Keep the video going with the result of the previous configuration.
+				if (!lock.try_lock()) {
+					return _lastOutput;
+				}
+			}
+			else {
+				lock.lock();
+			}
+			updateAnimatedBackground();
+			ExternalAllocationScope externalAllocations;
 			output.reset(_pipeline->process(input.get(), &error));
+			exportMatte = _matteExportEnabled;
 		}
 
+		// Dropped before the pools are asked for the buffers of this frame.
+		_lastOutput = QImage();
+		_matte = QImage();
 		if (nullptr == output) {
 			return QImage();
 		}
 
-		std::unique_ptr<tsvb::ILockedFrameData, Releaser> lockedData(
-			output->lock(tsvb::FrameLock::read)
-		);
+		std::unique_ptr<tsvb::ILockedFrameData, Releaser> lockedData;
+		{
+			ExternalAllocationScope externalAllocations;
+			lockedData.reset(output->lock(tsvb::FrameLock::read));
+		}
 		if (nullptr != lockedData) {
-			return QImage(
-				reinterpret_cast<const uchar*>(lockedData->dataPointer(0)),
-				output->width(),
-				output->height(),
-				lockedData->bytesPerLine(0),
-				QImage::Format_ARGB32
-			).copy();
+			const uint8_t* outputData = reinterpret_cast<const uint8_t*>(lockedData->dataPointer(0));
+			const int outputBytesPerLine = lockedData->bytesPerLine(0);
+			QSize outputSize(output->width(), output->height());
+			if (exportMatte) {
+				// Straight from the SDK frame into a reused plane.
+				_matte = _mattePool.acquire(outputSize, QImage::Format_Grayscale8);
+				extractBGRAAlpha(
+					outputData,
+					outputBytesPerLine,
+					ImagePool::pixels(_matte),
+					_matte.bytesPerLine(),
+					outputSize.width(),
+					outputSize.height()
+				);
+			}
+			// Copied out of the SDK frame into a reused image.
+			_lastOutput = _outputPool.acquire(outputSize, QImage::Format_ARGB32);
+			uchar* outputPixels = ImagePool::pixels(_lastOutput);
+			const size_t rowSize = size_t(outputSize.width()) * 4;
+			for (int y = 0; y < outputSize.height(); ++y) {
+				std::memcpy(
+					outputPixels + y * _lastOutput.bytesPerLine(),
+					outputData + y * outputBytesPerLine,
+					rowSize
+				);
+			}
 		}
 
-		return QImage();
+		return _lastOutput;
+	}
+
+	// Must be called with _mutex locked.
+	void updateAnimatedBackground()
+	{
+		if ((nullptr == _animatedBackground) || (nullptr == _replacementController) || _matteExportEnabled) {
+			return;
+		}
+
+		tsvb::IFrame* frame = _animatedBackground->currentFrame(MetricsClock::now());
+		if ((nullptr != frame) && (frame != _appliedAnimatedFrame)) {
+			ExternalAllocationScope externalAllocations;
+			_replacementController->setBackgroundImage(frame);
+			_appliedAnimatedFrame = frame;
+		}
+	}
+
+	void prepareAsync(Effect effect, std::function<bool()> prepare)
+	{
+		_pendingEffects |= effectBit(effect);
+		post([this, effect, prepare] {
+			bool ok = prepare();
+			_pendingEffects &= ~effectBit(effect);
+			_preparedCallback(effect, ok);
+		});
+	}
+
+	void post(std::function<void()> task)
+	{
+		std::lock_guard<std::mutex> lock(_preparationMutex);
+		_preparationQueue.push_back(std::move(task));
+		if (!_preparationThread.joinable()) {
+			_preparationThread = std::thread([this] { preparationLoop(); });
+		}
+		_preparationCondition.notify_one();
+	}
+
+	bool hasEnabledEffects() const
+	{
+		return _effectsEnabled;
+	}
+
+	bool isBackgroundAnimated() const
+	{
+		return _backgroundAnimated;
+	}
+
+	// Must be called with _mutex locked after an effect is enabled or disabled.
+	void updateEffectsEnabled()
+	{
+		_effectsEnabled =
+			_blurEnabled ||
+			(nullptr != _replacementController) ||
+			_pipeline->getDenoiseBackgroundState() ||
+			_beautificationEnabled ||
+			_colorCorrectionEnabled ||
+			_smartZoomEnabled ||
+			_colorGradingEnabled ||
+			_colorFiltersEnabled ||
+			_lowLightEnabled ||
+			_sharpeningEnabled;
+	}
+
+	bool isEffectPending(Effect effect) const
+	{
+		return 0 != (_pendingEffects & effectBit(effect));
+	}
+
+	void preparationLoop()
+	{
+		while (true) {
+			std::function<void()> task;
+			{
+				std::unique_lock<std::mutex> lock(_preparationMutex);
+				_preparationCondition.wait(lock, [this] {
+					return _preparationStopRequested || !_preparationQueue.empty();
+				});
+				if (_preparationStopRequested) {
+					return;
+				}
+				task = std::move(_preparationQueue.front());
+				_preparationQueue.pop_front();
+			}
+			task();
+		}
 	}
 
 	bool enableBlur()
 	{
-		std::lock_guard<std::mutex> lockGuard(_mutex);
-		tsvb::PipelineError error = _pipeline->enableBlurBackground(0.5);
-		return (tsvb::PipelineErrorCode::ok == error);
+		{
+			std::lock_guard<std::mutex> lockGuard(_mutex);
+			tsvb::PipelineError error = _pipeline->enableBlurBackground(defaultBlurPower);
+			if (tsvb::PipelineErrorCode::ok != error) {
+				return false;
+			}
+			_blurEnabled = true;
+			updateEffectsEnabled();
+		}
+		updateBlurMode();
+		return true;
 	}
 
 	void disableBlur()
 	{
 		std::lock_guard<std::mutex> lockGuard(_mutex);
-		_pipeline->disableBackgroundBlur();
+		_blurEnabled = false;
+		updateEffectsEnabled();
+		applyBlurMode();
 	}
 
 	bool isBlurEnabled() const
 	{
 		std::lock_guard<std::mutex> lockGuard(_mutex);
-		return _pipeline->getBlurBackgroundState(nullptr);
+		return _blurEnabled;
+	}
+
+	void setStaticBlurBackgroundEnabled(bool enabled)
+	{
+		{
+			std::lock_guard<std::mutex> lockGuard(_mutex);
+			_staticBlurEnabled = enabled;
+		}
+		updateBlurMode();
+	}
+
+	bool isStaticBlurBackgroundEnabled() const
+	{
+		std::lock_guard<std::mutex> lockGuard(_mutex);
+		return _staticBlurEnabled;
+	}
+
+	bool isStaticBlurWanted() const
+	{
+		return
+			_staticBlurEnabled &&
+			_blurEnabled &&
+			(nullptr != _replacementController) &&
+			(nullptr != _background);
+	}
+
+	bool isStaticBlurReady() const
+	{
+		return
+			(nullptr != _blurredBackground) &&
+			(_blurredSource.lock() == _background);
+	}
+
+	// Must be called with _mutex locked. Falls back to the SDK blur until the
+	// blurred background is ready.
+	void applyBlurMode()
+	{
+		if (_matteExportEnabled) {
+			// The background stays transparent, its alpha is the matte.
+			_replacementController->clearBackgroundImage();
+			_pipeline->disableBackgroundBlur();
+			return;
+		}
+		if (isStaticBlurWanted() && isStaticBlurReady()) {
+			_pipeline->disableBackgroundBlur();
+			_replacementController->setBackgroundImage(_blurredBackground.get());
+			return;
+		}
+
+		if ((nullptr != _replacementController) && (nullptr != _background)) {
+			_replacementController->setBackgroundImage(_background.get());
+		}
+		if (_blurEnabled) {
+			_pipeline->enableBlurBackground(defaultBlurPower);
+		}
+		else {
+			_pipeline->disableBackgroundBlur();
+		}
+	}
+
+	// Blurs the background on the preparation thread if the static blur is
+	// needed and the current blurred background is outdated.
+	void updateBlurMode()
+	{
+		{
+			std::lock_guard<std::mutex> lockGuard(_mutex);
+			applyBlurMode();
+			if (!isStaticBlurWanted() || isStaticBlurReady()) {
+				return;
+			}
+		}
+		post([this] { blurBackground(); });
+	}
+
+	void blurBackground()
+	{
+		QImage pixels;
+		BackgroundCache::FramePtr source;
+		{
+			// The background may have changed or been blurred since the task was posted.
+			std::lock_guard<std::mutex> lockGuard(_mutex);
+			if (!isStaticBlurWanted() || isStaticBlurReady()) {
+				return;
+			}
+			pixels = copyBackgroundPixels();
+			source = _background;
+		}
+
+		BackgroundCache::FramePtr blurred;
+		if (!pixels.isNull()) {
+			blurBGRA(
+				pixels.bits(),
+				pixels.width(),
+				pixels.height(),
+				pixels.bytesPerLine(),
+				blurRadius(defaultBlurPower, pixels.size())
+			);
+			blurred = wrapImage(pixels);
+		}
+
+		std::lock_guard<std::mutex> lockGuard(_mutex);
+		if (nullptr != blurred) {
+			_blurredBackground = blurred;
+			_blurredSource = source;
+		}
+		applyBlurMode();
+	}
+
+	// Must be called with _mutex locked, the SDK does not use the frame meanwhile.
+	QImage copyBackgroundPixels() const
+	{
+		if ((nullptr == _background) ||
+			(tsvb::FrameFormat::bgra32 != _background->frameFormat())) {
+			return QImage();
+		}
+
+		std::unique_ptr<tsvb::ILockedFrameData, Releaser> lockedData(
+			_background->lock(tsvb::FrameLock::read)
+		);
+		if (nullptr == lockedData) {
+			return QImage();
+		}
+		return QImage(
+			reinterpret_cast<const uchar*>(lockedData->dataPointer(0)),
+			_background->width(),
+			_background->height(),
+			lockedData->bytesPerLine(0),
+			QImage::Format_ARGB32
+		).copy();
 	}
 
 	bool enableDenoise()
 	{
 		std::lock_guard<std::mutex> lockGuard(_mutex);
 		tsvb::PipelineError error = _pipeline->enableDenoiseBackground();
+		updateEffectsEnabled();
 		return (tsvb::PipelineErrorCode::ok == error);
 	}
 
@@ -207,6 +605,7 @@ public:
 	{
 		std::lock_guard<std::mutex> lockGuard(_mutex);
 		_pipeline->disableBackgroundDenoise();
+		updateEffectsEnabled();
 	}
 
 	bool isDenoiseEnabled() const
@@ -237,8 +636,37 @@ public:
 	}
 
 	bool enableReplacement()
+	{
+		{
+			std::lock_guard<std::mutex> lockGuard(_mutex);
+			if (!acquireReplacementController()) {
+				return false;
+			}
+			_replacementRequested = true;
+		}
+		updateBlurMode();
+		return true;
+	}
+
+	void disableReplacement()
 	{
 		std::lock_guard<std::mutex> lockGuard(_mutex);
+		_replacementRequested = false;
+		if (!_matteExportEnabled) {
+			releaseReplacementController();
+		}
+	}
+
+	bool isReplaceEnabled() const
+	{
+		std::lock_guard<std::mutex> lockGuard(_mutex);
+		return _replacementRequested;
+	}
+
+	// Must be called with _mutex locked. The controller is shared by the
+	// replacement effect and the matte export.
+	bool acquireReplacementController()
+	{
 		if (nullptr != _replacementController) {
 			return true;
 		}
@@ -250,42 +678,214 @@ public:
 		}
 
 		_replacementController.reset(controller);
-		if (nullptr != _background) {
-			_replacementController->setBackgroundImage(_background.get());
-		}
+		updateEffectsEnabled();
+		_appliedAnimatedFrame = nullptr;
+		applyBlurMode();
 		return true;
 	}
 
-	void disableReplacement()
+	// Must be called with _mutex locked.
+	void releaseReplacementController()
 	{
-		std::lock_guard<std::mutex> lockGuard(_mutex);
 		_pipeline->disableReplaceBackground();
 		_replacementController = nullptr;
+		updateEffectsEnabled();
+		_appliedAnimatedFrame = nullptr;
+		applyBlurMode();
 	}
 
-	bool isReplaceEnabled() const
+	bool setMatteExportEnabled(bool enabled)
+	{
+		{
+			std::lock_guard<std::mutex> lockGuard(_mutex);
+			if (enabled == _matteExportEnabled) {
+				return true;
+			}
+			if (enabled && !acquireReplacementController()) {
+				return false;
+			}
+
+			_matteExportEnabled = enabled;
+			_appliedAnimatedFrame = nullptr;
+			if (!enabled && !_replacementRequested) {
+				releaseReplacementController();
+			}
+			else {
+				applyBlurMode();
+			}
+		}
+		updateBlurMode();
+		return true;
+	}
+
+	bool isMatteExportEnabled() const
 	{
 		std::lock_guard<std::mutex> lockGuard(_mutex);
-		return _pipeline->getReplaceBackgroundState();
+		return _matteExportEnabled;
+	}
+
+	QImage matte() const
+	{
+		return _matte;
+	}
+
+	BackgroundCache::FramePtr decodeBackground(const QString& filePath, const QSize& size)
+	{
+		QImage image = readScaledImage(filePath, size);
+		if (image.isNull()) {
+			std::lock_guard<std::mutex> factoryLock(_loaderFrameFactoryMutex);
+			tsvb::IFrame* frame = _loaderFrameFactory->loadImage(filePath.toUtf8().constData());
+			if (nullptr == frame) {
+				return nullptr;
+			}
+			return BackgroundCache::FramePtr(frame, Releaser());
+		}
+
+		return wrapImage(image);
+	}
+
+	BackgroundCache::FramePtr wrapImage(QImage image)
+	{
+		tsvb::IFrame* frame = nullptr;
+		{
+			std::lock_guard<std::mutex> factoryLock(_loaderFrameFactoryMutex);
+			frame = _loaderFrameFactory->createBGRA(
+				image.bits(),
+				image.bytesPerLine(),
+				image.width(),
+				image.height(),
+				false
+			);
+		}
+		if (nullptr == frame) {
+			return nullptr;
+		}
+		// The frame refers to the pixels of the image, keep it alive with the frame.
+		return BackgroundCache::FramePtr(frame, [image](tsvb::IFrame* object) {
+			object->release();
+		});
 	}
 
 	bool setBackground(const QString& filePath)
 	{
-		std::unique_ptr<tsvb::IFrame, Releaser> bgFrame;
-		bgFrame.reset(
-			_frameFactory->loadImage(filePath.toUtf8().constData())
-		);
-		if (nullptr == bgFrame) { 
-			return false;
+		if (AnimatedBackground::isAnimatedFile(filePath)) {
+			return setAnimatedBackground(filePath);
 		}
-		std::lock_guard<std::mutex> lockGuard(_mutex);
-		if (nullptr != _replacementController) {
-			_replacementController->setBackgroundImage(bgFrame.get());
+
+		QString previousPath;
+		QSize frameSize;
+		int generation = 0;
+		{
+			std::lock_guard<std::mutex> lockGuard(_mutex);
+			previousPath = _backgroundPath;
+			_backgroundPath = filePath;
+			frameSize = _frameSize;
+			generation = ++_backgroundGeneration;
+		}
+
+		BackgroundCache::FramePtr bgFrame = _backgroundCache->get(filePath, frameSize);
+		std::unique_ptr<AnimatedBackground> animatedBackground;
+		{
+			std::lock_guard<std::mutex> lockGuard(_mutex);
+			if (generation != _backgroundGeneration) {
+				// A newer background or frame size has been requested meanwhile.
+				return nullptr != bgFrame;
+			}
+			if (nullptr == bgFrame) {
+				_backgroundPath = previousPath;
+				return false;
+			}
+			std::swap(_background, bgFrame);
+			std::swap(_animatedBackground, animatedBackground);
+			_backgroundAnimated = false;
+			_appliedAnimatedFrame = nullptr;
+			applyBlurMode();
+		}
+		updateBlurMode();
+		_backgroundCache->prefetchDirectoryOf(filePath, frameSize);
+		return true;
+	}
+
+	bool setAnimatedBackground(const QString& filePath)
+	{
+		QString previousPath;
+		QSize frameSize;
+		Metrics* metrics = nullptr;
+		int generation = 0;
+		{
+			std::lock_guard<std::mutex> lockGuard(_mutex);
+			previousPath = _backgroundPath;
+			_backgroundPath = filePath;
+			frameSize = _frameSize;
+			metrics = _metrics;
+			generation = ++_backgroundGeneration;
+		}
+
+		std::unique_ptr<AnimatedBackground> animatedBackground;
+		{
+			std::lock_guard<std::mutex> factoryLock(_loaderFrameFactoryMutex);
+			animatedBackground.reset(
+				new AnimatedBackground(filePath, frameSize, _loaderFrameFactory.get(), metrics)
+			);
+		}
+		BackgroundCache::FramePtr bgFrame;
+		{
+			std::lock_guard<std::mutex> lockGuard(_mutex);
+			if (generation != _backgroundGeneration) {
+				return animatedBackground->isValid();
+			}
+			if (!animatedBackground->isValid()) {
+				_backgroundPath = previousPath;
+				return false;
+			}
+			// The controller may refer to the frames released below.
+			if (nullptr != _replacementController) {
+				_replacementController->clearBackgroundImage();
+			}
+			std::swap(_animatedBackground, animatedBackground);
+			std::swap(_background, bgFrame);
+			_backgroundAnimated = true;
+			_blurredBackground = nullptr;
+			_appliedAnimatedFrame = nullptr;
+			// Frames change too often for the static blur, the SDK blurs them.
+			applyBlurMode();
 		}
-		std::swap(_background, bgFrame);
 		return true;
 	}
 
+	void setMetrics(Metrics* metrics)
+	{
+		std::lock_guard<std::mutex> lockGuard(_mutex);
+		_metrics = metrics;
+	}
+
+	void setFrameSize(const QSize& size)
+	{
+		QString backgroundPath;
+		{
+			std::lock_guard<std::mutex> lockGuard(_mutex);
+			if (size == _frameSize) {
+				return;
+			}
+			_frameSize = size;
+			backgroundPath = _backgroundPath;
+		}
+
+		if (!backgroundPath.isEmpty()) {
+			post([this, backgroundPath] { setBackground(backgroundPath); });
+		}
+	}
+
+	BackgroundCacheStats backgroundCacheStats() const
+	{
+		return _backgroundCache->stats();
+	}
+
+	void setBackgroundCacheBudget(size_t budgetBytes)
+	{
+		_backgroundCache->setBudget(budgetBytes);
+	}
+
 	bool enableBeautification()
 	{
 		std::lock_guard<std::mutex> lockGuard(_mutex);
@@ -295,6 +895,7 @@ public:
 		}
 
 		_beautificationEnabled = true;
+		updateEffectsEnabled();
 		return true;
 	}
 
@@ -303,6 +904,7 @@ public:
 		std::lock_guard<std::mutex> lockGuard(_mutex);
 		_pipeline->disableBeautification();
 		_beautificationEnabled = false;
+		updateEffectsEnabled();
 	}
 
 	bool isBeautificationEnabled() const
@@ -332,6 +934,7 @@ public:
 		}
 
 		_colorCorrectionEnabled = true;
+		updateEffectsEnabled();
 		return true;
 	}
 
@@ -340,6 +943,7 @@ public:
 		std::lock_guard<std::mutex> lockGuard(_mutex);
 		_pipeline->disableColorCorrection();
 		_colorCorrectionEnabled = false;
+		updateEffectsEnabled();
 	}
 
 	bool isColorCorrectionEnabled() const
@@ -363,6 +967,7 @@ public:
 		}
 
 		_smartZoomEnabled = true;
+		updateEffectsEnabled();
 		return true;
 	}
 
@@ -371,6 +976,7 @@ public:
 		std::lock_guard<std::mutex> lockGuard(_mutex);
 		_pipeline->disableSmartZoom();
 		_smartZoomEnabled = false;
+		updateEffectsEnabled();
 	}
 
 	bool isSmartZoomEnabled() const
@@ -396,7 +1002,10 @@ public:
 		QByteArray utf8Path = QDir::toNativeSeparators(refImage).toUtf8();
 		utf8Path.append('\0');
 		std::unique_ptr<tsvb::IFrame, Releaser> referenceFrame;
-		referenceFrame.reset(_frameFactory->loadImage(utf8Path));
+		{
+			std::lock_guard<std::mutex> factoryLock(_loaderFrameFactoryMutex);
+			referenceFrame.reset(_loaderFrameFactory->loadImage(utf8Path));
+		}
 		if (nullptr == referenceFrame) {
 			return false;
 		}
@@ -408,6 +1017,7 @@ public:
 			return false;
 		}
 		_colorGradingEnabled = true;
+		updateEffectsEnabled();
 		return true;
 	}
 
@@ -416,6 +1026,7 @@ public:
 		std::lock_guard<std::mutex> lockGuard(_mutex);
 		_pipeline->disableColorCorrection();
 		_colorGradingEnabled = false;
+		updateEffectsEnabled();
 	}
 
 	bool isColorGradingEnabled() const
@@ -442,6 +1053,7 @@ public:
 			return false;
 		}
 		_colorFiltersEnabled = true;
+		updateEffectsEnabled();
 		return true;
 	}
 
@@ -450,6 +1062,7 @@ public:
 		std::lock_guard<std::mutex> lockGuard(_mutex);
 		_pipeline->disableColorCorrection();
 		_colorFiltersEnabled = false;
+		updateEffectsEnabled();
 	}
 
 	bool isColorFilterEnabled() const
@@ -469,6 +1082,7 @@ public:
 		std::lock_guard<std::mutex> lockGuard(_mutex);
 		auto error = _pipeline->enableLowLightAdjustment();
 		_lowLightEnabled = tsvb::PipelineErrorCode::ok == error;
+		updateEffectsEnabled();
 		return _lowLightEnabled;
 	}
 
@@ -477,6 +1091,7 @@ public:
 		std::lock_guard<std::mutex> lockGuard(_mutex);
 		_pipeline->disableLowLightAdjustment();
 		_lowLightEnabled = false;
+		updateEffectsEnabled();
 	}
 
 	bool isLowLightAdjustmentEnabled() const
@@ -503,6 +1118,7 @@ public:
 		std::lock_guard<std::mutex> lockGuard(_mutex);
 		tsvb::PipelineError error = _pipeline->enableSharpening();
 		_sharpeningEnabled = (tsvb::PipelineErrorCode::ok == error);
+		updateEffectsEnabled();
 		return _sharpeningEnabled;
 	}
 
@@ -511,6 +1127,7 @@ public:
 		std::lock_guard<std::mutex> lockGuard(_mutex);
 		_pipeline->disableSharpening();
 		_sharpeningEnabled = false;
+		updateEffectsEnabled();
 	}
 
 	bool isSharpeningEnabled() const
@@ -555,9 +1172,19 @@ public:
 	}
 };
 
-VideoFilter::VideoFilter()
+VideoFilter::VideoFilter(QObject* parent)
+	: QObject(parent)
+	, _settingsGeneration(0)
 {
-	std::unique_ptr<Impl> impl(new Impl);
+	std::unique_ptr<Impl> impl(new Impl([this](Effect effect, bool ok) {
+		if (ok) {
+			++_settingsGeneration;
+			emit effectReady(effect);
+		}
+		else {
+			emit effectFailed(effect);
+		}
+	}));
 	if (impl->initialize()) {
 		_impl = std::move(impl);
 	}
@@ -570,6 +1197,21 @@ bool VideoFilter::isValid() const
 	return (nullptr != _impl);
 }
 
+bool VideoFilter::hasEnabledEffects() const
+{
+	return _impl->hasEnabledEffects();
+}
+
+uint64_t VideoFilter::settingsGeneration() const
+{
+	return _settingsGeneration;
+}
+
+bool VideoFilter::isBackgroundAnimated() const
+{
+	return _impl->isBackgroundAnimated();
+}
+
 QImage VideoFilter::replaceBG(const QImage& img)
 {
 	return _impl->replaceBG(img);
@@ -577,6 +1219,7 @@ QImage VideoFilter::replaceBG(const QImage& img)
 
 bool VideoFilter::setBackend(Backend backend)
 {
+	SettingsChange change(_settingsGeneration);
 	return _impl->setBackend(backend);
 }
 
@@ -587,6 +1230,7 @@ Backend VideoFilter::backend() const
 
 bool VideoFilter::setPreset(Preset preset)
 {
+	SettingsChange change(_settingsGeneration);
 	return _impl->setPreset(preset);
 }
 
@@ -597,11 +1241,13 @@ Preset VideoFilter::preset() const
 
 bool VideoFilter::enableBlur()
 {
+	SettingsChange change(_settingsGeneration);
 	return _impl->enableBlur();
 }
 
 void VideoFilter::disableBlur()
 {
+	SettingsChange change(_settingsGeneration);
 	_impl->disableBlur();
 }
 
@@ -610,13 +1256,26 @@ bool VideoFilter::isBlurEnabled() const
 	return _impl->isBlurEnabled();
 }
 
+void VideoFilter::setStaticBlurBackgroundEnabled(bool enabled)
+{
+	SettingsChange change(_settingsGeneration);
+	_impl->setStaticBlurBackgroundEnabled(enabled);
+}
+
+bool VideoFilter::isStaticBlurBackgroundEnabled() const
+{
+	return _impl->isStaticBlurBackgroundEnabled();
+}
+
 bool VideoFilter::enableDenoise()
 {
+	SettingsChange change(_settingsGeneration);
 	return _impl->enableDenoise();
 }
 
 void VideoFilter::disableDenoise()
 {
+	SettingsChange change(_settingsGeneration);
 	_impl->disableDenoise();
 }
 
@@ -632,6 +1291,7 @@ float VideoFilter::denoisePower() const
 
 void VideoFilter::setDenoisePower(float power)
 {
+	SettingsChange change(_settingsGeneration);
 	return _impl->setDenoisePower(power);
 }
 
@@ -642,16 +1302,19 @@ bool VideoFilter::isDenoiseWithFace() const
 
 void VideoFilter::setDenoiseWithFace(bool withFace)
 {
+	SettingsChange change(_settingsGeneration);
 	_impl->setDenoiseWithFace(withFace);
 }
 
 bool VideoFilter::enableReplacement()
 {
+	SettingsChange change(_settingsGeneration);
 	return _impl->enableReplacement();
 }
 
 void VideoFilter::disableReplacement()
 {
+	SettingsChange change(_settingsGeneration);
 	_impl->disableReplacement();
 }
 
@@ -662,16 +1325,88 @@ bool VideoFilter::isReplaceEnabled() const
 
 void VideoFilter::setBackground(const QString& filePath)
 {
+	SettingsChange change(_settingsGeneration);
 	_impl->setBackground(filePath);
 }
 
+bool VideoFilter::setMatteExportEnabled(bool enabled)
+{
+	SettingsChange change(_settingsGeneration);
+	return _impl->setMatteExportEnabled(enabled);
+}
+
+bool VideoFilter::isMatteExportEnabled() const
+{
+	return _impl->isMatteExportEnabled();
+}
+
+QImage VideoFilter::matte() const
+{
+	return _impl->matte();
+}
+
+void VideoFilter::enableReplacementAsync()
+{
+	_impl->prepareAsync(Effect::replacement, [this] {
+		return _impl->enableReplacement();
+	});
+}
+
+void VideoFilter::enableBeautificationAsync()
+{
+	_impl->prepareAsync(Effect::beautification, [this] {
+		return _impl->enableBeautification();
+	});
+}
+
+void VideoFilter::enableColorCorrectionAsync()
+{
+	_impl->prepareAsync(Effect::colorCorrection, [this] {
+		return _impl->enableColorCorrection();
+	});
+}
+
+void VideoFilter::enableColorGradingAsync(const QString& refImage)
+{
+	_impl->prepareAsync(Effect::colorGrading, [this, refImage] {
+		return _impl->enableColorGrading(refImage);
+	});
+}
+
+bool VideoFilter::isEffectPending(Effect effect) const
+{
+	return _impl->isEffectPending(effect);
+}
+
+void VideoFilter::setFrameSize(const QSize& size)
+{
+	_impl->setFrameSize(size);
+}
+
+BackgroundCacheStats VideoFilter::backgroundCacheStats() const
+{
+	return _impl->backgroundCacheStats();
+}
+
+void VideoFilter::setBackgroundCacheBudget(size_t budgetBytes)
+{
+	_impl->setBackgroundCacheBudget(budgetBytes);
+}
+
+void VideoFilter::setMetrics(Metrics* metrics)
+{
+	_impl->setMetrics(metrics);
+}
+
 bool VideoFilter::enableBeautification()
 {
+	SettingsChange change(_settingsGeneration);
 	return _impl->enableBeautification();
 }
 
 void VideoFilter::disableBeautification()
 {
+	SettingsChange change(_settingsGeneration);
 	_impl->disableBeautification();
 }
 
@@ -682,6 +1417,7 @@ bool VideoFilter::isBeautificationEnabled() const
 
 void VideoFilter::setBeautificationLevel(float level)
 {
+	SettingsChange change(_settingsGeneration);
 	_impl->setBeautificationLevel(level);
 }
 
@@ -692,11 +1428,13 @@ float VideoFilter::beautificationLevel() const
 
 bool VideoFilter::enableColorCorrection()
 {
+	SettingsChange change(_settingsGeneration);
 	return _impl->enableColorCorrection();
 }
 
 void VideoFilter::disableColorCorrection()
 {
+	SettingsChange change(_settingsGeneration);
 	_impl->disableColorCorrection();
 }
 
@@ -707,16 +1445,19 @@ bool VideoFilter::isColorCorrectionEnabled() const
 
 void VideoFilter::setColorCorrectionPower(float power)
 {
+	SettingsChange change(_settingsGeneration);
 	_impl->setColorCorrectionPower(power);
 }
 
 bool VideoFilter::enableSmartZoom()
 {
+	SettingsChange change(_settingsGeneration);
 	return _impl->enableSmartZoom();
 }
 
 void VideoFilter::disableSmartZoom()
 {
+	SettingsChange change(_settingsGeneration);
 	_impl->disableSmartZoom();
 }
 
@@ -727,6 +1468,7 @@ bool VideoFilter::isSmartZoomEnabled() const
 
 void VideoFilter::setSmartZoomLevel(float level)
 {
+	SettingsChange change(_settingsGeneration);
 	return _impl->setSmartZoomLevel(level);
 }
 
@@ -737,11 +1479,13 @@ float VideoFilter::smartZoomLevel() const
 
 bool VideoFilter::enableColorGrading(const QString& refImage)
 {
+	SettingsChange change(_settingsGeneration);
 	return _impl->enableColorGrading(refImage);
 }
 
 void VideoFilter::disableColorGrading()
 {
+	SettingsChange change(_settingsGeneration);
 	_impl->disableColorGrading();
 }
 
@@ -752,16 +1496,19 @@ bool VideoFilter::isColorGradingEnabled() const
 
 void VideoFilter::setColorGradingPower(float power)
 {
+	SettingsChange change(_settingsGeneration);
 	_impl->setColorGradingPower(power);
 }
 
 bool VideoFilter::enableColorFilter(const QString& filePath)
 {
+	SettingsChange change(_settingsGeneration);
 	return _impl->enableColorFilter(filePath);
 }
 
 void VideoFilter::disableColorFilter()
 {
+	SettingsChange change(_settingsGeneration);
 	_impl->disableColorFilter();
 }
 
@@ -772,16 +1519,19 @@ bool VideoFilter::isColorFilterEnabled() const
 
 void VideoFilter::setColorFilterPower(float power)
 {
+	SettingsChange change(_settingsGeneration);
 	_impl->setColorFilterPower(power);
 }
 
 bool VideoFilter::enableLowLightAdjustment()
 {
+	SettingsChange change(_settingsGeneration);
 	return _impl->enableLowLightAdjustment();
 }
 
 void VideoFilter::disableLowLightAdjustment()
 {
+	SettingsChange change(_settingsGeneration);
 	_impl->disableLowLightAdjustment();
 }
 
@@ -792,6 +1542,7 @@ bool VideoFilter::isLowLightAdjustmentEnabled() const
 
 void VideoFilter::setLowLightAdjustmentPower(float power)
 {
+	SettingsChange change(_settingsGeneration);
 	_impl->setLowLightAdjustmentPower(power);
 }
 
@@ -802,11 +1553,13 @@ float VideoFilter::getLowLightAdjustmentPower() const
 
 bool VideoFilter::enableSharpening()
 {
+	SettingsChange change(_settingsGeneration);
 	return _impl->enableSharpening();
 }
 
 void VideoFilter::disableSharpening()
 {
+	SettingsChange change(_settingsGeneration);
 	_impl->disableSharpening();
 }
 
@@ -822,6 +1575,7 @@ float VideoFilter::sharpeningPower() const
 
 void VideoFilter::setSharpeningPower(float power)
 {
+	SettingsChange change(_settingsGeneration);
 	_impl->setSharpeningPower(power);
 }
 
@@ -832,6 +1586,7 @@ bool VideoFilter::isAppleNeuralEngineEnabled() const
 
 void VideoFilter::setAppleNeuralEngineEnabled(bool enabled)
 {
+	SettingsChange change(_settingsGeneration);
 	_impl->setAppleNeuralEngineEnabled(enabled);
 }
 
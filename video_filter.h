@@ -4,16 +4,34 @@
 #include "consts.h"
 
 #include <QImage>
+#include <QObject>
 
+#include <atomic>
+#include <cstdint>
 #include <memory>
 
-class VideoFilter {
+Q_DECLARE_METATYPE(Effect)
+
+class Metrics;
+struct BackgroundCacheStats;
+
+class VideoFilter : public QObject
+{
+	Q_OBJECT
 public:
-	VideoFilter();
-	~VideoFilter();
+	explicit VideoFilter(QObject* parent = nullptr);
+	~VideoFilter() override;
 
 	bool isValid() const;
-
+	// False when every effect is off, frames can skip the filter then.
+	bool hasEnabledEffects() const;
+	// Changes whenever a setting which affects the output changes, including
+	// the completion of an async enable. Callers reusing an output compare it.
+	uint64_t settingsGeneration() const;
+	// The background changes from frame to frame.
+	bool isBackgroundAnimated() const;
+
+	// Takes ARGB32, RGB32 or RGBX8888 frames, returns a null image for others.
 	QImage replaceBG(const QImage& img);
 
 	bool setBackend(Backend backend);
@@ -25,6 +43,10 @@ public:
 	bool enableBlur();
 	void disableBlur();
 	bool isBlurEnabled() const;
+	// When blur and replacement are both enabled, blur the background image
+	// once instead of letting the SDK blur it on every frame. On by default.
+	void setStaticBlurBackgroundEnabled(bool enabled);
+	bool isStaticBlurBackgroundEnabled() const;
 
 	bool enableDenoise();
 	void disableDenoise();
@@ -37,7 +59,33 @@ public:
 	bool enableReplacement();
 	void disableReplacement();
 	bool isReplaceEnabled() const;
+	// GIF and video files are played in a loop.
 	void setBackground(const QString& filePath);
+	// Runs the replacement without a background image, so the alpha of the
+	// SDK output is the segmentation mask, and extracts it to matte(). The
+	// background image and blur are not applied meanwhile, the output keeps
+	// a transparent background for the consumer of the matte to composite.
+	bool setMatteExportEnabled(bool enabled);
+	bool isMatteExportEnabled() const;
+	// Grayscale8 matte of the frame last returned by replaceBG(), null unless
+	// the matte export is enabled. Called from the thread which calls replaceBG().
+	QImage matte() const;
+	// Backgrounds are decoded at the size of processed frames and re-derived
+	// when it changes.
+	void setFrameSize(const QSize& size);
+	BackgroundCacheStats backgroundCacheStats() const;
+	void setBackgroundCacheBudget(size_t budgetBytes);
+	// Receives the decode time of animated backgrounds, must outlive the filter.
+	void setMetrics(Metrics* metrics);
+
+	// The async variants return immediately and prepare the effect on a worker
+	// thread, frames keep flowing meanwhile. Completion is reported with
+	// effectReady() or effectFailed() signals.
+	void enableReplacementAsync();
+	void enableBeautificationAsync();
+	void enableColorCorrectionAsync();
+	void enableColorGradingAsync(const QString& refImage);
+	bool isEffectPending(Effect effect) const;
 
 	bool enableBeautification();
 	void disableBeautification();
@@ -81,8 +129,13 @@ public:
 	bool isAppleNeuralEngineEnabled() const;
 	void setAppleNeuralEngineEnabled(bool enabled);
 
+signals:
+	void effectReady(Effect effect);
+	void effectFailed(Effect effect);
+
 private:
 	class Impl;
+	std::atomic<uint64_t> _settingsGeneration;
 	std::unique_ptr<Impl> _impl;
 };
 